@@ -8,7 +8,11 @@
 #include <ctime>
 #include <vector>
 
-class AsciiWidget : public QOpenGLWidget {
+#include "OffscreenBench.hpp"
+#include "Profiler.hpp"
+#include "ProfilerOverlay.hpp"
+
+class AsciiWidget : public QOpenGLWidget, public render::BenchScene {
 
 public:
   AsciiWidget(QWidget *parent = nullptr) : QOpenGLWidget(parent) {
@@ -20,13 +24,28 @@ public:
     timer->start(100);
   }
 
+  void benchInitialize(const QSize &) override {
+    srand(1); // The same colours and characters on every run
+    generateAsciiData();
+  }
+
+  void benchFrame(QPaintDevice &device) override {
+    generateAsciiData();
+    paintFrame(device);
+  }
+
 protected:
   void initializeGL() override {
     // Initialize OpenGL settings if needed
   }
 
-  void paintGL() override {
-    QPainter painter(this);
+  void paintGL() override { paintFrame(*this); }
+
+private:
+  void paintFrame(QPaintDevice &device) {
+    PROFILE_SCOPE("paintGL");
+    frameStats.markFrame();
+    QPainter painter(&device);
     int squareSize = 50;
     QFont font("Monospace", squareSize * 0.8); // Font size close to square size
     font.setStyleHint(QFont::TypeWriter);
@@ -48,9 +67,11 @@ protected:
             QString(QChar(rand() % 95 + 32))); // Random ASCII character
       }
     }
+
+    if (profiler::overlayEnabled())
+      profiler::drawOverlay(painter, frameStats);
   }
 
-private:
   struct AsciiData {
     int asciiCode;
     QColor color;
@@ -60,6 +81,7 @@ private:
   const int cols = 8;
   const int rows = 8;
   const int asciiStart = 32; // Starting from space character
+  profiler::FrameStats frameStats;
 
   void generateAsciiData() {
     asciiData.clear();
@@ -76,14 +98,23 @@ private:
   }
 
   void updateAsciiData() {
+    PROFILE_SCOPE("updateAsciiData");
     generateAsciiData();
     update(); // Trigger a repaint
   }
 };
 
 int main(int argc, char *argv[]) {
+  profiler::initFromEnvironment();
   QApplication app(argc, argv);
 
+  // --bench N renders N frames offscreen as fast as possible
+  if (const int frames = render::benchFrames(argc, argv)) {
+    render::OffscreenBench bench(QSize(400, 400));
+    AsciiWidget scene;
+    return bench.run(scene, frames);
+  }
+
   AsciiWidget *widget = new AsciiWidget;
   widget->resize(400, 400);
 
@@ -0,0 +1,80 @@
+# Runs one demo with --bench and checks its summary line against the baseline
+# BASELINE_DIR/NAME.txt. Called by the bench tests as
+#   cmake -DNAME=... -DCOMMAND=... -DARGUMENTS=... -DFRAMES=...
+#         -DTOLERANCE_PERCENT=... -DBASELINE_DIR=... [-DLAUNCHER=xvfb-run]
+#         [-DRECORD=ON] -P RunBench.cmake
+#
+# The final image's hash has to match the baseline's exactly, and the frame
+# rate may fall at most TOLERANCE_PERCENT below it. Both only mean something
+# on the renderer, size and frame count the baseline was recorded with, so
+# the test is skipped on anything else, and without a baseline. RECORD, set
+# by the bench-record target, writes the current run as the baseline instead.
+
+separate_arguments(ARGUMENTS UNIX_COMMAND "${ARGUMENTS}")
+set(command ${COMMAND} ${ARGUMENTS} --bench ${FRAMES})
+if(LAUNCHER AND NOT DEFINED ENV{DISPLAY} AND NOT DEFINED ENV{WAYLAND_DISPLAY})
+  set(command ${LAUNCHER} -a ${command})
+endif()
+
+execute_process(COMMAND ${command} RESULT_VARIABLE result
+                OUTPUT_VARIABLE output ERROR_VARIABLE errors)
+if(NOT result EQUAL 0)
+  message(FATAL_ERROR "${NAME} --bench failed (${result}):\n${output}${errors}")
+endif()
+string(REGEX MATCH "bench: [^\n]*" current "${output}")
+if(NOT current)
+  message(FATAL_ERROR "${NAME} --bench printed no summary:\n${output}${errors}")
+endif()
+message("${current}")
+
+set(baseline_file ${BASELINE_DIR}/${NAME}.txt)
+if(RECORD)
+  file(WRITE ${baseline_file} "${current}\n")
+  message("Recorded baseline ${baseline_file}")
+  return()
+endif()
+if(NOT EXISTS ${baseline_file})
+  message("bench skipped: no baseline ${baseline_file}; build the "
+          "bench-record target to record one")
+  return()
+endif()
+file(STRINGS ${baseline_file} baseline LIMIT_COUNT 1)
+message("${baseline} (baseline)")
+
+# Value of `key` in a summary line; the renderer's is quoted
+function(bench_field line key out)
+  if(line MATCHES "${key}=(\"[^\"]*\"|[^ ]*)")
+    set(${out} "${CMAKE_MATCH_1}" PARENT_SCOPE)
+  else()
+    set(${out} "" PARENT_SCOPE)
+  endif()
+endfunction()
+
+foreach(key renderer size frames)
+  bench_field("${current}" ${key} now)
+  bench_field("${baseline}" ${key} then)
+  if(NOT now STREQUAL then)
+    message("bench skipped: the baseline has ${key} ${then}, this run "
+            "${now}; build the bench-record target to record a new one")
+    return()
+  endif()
+endforeach()
+
+bench_field("${current}" hash hash)
+bench_field("${baseline}" hash baseline_hash)
+if(NOT hash STREQUAL baseline_hash)
+  message(FATAL_ERROR "${NAME}: the final image changed, hash ${hash} "
+                      "instead of ${baseline_hash}")
+endif()
+
+# CMake only has integer arithmetic; the rates are printed with one decimal
+bench_field("${current}" fps fps)
+bench_field("${baseline}" fps baseline_fps)
+string(REPLACE "." "" fps10 "${fps}")
+string(REPLACE "." "" baseline_fps10 "${baseline_fps}")
+math(EXPR minimum_fps10
+     "${baseline_fps10} * (100 - ${TOLERANCE_PERCENT}) / 100")
+if(fps10 LESS minimum_fps10)
+  message(FATAL_ERROR "${NAME}: ${fps} fps, more than ${TOLERANCE_PERCENT}% "
+                      "below the baseline's ${baseline_fps} fps")
+endif()
@@ -0,0 +1,32 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Read-only memory map of a whole file. Pages are read in on first access,
+// so large files can be parsed in parallel without copying them first. Used
+// for cube_gl's meshes and snake's replays.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Returns false with errno set on failure.
+    bool open(const std::string &path);
+    void close();
+
+    std::string_view contents() const {
+        return {static_cast<const char *>(data_), size_};
+    }
+
+private:
+    void *data_ = nullptr;
+    std::size_t size_ = 0;
+};
+
+#endif // MAPPEDFILE_HPP
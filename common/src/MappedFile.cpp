@@ -0,0 +1,42 @@
+#include "MappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const std::string &path) {
+  close();
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat info;
+  if (::fstat(fd, &info) != 0) {
+    ::close(fd);
+    return false;
+  }
+  size_ = static_cast<std::size_t>(info.st_size);
+  if (size_ > 0) {
+    data_ = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data_ == MAP_FAILED) {
+      data_ = nullptr;
+      size_ = 0;
+      ::close(fd);
+      return false;
+    }
+    // Parsers read each chunk front to back
+    ::madvise(data_, size_, MADV_SEQUENTIAL);
+  }
+  // The mapping stays valid without the descriptor
+  ::close(fd);
+  return true;
+}
+
+void MappedFile::close() {
+  if (data_)
+    ::munmap(data_, size_);
+  data_ = nullptr;
+  size_ = 0;
+}
@@ -0,0 +1,467 @@
+#include "CubeField.hpp"
+#include "MeshLoader.hpp"
+#include "Profiler.hpp"
+#include "SceneBvh.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Loads a mesh the way cube_gl --mesh does, but into plain memory, and prints
+// the time spent in each phase. --write-grid makes test meshes of any size.
+// --cubes times the per-frame transform update of cube_gl --cubes, and
+// --cull the bounding-volume refit and frustum culling that go with it.
+
+namespace {
+
+struct Options {
+  std::string meshPath;
+  std::string gridPath;
+  long long triangles = 10'000'000;
+  std::size_t cubes = 0;
+  std::size_t cull = 0;
+  int frames = 100;
+  unsigned int threads = std::thread::hardware_concurrency();
+};
+
+void printUsage(const char *program) {
+  std::printf("Usage: %s --mesh FILE [--threads N]\n"
+              "       %s --write-grid FILE.obj|FILE.ply [--triangles N]\n"
+              "       %s --cubes N [--threads N] [--frames N]\n"
+              "       %s --cull N [--frames N]\n",
+              program, program, program, program);
+}
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (std::strcmp(arg, "--mesh") == 0 && hasValue) {
+      options.meshPath = argv[++i];
+    } else if (std::strcmp(arg, "--threads") == 0 && hasValue) {
+      options.threads = static_cast<unsigned int>(std::atoi(argv[++i]));
+    } else if (std::strcmp(arg, "--write-grid") == 0 && hasValue) {
+      options.gridPath = argv[++i];
+    } else if (std::strcmp(arg, "--triangles") == 0 && hasValue) {
+      options.triangles = std::atoll(argv[++i]);
+    } else if (std::strcmp(arg, "--cubes") == 0 && hasValue) {
+      options.cubes = static_cast<std::size_t>(std::atoll(argv[++i]));
+    } else if (std::strcmp(arg, "--cull") == 0 && hasValue) {
+      options.cull = static_cast<std::size_t>(std::atoll(argv[++i]));
+    } else if (std::strcmp(arg, "--frames") == 0 && hasValue) {
+      options.frames = std::atoi(argv[++i]);
+    } else {
+      return false;
+    }
+  }
+  const int modes = !options.meshPath.empty() + !options.gridPath.empty() +
+                  (options.cubes > 0) + (options.cull > 0);
+  return modes == 1 && options.threads > 0 && options.triangles >= 2 &&
+         options.frames > 0;
+}
+
+bool endsWith(const std::string &text, const char *suffix) {
+  const std::size_t length = std::strlen(suffix);
+  return text.size() >= length &&
+         text.compare(text.size() - length, length, suffix) == 0;
+}
+
+// Square grid of quads on a sine surface, with at least `triangles`
+// triangles. OBJ faces are written as quads so fan splitting is exercised;
+// PLY faces are little-endian triangles.
+int writeGrid(const Options &options) {
+  const bool ply = endsWith(options.gridPath, ".ply");
+  if (!ply && !endsWith(options.gridPath, ".obj")) {
+    std::fprintf(stderr, "%s: not an .obj or .ply path\n",
+                 options.gridPath.c_str());
+    return 1;
+  }
+  const auto quads = static_cast<std::uint32_t>(
+      std::ceil(std::sqrt(options.triangles / 2.0)));
+  const std::uint32_t side = quads + 1;
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> file(
+      std::fopen(options.gridPath.c_str(), ply ? "wb" : "w"), std::fclose);
+  if (!file) {
+    std::perror(options.gridPath.c_str());
+    return 1;
+  }
+  std::FILE *out = file.get();
+  const std::uint64_t vertexCount = std::uint64_t(side) * side;
+  const std::uint64_t triangleCount = 2 * std::uint64_t(quads) * quads;
+  if (ply)
+    std::fprintf(out,
+                 "ply\nformat binary_little_endian 1.0\n"
+                 "element vertex %llu\nproperty float x\nproperty float y\n"
+                 "property float z\nelement face %llu\n"
+                 "property list uchar uint vertex_indices\nend_header\n",
+                 static_cast<unsigned long long>(vertexCount),
+                 static_cast<unsigned long long>(triangleCount));
+  else
+    std::fprintf(out, "# %u x %u grid\n", quads, quads);
+
+  for (std::uint32_t row = 0; row < side; ++row) {
+    for (std::uint32_t col = 0; col < side; ++col) {
+      const float position[3] = {
+          float(col) / quads * 2.0f - 1.0f,
+          0.1f * std::sin(float(row + col) * 0.05f),
+          float(row) / quads * 2.0f - 1.0f};
+      if (ply)
+        std::fwrite(position, sizeof(position), 1, out);
+      else
+        std::fprintf(out, "v %.6f %.6f %.6f\n", position[0], position[1],
+                     position[2]);
+    }
+  }
+  for (std::uint32_t row = 0; row < quads; ++row) {
+    for (std::uint32_t col = 0; col < quads; ++col) {
+      const std::uint32_t corner = row * side + col;
+      const std::uint32_t quad[4] = {corner, corner + 1, corner + side + 1,
+                                     corner + side};
+      if (ply) {
+        const std::uint8_t count = 3;
+        const std::uint32_t first[3] = {quad[0], quad[1], quad[2]};
+        const std::uint32_t second[3] = {quad[0], quad[2], quad[3]};
+        std::fwrite(&count, 1, 1, out);
+        std::fwrite(first, sizeof(first), 1, out);
+        std::fwrite(&count, 1, 1, out);
+        std::fwrite(second, sizeof(second), 1, out);
+      } else {
+        // OBJ indices start at 1
+        std::fprintf(out, "f %u %u %u %u\n", quad[0] + 1, quad[1] + 1,
+                     quad[2] + 1, quad[3] + 1);
+      }
+    }
+  }
+  std::printf("wrote %s: %llu vertices, %llu triangles\n",
+              options.gridPath.c_str(),
+              static_cast<unsigned long long>(vertexCount),
+              static_cast<unsigned long long>(triangleCount));
+  return 0;
+}
+
+int loadMesh(const Options &options) {
+  MeshLoader loader(options.threads);
+  if (!loader.open(options.meshPath)) {
+    std::fprintf(stderr, "%s\n", loader.error().c_str());
+    return 1;
+  }
+  const MeshLayout &layout = loader.layout();
+  // Plain heap memory stands in for the mapped GPU buffers
+  std::unique_ptr<float[]> vertices(new float[layout.vertexCount * 3]);
+  std::unique_ptr<unsigned char[]> indices(
+      new unsigned char[layout.indexBytes()]);
+  if (!loader.load(vertices.get(), indices.get())) {
+    std::fprintf(stderr, "%s\n", loader.error().c_str());
+    return 1;
+  }
+
+  const MeshLoadTimings &timings = loader.timings();
+  const MeshBounds &bounds = loader.bounds();
+  std::printf("%zu vertices, %zu triangles, %s indices, %u threads\n",
+              layout.vertexCount, layout.indexCount / 3,
+              layout.wideIndices() ? "32-bit" : "16-bit", options.threads);
+  std::printf("bounds (%g, %g, %g) to (%g, %g, %g)\n", bounds.min[0],
+              bounds.min[1], bounds.min[2], bounds.max[0], bounds.max[1],
+              bounds.max[2]);
+  std::printf("map %.1f ms, scan %.1f ms, parse %.1f ms, total %.1f ms\n",
+              timings.mapMs, timings.scanMs, timings.parseMs,
+              timings.mapMs + timings.scanMs + timings.parseMs);
+  return 0;
+}
+
+// Every kernel must match the scalar one, and every rotation must stay a
+// unit quaternion, over a range of times that includes many turns.
+bool verifyCubeKernels() {
+  CubeField reference(10'000, 1);
+  CubeField field(10'000, 1);
+  reference.setKernel(TransformKernel::Scalar);
+  for (const TransformKernel kernel :
+       {TransformKernel::Scalar, TransformKernel::Sse2,
+        TransformKernel::Avx2}) {
+    if (!transformKernelSupported(kernel))
+      continue;
+    field.setKernel(kernel);
+    for (const float seconds : {0.0f, 0.37f, 12.5f, 1000.0f, 86400.0f}) {
+      reference.update(seconds);
+      field.update(seconds);
+      const float *expected = reference.transforms();
+      const float *actual = field.transforms();
+      const std::size_t stride = field.stride();
+      for (std::size_t i = 0; i < field.count(); ++i) {
+        float norm = 0.0f;
+        for (int component = 0; component < 4; ++component) {
+          const float value = actual[component * stride + i];
+          norm += value * value;
+        }
+        bool matches = std::fabs(norm - 1.0f) < 1e-4f;
+        for (int stream = 0; stream < CubeField::kStreams; ++stream)
+          matches = matches && std::fabs(actual[stream * stride + i] -
+                                         expected[stream * stride + i]) < 1e-5f;
+        if (!matches) {
+          std::fprintf(stderr, "%s kernel differs for cube %zu at %g s\n",
+                       transformKernelName(kernel), i, seconds);
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+int updateCubes(const Options &options) {
+  if (!verifyCubeKernels())
+    return 1;
+  std::printf("Transform update per frame on %u threads, %d frames\n",
+              options.threads, options.frames);
+  std::printf("%10s  %7s  %10s  %9s\n", "cubes", "kernel", "ms/frame",
+              "ns/cube");
+  for (std::size_t count = 1000;; count *= 10) {
+    count = std::min(count, options.cubes);
+    CubeField field(count, options.threads);
+    for (const TransformKernel kernel :
+         {TransformKernel::Scalar, TransformKernel::Sse2,
+          TransformKernel::Avx2}) {
+      if (!transformKernelSupported(kernel))
+        continue;
+      field.setKernel(kernel);
+      field.update(0.0f);
+      const auto start = std::chrono::steady_clock::now();
+      for (int frame = 0; frame < options.frames; ++frame)
+        field.update(static_cast<float>(frame) / 60.0f);
+      const double elapsed = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count() /
+                             options.frames;
+      std::printf("%10zu  %7s  %10.3f  %9.2f\n", count,
+                  transformKernelName(kernel), elapsed,
+                  elapsed * 1e6 / static_cast<double>(count));
+    }
+    if (count == options.cubes)
+      break;
+  }
+  return 0;
+}
+
+// Column-major 4x4 matrices built the way QMatrix4x4 builds them, so the
+// views match what cube_gl sees
+struct Matrix4 {
+  float m[16] = {};
+};
+
+Matrix4 multiply(const Matrix4 &a, const Matrix4 &b) {
+  Matrix4 product;
+  for (int column = 0; column < 4; ++column)
+    for (int row = 0; row < 4; ++row)
+      for (int k = 0; k < 4; ++k)
+        product.m[4 * column + row] += a.m[4 * k + row] * b.m[4 * column + k];
+  return product;
+}
+
+Matrix4 perspective(float verticalAngle, float aspect, float nearPlane,
+                    float farPlane) {
+  const float f = 1.0f / std::tan(verticalAngle * 3.14159265f / 360.0f);
+  Matrix4 projection;
+  projection.m[0] = f / aspect;
+  projection.m[5] = f;
+  projection.m[10] = (farPlane + nearPlane) / (nearPlane - farPlane);
+  projection.m[11] = -1.0f;
+  projection.m[14] = 2.0f * farPlane * nearPlane / (nearPlane - farPlane);
+  return projection;
+}
+
+Matrix4 lookAt(const float eye[3], const float centre[3]) {
+  float forward[3];
+  for (int axis = 0; axis < 3; ++axis)
+    forward[axis] = centre[axis] - eye[axis];
+  const auto normalize = [](float *v) {
+    const float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    for (int axis = 0; axis < 3; ++axis)
+      v[axis] /= length;
+  };
+  normalize(forward);
+  // Side is forward x up, with up the y axis
+  float side[3] = {-forward[2], 0.0f, forward[0]};
+  normalize(side);
+  const float up[3] = {side[1] * forward[2] - side[2] * forward[1],
+                       side[2] * forward[0] - side[0] * forward[2],
+                       side[0] * forward[1] - side[1] * forward[0]};
+  Matrix4 view;
+  for (int axis = 0; axis < 3; ++axis) {
+    view.m[4 * axis] = side[axis];
+    view.m[4 * axis + 1] = up[axis];
+    view.m[4 * axis + 2] = -forward[axis];
+  }
+  view.m[12] = -(side[0] * eye[0] + side[1] * eye[1] + side[2] * eye[2]);
+  view.m[13] = -(up[0] * eye[0] + up[1] * eye[1] + up[2] * eye[2]);
+  view.m[14] = forward[0] * eye[0] + forward[1] * eye[1] + forward[2] * eye[2];
+  view.m[15] = 1.0f;
+  return view;
+}
+
+struct CullView {
+  const char *name;
+  Frustum frustum;
+};
+
+// The window's orbit, which keeps the whole field in view; a camera at the
+// centre looking along -z; and one near a corner looking out of the field
+std::vector<CullView> cullViews(float extent) {
+  const Matrix4 projection =
+      perspective(45.0f, 800.0f / 600.0f, 0.1f, 8.0f * extent);
+  const float origin[3] = {0.0f, 0.0f, 0.0f};
+  const float orbitEye[3] = {0.0f, 0.8f * extent, 2.8f * extent};
+  const float ahead[3] = {0.0f, 0.0f, -extent};
+  const float cornerEye[3] = {0.9f * extent, 0.9f * extent, 0.9f * extent};
+  const float outside[3] = {2.0f * extent, 2.0f * extent, 2.0f * extent};
+  return {
+      {"orbit", Frustum::fromMatrix(
+                    multiply(projection, lookAt(orbitEye, origin)).m)},
+      {"inside",
+       Frustum::fromMatrix(multiply(projection, lookAt(origin, ahead)).m)},
+      {"corner", Frustum::fromMatrix(
+                     multiply(projection, lookAt(cornerEye, outside)).m)},
+  };
+}
+
+const float *offsets(const CubeField &field, int axis) {
+  return field.transforms() + (CubeField::OffsetX + axis) * field.stride();
+}
+
+// Culling must be conservative: every cube whose own bounds reach into the
+// frustum has to be in a visible range, for every kernel, with and without
+// the tree, after the cubes have moved and the tree was refitted.
+bool verifyCulling() {
+  CubeField field(100'000, 1);
+  SceneBvh bvh;
+  bvh.build(offsets(field, 0), offsets(field, 1), offsets(field, 2),
+            field.count(), CubeField::kCubeRadius);
+  field.update(3.7f);
+  bvh.markMoved(0, field.count());
+  bvh.refit(offsets(field, 0), offsets(field, 1), offsets(field, 2));
+
+  std::vector<ObjectRange> visible;
+  std::vector<std::uint8_t> accepted(field.count());
+  for (const CullView &view : cullViews(field.extent())) {
+    for (const CullKernel kernel :
+         {CullKernel::Scalar, CullKernel::Sse2, CullKernel::Avx2}) {
+      if (!cullKernelSupported(kernel))
+        continue;
+      bvh.setKernel(kernel);
+      for (const bool tree : {true, false}) {
+        if (tree)
+          bvh.cull(view.frustum, visible);
+        else
+          bvh.cullLeaves(view.frustum, visible);
+        std::fill(accepted.begin(), accepted.end(), 0);
+        for (const ObjectRange &range : visible)
+          std::fill(accepted.begin() + range.begin,
+                    accepted.begin() + range.end, 1);
+        for (std::size_t i = 0; i < field.count(); ++i) {
+          bool inFrustum = true;
+          for (const auto &plane : view.frustum.planes) {
+            float distance = plane[3];
+            float radius = 0.0f;
+            for (int axis = 0; axis < 3; ++axis) {
+              distance += plane[axis] * offsets(field, axis)[i];
+              radius += std::fabs(plane[axis]) * CubeField::kCubeRadius;
+            }
+            inFrustum = inFrustum && distance + radius >= 0.0f;
+          }
+          if (inFrustum && !accepted[i]) {
+            std::fprintf(stderr, "%s %s culling drops cube %zu in view %s\n",
+                         cullKernelName(kernel), tree ? "tree" : "leaf", i,
+                         view.name);
+            return false;
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+int cullCubes(const Options &options) {
+  if (!verifyCulling())
+    return 1;
+  CubeField field(options.cull);
+  SceneBvh bvh;
+  auto start = std::chrono::steady_clock::now();
+  bvh.build(offsets(field, 0), offsets(field, 1), offsets(field, 2),
+            field.count(), CubeField::kCubeRadius);
+  const double buildMs = std::chrono::duration<double, std::milli>(
+                             std::chrono::steady_clock::now() - start)
+                             .count();
+  std::printf("%zu cubes in %zu leaves, %zu nodes: build %.2f ms\n",
+              field.count(), bvh.leafCount(), bvh.nodeCount(), buildMs);
+
+  // Only the refit is timed, not the transform update before it
+  double refitMs = 0.0;
+  for (int frame = 0; frame < options.frames; ++frame) {
+    field.update(static_cast<float>(frame) / 60.0f);
+    start = std::chrono::steady_clock::now();
+    bvh.markMoved(0, field.count());
+    bvh.refit(offsets(field, 0), offsets(field, 1), offsets(field, 2));
+    refitMs += std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+  }
+  std::printf("refit after every update: %.3f ms/frame\n",
+              refitMs / options.frames);
+
+  std::printf("%7s  %7s  %9s  %9s  %7s  %8s  %8s  %7s\n", "view", "kernel",
+              "visible", "culled", "ranges", "nodes", "tree ms", "leaf ms");
+  std::vector<ObjectRange> visible;
+  for (const CullView &view : cullViews(field.extent())) {
+    for (const CullKernel kernel :
+         {CullKernel::Scalar, CullKernel::Sse2, CullKernel::Avx2}) {
+      if (!cullKernelSupported(kernel))
+        continue;
+      bvh.setKernel(kernel);
+      CullStats stats;
+      start = std::chrono::steady_clock::now();
+      for (int frame = 0; frame < options.frames; ++frame)
+        stats = bvh.cull(view.frustum, visible);
+      const double treeMs = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - start)
+                                .count() /
+                            options.frames;
+      const std::size_t ranges = visible.size();
+      start = std::chrono::steady_clock::now();
+      for (int frame = 0; frame < options.frames; ++frame)
+        bvh.cullLeaves(view.frustum, visible);
+      const double leafMs = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - start)
+                                .count() /
+                            options.frames;
+      std::printf("%7s  %7s  %9zu  %9zu  %7zu  %8zu  %8.3f  %7.3f\n",
+                  view.name, cullKernelName(kernel), stats.visibleObjects,
+                  field.count() - stats.visibleObjects, ranges,
+                  stats.nodesTested, treeMs, leafMs);
+    }
+  }
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  profiler::initFromEnvironment();
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  if (options.cubes > 0)
+    return updateCubes(options);
+  if (options.cull > 0)
+    return cullCubes(options);
+  return options.gridPath.empty() ? loadMesh(options) : writeGrid(options);
+}
@@ -0,0 +1,103 @@
+#ifndef CUBEFIELD_HPP
+#define CUBEFIELD_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Grid of cubes that each spin about their own axis and bob up and down.
+// Every update recomputes all transforms from the time alone, as a rotation
+// quaternion and an offset per cube. State and transforms are both kept as
+// structure-of-arrays, one float stream per component, so the kernels use
+// whole SIMD registers and the transforms upload as one block that the
+// vertex shader reads as per-instance float attributes.
+
+enum class TransformKernel { Scalar, Sse2, Avx2 };
+
+// The fastest kernel this CPU supports. SSE2 and AVX2 are only built for
+// x86; elsewhere this is the scalar kernel.
+TransformKernel bestTransformKernel();
+bool transformKernelSupported(TransformKernel kernel);
+const char *transformKernelName(TransformKernel kernel);
+
+class CubeField {
+public:
+    // Order of the streams in transforms()
+    enum Stream {
+        RotationX,
+        RotationY,
+        RotationZ,
+        RotationW,
+        OffsetX,
+        OffsetY,
+        OffsetZ,
+        kStreams
+    };
+
+    // Transforms are computed on `threads` threads, each always updating the
+    // same slice so it stays in that core's cache.
+    explicit CubeField(std::size_t count,
+                       unsigned int threads = std::thread::hardware_concurrency(),
+                       std::uint32_t seed = 1);
+    ~CubeField();
+
+    CubeField(const CubeField &) = delete;
+    CubeField &operator=(const CubeField &) = delete;
+
+    // Each cube spans -1..1 on every axis before rotating, so it always stays
+    // within this distance of its offset
+    static constexpr float kCubeRadius = 1.7320508f;
+
+    std::size_t count() const { return count_; }
+    // Distance from the centre of the grid to its faces
+    float extent() const { return extent_; }
+    unsigned int threads() const { return threadCount_; }
+
+    TransformKernel kernel() const { return kernel_; }
+    // Ignored if the CPU does not support `kernel`
+    void setKernel(TransformKernel kernel);
+
+    // Recomputes every transform for `seconds` since the start
+    void update(float seconds);
+
+    // kStreams streams of stride() floats; the first count() of each are used
+    const float *transforms() const { return transforms_.get(); }
+    std::size_t stride() const { return stride_; }
+    std::size_t transformBytes() const {
+        return kStreams * stride_ * sizeof(float);
+    }
+
+private:
+    struct AlignedDelete {
+        void operator()(float *data) const;
+    };
+    using AlignedFloats = std::unique_ptr<float[], AlignedDelete>;
+
+    static AlignedFloats allocate(std::size_t floats);
+    void updateSlice(unsigned int slice);
+    void workerLoop(unsigned int slice);
+
+    const std::size_t count_;
+    // count_ rounded up to whole 64-byte cache lines
+    const std::size_t stride_;
+    float extent_ = 0;
+    AlignedFloats inputs_;
+    AlignedFloats transforms_;
+    TransformKernel kernel_;
+    float seconds_ = 0;
+
+    const unsigned int threadCount_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    std::uint64_t generation_ = 0;
+    unsigned int pending_ = 0;
+    bool stopping_ = false;
+};
+
+#endif // CUBEFIELD_HPP
@@ -0,0 +1,46 @@
+#ifndef CUBEFIELDRENDERER_HPP
+#define CUBEFIELDRENDERER_HPP
+
+#include <QMatrix4x4>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <memory>
+#include <vector>
+#include "CubeField.hpp"
+#include "SceneBvh.hpp"
+#include "ShaderCache.hpp"
+
+// Draws every cube of a CubeField as a wireframe with one instanced call on
+// OpenGL 3.3. The transform streams become per-instance float attributes in
+// the layout the field computes them in, and the vertex shader rotates each
+// cube by its quaternion. Each frame the transforms go up with a single
+// glBufferSubData into freshly orphaned storage, so the driver never has to
+// wait for the GPU to finish reading the previous frame's copy.
+class CubeFieldRenderer : protected QOpenGLExtraFunctions {
+public:
+  CubeFieldRenderer() = default;
+  ~CubeFieldRenderer();
+
+  // Needs a current 3.3 core context. Returns false if it cannot render.
+  bool initialize(render::ShaderCache &shaders);
+  // Creates the cube and instance buffers for `field`, after initialize.
+  void upload(const CubeField &field);
+
+  void render(const CubeField &field, const QMatrix4x4 &viewProjection);
+  // Draws only the cubes in `visible`, copied straight into the mapped
+  // instance buffer, each stream packed at the start of its usual place.
+  void render(const CubeField &field, const QMatrix4x4 &viewProjection,
+              const std::vector<ObjectRange> &visible);
+
+private:
+  void draw(const QMatrix4x4 &viewProjection, GLsizei instances);
+
+  std::unique_ptr<QOpenGLShaderProgram> program_;
+  GLuint vao_ = 0;
+  GLuint cubeBuffer_ = 0;
+  GLuint indexBuffer_ = 0;
+  GLuint instanceBuffer_ = 0;
+  GLint viewProjectionLocation_ = -1;
+};
+
+#endif // CUBEFIELDRENDERER_HPP
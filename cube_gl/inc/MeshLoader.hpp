@@ -0,0 +1,122 @@
+#ifndef MESHLOADER_HPP
+#define MESHLOADER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+// Triangle mesh loader for Wavefront OBJ and binary PLY files. Loading has
+// two passes over the memory-mapped file, both split into chunks parsed on
+// several threads: open() counts vertices and triangles so the caller can
+// size its buffers, then load() writes positions and indices straight into
+// them. Only writes are made to those buffers, so they may be mapped GPU
+// buffers. Polygons are split into triangle fans.
+
+struct MeshLayout {
+    std::size_t vertexCount = 0;
+    // Three per triangle
+    std::size_t indexCount = 0;
+
+    // 16-bit indices only reach 65536 vertices
+    bool wideIndices() const { return vertexCount > 65536; }
+    // Three floats per vertex
+    std::size_t vertexBytes() const { return vertexCount * 3 * sizeof(float); }
+    std::size_t indexBytes() const {
+        return indexCount * (wideIndices() ? sizeof(std::uint32_t)
+                                           : sizeof(std::uint16_t));
+    }
+};
+
+struct MeshBounds {
+    float min[3];
+    float max[3];
+};
+
+struct MeshLoadTimings {
+    double mapMs = 0;
+    double scanMs = 0;
+    double parseMs = 0;
+};
+
+class MeshLoader {
+public:
+    explicit MeshLoader(
+        unsigned int threads = std::thread::hardware_concurrency());
+
+    // Maps the file and counts its vertices and triangles. The format is
+    // chosen by the .obj or .ply extension.
+    bool open(const std::string &path);
+    const MeshLayout &layout() const { return layout_; }
+
+    // Writes layout().vertexCount * 3 floats and layout().indexCount indices,
+    // uint32_t if layout().wideIndices() and uint16_t otherwise.
+    bool load(float *vertices, void *indices);
+    // Valid after a successful load()
+    const MeshBounds &bounds() const { return bounds_; }
+
+    const std::string &error() const { return error_; }
+    const MeshLoadTimings &timings() const { return timings_; }
+
+private:
+    enum class Format { Obj, Ply };
+    enum class PlyType : std::uint8_t {
+        Int8,
+        UInt8,
+        Int16,
+        UInt16,
+        Int32,
+        UInt32,
+        Float32,
+        Float64
+    };
+
+    // Part of the file parsed by one thread, and where its output goes
+    struct Chunk {
+        std::size_t begin = 0;
+        std::size_t end = 0;
+        std::size_t firstVertex = 0;
+        std::size_t firstIndex = 0;
+        std::size_t vertices = 0;
+        std::size_t indices = 0;
+        // PLY faces in the chunk
+        std::size_t faces = 0;
+    };
+
+    struct PlyLayout {
+        bool bigEndian = false;
+        std::size_t vertexStart = 0;
+        std::size_t vertexStride = 0;
+        std::size_t positionOffset[3] = {};
+        PlyType positionType[3] = {};
+        std::size_t faceStart = 0;
+        std::size_t faceCount = 0;
+        // Fixed-size face properties before and after the index list
+        std::size_t faceLeading = 0;
+        std::size_t faceTrailing = 0;
+        PlyType countType = PlyType::UInt8;
+        PlyType indexType = PlyType::Int32;
+    };
+
+    bool fail(std::string message);
+    bool scanObj();
+    bool parsePlyHeader();
+    bool scanPly();
+    template <typename Index> bool parseObj(float *vertices, Index *indices);
+    template <typename Index> bool parsePly(float *vertices, Index *indices);
+
+    unsigned int threads_;
+    MappedFile file_;
+    Format format_ = Format::Obj;
+    MeshLayout layout_;
+    MeshBounds bounds_ = {};
+    std::vector<Chunk> chunks_;
+    PlyLayout ply_;
+    std::string error_;
+    MeshLoadTimings timings_;
+};
+
+#endif // MESHLOADER_HPP
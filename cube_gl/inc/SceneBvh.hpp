@@ -0,0 +1,125 @@
+#ifndef SCENEBVH_HPP
+#define SCENEBVH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Bounding-volume hierarchy for view frustum culling of many small objects,
+// such as the cubes of a CubeField. Objects are spheres of one radius around
+// points given as separate x, y and z streams. Runs of kLeafObjects
+// consecutive objects form the leaves, so whatever survives culling is a
+// short list of index ranges that can be copied out of structure-of-arrays
+// data in blocks.
+//
+// The tree is built once over the leaves with median splits. When objects
+// move, markMoved() and refit() recompute the bounds of the leaves that
+// changed and of their ancestors, keeping the tree's shape.
+
+// SIMD level of the plane tests and of the leaf bounds in refit()
+enum class CullKernel { Scalar, Sse2, Avx2 };
+
+// The fastest kernel this CPU supports. SSE2 and AVX2 are only built for
+// x86; elsewhere this is the scalar kernel.
+CullKernel bestCullKernel();
+bool cullKernelSupported(CullKernel kernel);
+const char *cullKernelName(CullKernel kernel);
+
+// Six inward-facing planes a*x + b*y + c*z + d >= 0, normalized, in the
+// order left, right, bottom, top, near, far.
+struct Frustum {
+    float planes[6][4];
+
+    // Planes of the clip volume of a column-major view-projection matrix,
+    // e.g. QMatrix4x4::constData()
+    static Frustum fromMatrix(const float *viewProjection);
+};
+
+// Objects [begin, end)
+struct ObjectRange {
+    std::uint32_t begin;
+    std::uint32_t end;
+};
+
+struct CullStats {
+    std::size_t nodesTested = 0;
+    std::size_t visibleObjects = 0;
+};
+
+class SceneBvh {
+public:
+    static constexpr std::size_t kLeafObjects = 64;
+
+    void build(const float *x, const float *y, const float *z,
+               std::size_t count, float radius);
+
+    std::size_t objectCount() const { return count_; }
+    std::size_t leafCount() const { return leaves_.size(); }
+    std::size_t nodeCount() const { return nodes_.size(); }
+
+    // Flags the leaves holding objects [begin, end) for the next refit
+    void markMoved(std::size_t begin, std::size_t end);
+    // Recomputes the bounds of flagged leaves from the current positions, and
+    // of every node above them
+    void refit(const float *x, const float *y, const float *z);
+
+    CullKernel kernel() const { return kernel_; }
+    // Ignored if the CPU does not support `kernel`
+    void setKernel(CullKernel kernel);
+
+    // Replaces `visible` with the ranges of objects in leaves that may
+    // intersect the frustum, merging neighbouring ranges. Subtrees entirely
+    // inside it are accepted without testing their children.
+    CullStats cull(const Frustum &frustum,
+                   std::vector<ObjectRange> &visible) const;
+    // The same without the tree: every leaf is tested on its own
+    CullStats cullLeaves(const Frustum &frustum,
+                         std::vector<ObjectRange> &visible) const;
+
+private:
+    // Boxes are kept as centre and half extent, which is what the plane test
+    // needs
+    struct Box {
+        float centre[3];
+        float extent[3];
+    };
+    // Nodes are stored depth first: a node's first child follows it, and
+    // `skip` is the index just past its subtree. A leaf node has skip equal to
+    // its own index plus one. Its subtree's leaves are
+    // leafOrder_[firstLeaf, endLeaf).
+    struct Node {
+        Box box;
+        std::uint32_t skip;
+        std::uint32_t firstLeaf;
+        std::uint32_t endLeaf;
+    };
+
+    std::uint32_t buildNode(std::uint32_t firstLeaf, std::uint32_t endLeaf,
+                            std::uint32_t parent);
+    void fitLeaf(std::size_t leaf, const float *x, const float *y,
+                 const float *z);
+    // Appends the leaf's objects, extending the last range if they follow it
+    void emitLeaf(std::size_t leaf, std::vector<ObjectRange> &visible,
+                  CullStats &stats) const;
+    // Defined for each kernel's plane test in SceneBvh.cpp only
+    template <typename Test>
+    CullStats traverse(const Test &test,
+                       std::vector<ObjectRange> &visible) const;
+    template <typename Test>
+    CullStats testLeaves(const Test &test,
+                         std::vector<ObjectRange> &visible) const;
+
+    std::size_t count_ = 0;
+    float radius_ = 0;
+    std::vector<Box> leaves_;
+    std::vector<std::uint8_t> moved_;
+    std::vector<std::uint32_t> leafOrder_;
+    std::vector<Node> nodes_;
+    // Node index of each leaf, for refitting only the moved paths
+    std::vector<std::uint32_t> leafNode_;
+    std::vector<std::uint32_t> parent_;
+    std::vector<std::uint8_t> nodeMoved_;
+    CullKernel kernel_ = bestCullKernel();
+};
+
+#endif // SCENEBVH_HPP
@@ -1,30 +1,155 @@
 #include <QApplication>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QMatrix4x4>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
 #include <QOpenGLFunctions>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLWidget>
+#include <QPainter>
+#include <QSurfaceFormat>
 #include <QTimer>
 #include <QVector3D>
 
-class CubeGLWidget : public QOpenGLWidget, protected QOpenGLFunctions {
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "CubeField.hpp"
+#include "CubeFieldRenderer.hpp"
+#include "MeshLoader.hpp"
+#include "GpuFrameTimer.hpp"
+#include "OffscreenBench.hpp"
+#include "Profiler.hpp"
+#include "ProfilerOverlay.hpp"
+#include "RenderState.hpp"
+#include "SceneBvh.hpp"
+#include "ShaderCache.hpp"
+
+class CubeGLWidget : public QOpenGLWidget,
+                     public render::BenchScene,
+                     protected QOpenGLFunctions {
+  render::ShaderCache shaderCache;
   std::unique_ptr<QOpenGLShaderProgram> program;
   GLuint vbo, ebo;
+  render::VertexInput vertexInput;
+  GLint modelLocation = -1;
+  GLint viewLocation = -1;
+  GLint projectionLocation = -1;
+  // View and projection are only uploaded again after the camera changed
+  render::Camera camera;
+  std::uint64_t uploadedCameraRevision = 0;
+  // The wireframe cube unless a mesh was loaded
+  GLenum drawMode = GL_LINES;
+  GLsizei indexCount = 24;
+  GLenum indexType = GL_UNSIGNED_SHORT;
+  std::string meshPath;
+  // Centres the mesh and scales it to the cube's size
+  QMatrix4x4 meshMatrix;
   QMatrix4x4 modelMatrix;
+  // Many independently spinning cubes instead of one, with --cubes N
+  std::unique_ptr<CubeField> field;
+  std::unique_ptr<CubeFieldRenderer> fieldRenderer;
+  // Refitted after every update; only the cubes it keeps are uploaded
+  SceneBvh fieldBvh;
+  bool culling = true;
+  std::vector<ObjectRange> visibleCubes;
+  QElapsedTimer fieldClock;
+  // Updates made by benchFrame, which advance the field by a fixed 16 ms
+  // each; -1 outside --bench, where the field follows fieldClock
+  int benchSteps = -1;
+  qint64 fieldUpdateNs = 0;
+  qint64 fieldRefitNs = 0;
+  int fieldUpdates = 0;
+  qint64 cullNs = 0;
+  std::size_t culledFrames = 0;
+  std::size_t visibleTotal = 0;
   QTimer timer;
   float angleX, angleY;
+  profiler::FrameStats frameStats;
+  bool logPaintTimes = false;
+  profiler::DurationStats paintTimes;
+  profiler::GpuFrameTimer gpuTimer;
+  profiler::StartupTimings *startup = nullptr;
 
 public:
-  CubeGLWidget() : angleX(0.0f), angleY(0.0f) {
+  explicit CubeGLWidget(std::string meshPath = {}, std::size_t cubes = 0)
+      : meshPath(std::move(meshPath)), angleX(0.0f), angleY(0.0f) {
+    if (cubes > 0) {
+      field = std::make_unique<CubeField>(cubes);
+      fieldBvh.build(fieldOffsets(0), fieldOffsets(1), fieldOffsets(2),
+                     field->count(), CubeField::kCubeRadius);
+    }
     connect(&timer, &QTimer::timeout, this, &CubeGLWidget::updateRotation);
     timer.start(16); // roughly 60 FPS
   }
 
+  ~CubeGLWidget() override {
+    makeCurrent();
+    gpuTimer.destroy();
+    vertexInput.destroy();
+    fieldRenderer.reset();
+    doneCurrent();
+  }
+
+  // Logs paintGL CPU time every 300 frames
+  void setFrameStatsEnabled(bool enabled) { logPaintTimes = enabled; }
+  // Frustum culling of the --cubes field, on by default
+  void setCulling(bool enabled) { culling = enabled; }
+  // Marks the startup phases in initializeGL and reports them after the
+  // first frame
+  void setStartupTimings(profiler::StartupTimings *timings) {
+    startup = timings;
+  }
+
+  void benchInitialize(const QSize &size) override {
+    benchSteps = 0;
+    initializeGL();
+    resizeGL(size.width(), size.height());
+  }
+
+  void benchFrame(QPaintDevice &device) override {
+    stepRotation();
+    ++benchSteps;
+    paintFrame(device);
+  }
+
 protected:
   void initializeGL() override {
+    markStartup("context");
     initializeOpenGLFunctions();
+    gpuTimer.initialize();
     glEnable(GL_DEPTH_TEST);
 
+    if (field) {
+      fieldRenderer = std::make_unique<CubeFieldRenderer>();
+      if (fieldRenderer->initialize(shaderCache)) {
+        markStartup("shaders");
+        fieldRenderer->upload(*field);
+        markStartup("upload");
+        // The camera circles the whole field at a distance that fits it in
+        // view
+        const float extent = field->extent();
+        camera.lookAt(QVector3D(0.0f, 0.8f * extent, 2.8f * extent),
+                      QVector3D(0.0f, 0.0f, 0.0f),
+                      QVector3D(0.0f, 1.0f, 0.0f));
+        camera.setPerspective(45.0f, 0.1f, 8.0f * extent);
+        fieldClock.start();
+        return;
+      }
+      qWarning("Drawing a single cube instead of %zu", field->count());
+      fieldRenderer.reset();
+      field.reset();
+    }
+
     // Vertex shader
     const char *vertexShaderSource = R"(
             #version 120
@@ -45,21 +170,130 @@ protected:
             }
         )";
 
-    program = std::make_unique<QOpenGLShaderProgram>();
-    if (!program->addShaderFromSourceCode(QOpenGLShader::Vertex,
-                                          vertexShaderSource)) {
-      qFatal("Vertex shader compilation failed: %s",
-             qPrintable(program->log()));
+    // A fixed location lets the vertex array be recorded before drawing
+    program = shaderCache.link(
+        {{QOpenGLShader::Vertex, vertexShaderSource},
+         {QOpenGLShader::Fragment, fragmentShaderSource}},
+        {{"position", 0}});
+    if (!program) {
+      qFatal("Shader program compilation failed: %s",
+             qPrintable(shaderCache.log()));
+    }
+    modelLocation = program->uniformLocation("model");
+    viewLocation = program->uniformLocation("view");
+    projectionLocation = program->uniformLocation("projection");
+    markStartup("shaders");
+
+    camera.lookAt(QVector3D(0.0f, 0.0f, 5.0f), QVector3D(0.0f, 0.0f, 0.0f),
+                  QVector3D(0.0f, 1.0f, 0.0f));
+    camera.setPerspective(45.0f, 0.1f, 100.0f);
+
+    if (meshPath.empty() || !loadMesh())
+      createCubeBuffers();
+    vertexInput.create(vbo, ebo, {{0, 3, 3 * sizeof(GLfloat), 0}});
+    markStartup("upload");
+  }
+
+  void resizeGL(int w, int h) override {
+    glViewport(0, 0, w, h);
+    camera.setViewport(w, h);
+  }
+
+  void paintGL() override { paintFrame(*this); }
+
+private:
+  // The profiler overlay is painted on `overlayDevice`, the widget itself
+  // unless benchmarking
+  void paintFrame(QPaintDevice &overlayDevice) {
+    PROFILE_SCOPE("paintGL");
+    frameStats.markFrame();
+    QElapsedTimer paintTimer;
+    paintTimer.start();
+    gpuTimer.beginFrame();
+    // The overlay's QPainter turns depth testing off again
+    glEnable(GL_DEPTH_TEST);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    gpuTimer.mark("clear");
+
+    if (fieldRenderer)
+      paintField();
+    else
+      paintModel();
+    gpuTimer.mark(fieldRenderer ? "cubes" : "model");
+
+    if (profiler::overlayEnabled()) {
+      glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+      QPainter painter(&overlayDevice);
+      profiler::drawOverlay(painter, frameStats);
+      painter.end();
+      gpuTimer.mark("overlay");
     }
-    if (!program->addShaderFromSourceCode(QOpenGLShader::Fragment,
-                                          fragmentShaderSource)) {
-      qFatal("Fragment shader compilation failed: %s",
-             qPrintable(program->log()));
+    gpuTimer.endFrame();
+
+    if (startup && !startup->reported()) {
+      // The first frame only counts once the GL has finished drawing it
+      glFinish();
+      startup->mark("first paintGL");
+      startup->report(shaderCache.summary());
     }
-    if (!program->link()) {
-      qFatal("Shader program linking failed: %s", qPrintable(program->log()));
+
+    if (logPaintTimes) {
+      paintTimes.record(paintTimer.nsecsElapsed());
+      if (paintTimes.count() == 300) {
+        qInfo("paintGL CPU time over 300 frames (%s): mean %.1f us, "
+              "p99 %.1f us",
+              fieldRenderer ? "cube field" : "model", paintTimes.meanMs() * 1e3,
+              paintTimes.percentileMs(0.99) * 1e3);
+        paintTimes.reset();
+      }
+    }
+  }
+
+  void markStartup(const char *phase) {
+    if (startup)
+      startup->mark(phase);
+  }
+
+  void paintModel() {
+    program->bind();
+    // Uniforms keep their values in the program between frames
+    if (uploadedCameraRevision != camera.revision()) {
+      program->setUniformValue(viewLocation, camera.view());
+      program->setUniformValue(projectionLocation, camera.projection());
+      uploadedCameraRevision = camera.revision();
+    }
+    program->setUniformValue(modelLocation, modelMatrix);
+
+    vertexInput.bind();
+    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); // Set to wireframe mode
+    glDrawElements(drawMode, indexCount, indexType, nullptr);
+    vertexInput.release();
+    program->release();
+  }
+
+  void paintField() {
+    if (!culling) {
+      fieldRenderer->render(*field, camera.viewProjection());
+      return;
     }
+    QElapsedTimer cullTimer;
+    cullTimer.start();
+    const CullStats stats = fieldBvh.cull(
+        Frustum::fromMatrix(camera.viewProjection().constData()),
+        visibleCubes);
+    cullNs += cullTimer.nsecsElapsed();
+    ++culledFrames;
+    visibleTotal += stats.visibleObjects;
+    fieldRenderer->render(*field, camera.viewProjection(), visibleCubes);
+  }
+
+  const float *fieldOffsets(int axis) const {
+    return field->transforms() + (CubeField::OffsetX + axis) * field->stride();
+  }
 
+  void createCubeBuffers() {
     // Cube vertex data
     static const GLfloat cubeVertices[] = {
         -1.0f, -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, 1.0f, 1.0f,
@@ -83,58 +317,200 @@ protected:
                  GL_STATIC_DRAW);
   }
 
-  void resizeGL(int w, int h) override { glViewport(0, 0, w, h); }
-
-  void paintGL() override {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    program->bind();
-
-    QMatrix4x4 viewMatrix;
-    viewMatrix.lookAt(QVector3D(0.0f, 0.0f, 5.0f), QVector3D(0.0f, 0.0f, 0.0f),
-                      QVector3D(0.0f, 1.0f, 0.0f));
-
-    QMatrix4x4 projectionMatrix;
-    projectionMatrix.perspective(45.0f, float(width()) / height(), 0.1f,
-                                 100.0f);
-
-    program->setUniformValue("model", modelMatrix);
-    program->setUniformValue("view", viewMatrix);
-    program->setUniformValue("projection", projectionMatrix);
+  // Buffer mapping needs OpenGL 3.0 or OpenGL ES 3.0. The current context is
+  // the bench's rather than the widget's under --bench.
+  bool canMapBuffers() const {
+    const QSurfaceFormat format = QOpenGLContext::currentContext()->format();
+    return format.majorVersion() >= 3;
+  }
 
+  // Sizes the buffers from the loader's first pass, then lets it write
+  // straight into them through glMapBufferRange, or through a copy in memory
+  // on older contexts.
+  bool loadMesh() {
+    PROFILE_SCOPE("loadMesh");
+    MeshLoader loader;
+    if (!loader.open(meshPath)) {
+      qWarning("Could not load mesh: %s", loader.error().c_str());
+      return false;
+    }
+    const MeshLayout &layout = loader.layout();
+    glGenBuffers(1, &vbo);
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, layout.vertexBytes(), nullptr,
+                 GL_STATIC_DRAW);
+    glGenBuffers(1, &ebo);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    int posLocation = program->attributeLocation("position");
-    program->enableAttributeArray(posLocation);
-    glVertexAttribPointer(posLocation, 3, GL_FLOAT, GL_FALSE,
-                          3 * sizeof(GLfloat), nullptr);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, layout.indexBytes(), nullptr,
+                 GL_STATIC_DRAW);
 
-    glPolygonMode(GL_FRONT_AND_BACK, GL_LINE); // Set to wireframe mode
-    glDrawElements(GL_LINES, 24, GL_UNSIGNED_SHORT, nullptr);
+    const auto start = std::chrono::steady_clock::now();
+    bool loaded;
+    const bool mapped = canMapBuffers();
+    if (mapped) {
+      QOpenGLExtraFunctions *gl =
+          QOpenGLContext::currentContext()->extraFunctions();
+      const GLbitfield access =
+          GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT;
+      void *vertices = gl->glMapBufferRange(GL_ARRAY_BUFFER, 0,
+                                            layout.vertexBytes(), access);
+      void *indices = gl->glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0,
+                                           layout.indexBytes(), access);
+      loaded = vertices && indices &&
+               loader.load(static_cast<float *>(vertices), indices);
+      // The driver may drop mapped contents, e.g. on a display mode change
+      if (vertices && gl->glUnmapBuffer(GL_ARRAY_BUFFER) != GL_TRUE)
+        loaded = false;
+      if (indices && gl->glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER) != GL_TRUE)
+        loaded = false;
+    } else {
+      std::vector<float> vertices(layout.vertexCount * 3);
+      std::vector<unsigned char> indices(layout.indexBytes());
+      loaded = loader.load(vertices.data(), indices.data());
+      if (loaded) {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, layout.vertexBytes(),
+                        vertices.data());
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, layout.indexBytes(),
+                        indices.data());
+      }
+    }
+    if (!loaded) {
+      qWarning("Could not load mesh: %s", loader.error().empty()
+                                               ? "buffer mapping failed"
+                                               : loader.error().c_str());
+      glDeleteBuffers(1, &vbo);
+      glDeleteBuffers(1, &ebo);
+      return false;
+    }
+    const MeshLoadTimings &timings = loader.timings();
+    const double writeMs = std::chrono::duration<double, std::milli>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    qInfo("Loaded %s: %zu vertices, %zu triangles, %s indices",
+          meshPath.c_str(), layout.vertexCount, layout.indexCount / 3,
+          layout.wideIndices() ? "32-bit" : "16-bit");
+    qInfo("map %.1f ms, scan %.1f ms, parse %.1f ms, %s %.1f ms",
+          timings.mapMs, timings.scanMs, timings.parseMs,
+          mapped ? "unmap" : "upload", writeMs - timings.parseMs);
 
-    program->disableAttributeArray(posLocation);
-    program->release();
+    drawMode = GL_TRIANGLES;
+    indexCount = static_cast<GLsizei>(layout.indexCount);
+    indexType = layout.wideIndices() ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+    const MeshBounds &bounds = loader.bounds();
+    float extent = 0.0f;
+    for (int axis = 0; axis < 3; ++axis)
+      extent = std::max(extent, bounds.max[axis] - bounds.min[axis]);
+    meshMatrix.setToIdentity();
+    if (extent > 0.0f)
+      meshMatrix.scale(2.0f / extent);
+    meshMatrix.translate(-0.5f * (bounds.min[0] + bounds.max[0]),
+                         -0.5f * (bounds.min[1] + bounds.max[1]),
+                         -0.5f * (bounds.min[2] + bounds.max[2]));
+    return true;
   }
 
-private:
   void updateRotation() {
+    PROFILE_SCOPE("updateRotation");
+    stepRotation();
+    update();
+  }
+
+  void stepRotation() {
+    if (fieldRenderer)
+      updateField();
     angleX += 1.0f;
     angleY += 0.5f;
     if (angleX >= 360.0f)
       angleX -= 360.0f;
     if (angleY >= 360.0f)
       angleY -= 360.0f;
+    if (fieldRenderer)
+      camera.setYaw(angleY);
     modelMatrix.setToIdentity();
     modelMatrix.rotate(angleX, QVector3D(1.0f, 0.0f, 0.0f));
     modelMatrix.rotate(angleY, QVector3D(0.0f, 1.0f, 0.0f));
-    update();
+    modelMatrix *= meshMatrix;
+  }
+
+  // Logs the transform update cost against the frame interval every 120
+  // updates, so both can be compared as --cubes grows
+  void updateField() {
+    QElapsedTimer updateTimer;
+    updateTimer.start();
+    field->update(benchSteps >= 0 ? benchSteps * 0.016f
+                                  : fieldClock.nsecsElapsed() / 1e9f);
+    fieldUpdateNs += updateTimer.nsecsElapsed();
+    if (culling) {
+      updateTimer.restart();
+      fieldBvh.markMoved(0, field->count());
+      fieldBvh.refit(fieldOffsets(0), fieldOffsets(1), fieldOffsets(2));
+      fieldRefitNs += updateTimer.nsecsElapsed();
+    }
+    if (++fieldUpdates < 120)
+      return;
+    qInfo("%zu cubes on %u threads (%s): update %.3f ms, frame p50 %.2f ms, "
+          "p99 %.2f ms, %.0f fps",
+          field->count(), field->threads(),
+          transformKernelName(field->kernel()),
+          fieldUpdateNs / 1e6 / fieldUpdates, frameStats.percentileMs(0.5),
+          frameStats.percentileMs(0.99), frameStats.fps());
+    if (culling && culledFrames > 0)
+      qInfo("culling (%s): refit %.3f ms, cull %.3f ms, %zu visible, %zu "
+            "culled",
+            cullKernelName(fieldBvh.kernel()),
+            fieldRefitNs / 1e6 / fieldUpdates, cullNs / 1e6 / culledFrames,
+            visibleTotal / culledFrames,
+            field->count() - visibleTotal / culledFrames);
+    fieldUpdateNs = 0;
+    fieldRefitNs = 0;
+    fieldUpdates = 0;
+    cullNs = 0;
+    culledFrames = 0;
+    visibleTotal = 0;
   }
 };
 
 int main(int argc, char *argv[]) {
+  profiler::initFromEnvironment();
+  profiler::StartupTimings startup;
+
+  // --cubes N draws N instanced cubes, which needs a 3.3 core context that
+  // has to be requested before the application object exists
+  std::size_t cubes = 0;
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (std::strcmp(argv[i], "--cubes") == 0)
+      cubes = std::strtoull(argv[i + 1], nullptr, 10);
+  }
+  if (cubes > 0) {
+    QSurfaceFormat format;
+    format.setVersion(3, 3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    QSurfaceFormat::setDefaultFormat(format);
+  }
+
   QApplication app(argc, argv);
 
-  CubeGLWidget cubeWidget;
+  // --bench N renders N frames offscreen as fast as possible. The bench goes
+  // first so that its context outlives the widget's GL resources.
+  const int benchFrameCount = render::benchFrames(argc, argv);
+  std::optional<render::OffscreenBench> bench;
+  if (benchFrameCount > 0)
+    bench.emplace(QSize(800, 600));
+
+  // --mesh FILE draws an .obj or binary .ply mesh instead of the cube
+  const QStringList arguments = app.arguments();
+  const qsizetype meshIndex = arguments.indexOf("--mesh");
+  CubeGLWidget cubeWidget(meshIndex >= 0 && meshIndex + 1 < arguments.size()
+                              ? arguments[meshIndex + 1].toStdString()
+                              : std::string(),
+                          cubes);
+  cubeWidget.setFrameStatsEnabled(arguments.contains("--frame-stats"));
+  cubeWidget.setCulling(!arguments.contains("--no-cull"));
+  if (bench)
+    return bench->run(cubeWidget, benchFrameCount);
+
+  startup.mark("application");
+  cubeWidget.setStartupTimings(&startup);
   cubeWidget.resize(800, 600);
   cubeWidget.show();
 
@@ -0,0 +1,396 @@
+#include "CubeField.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "Profiler.hpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define CUBE_FIELD_X86 1
+#endif
+
+namespace {
+
+using Kernel = void (*)(const float *inputs, float *transforms,
+                        std::size_t stride, std::size_t begin,
+                        std::size_t end, float seconds);
+
+// Per-cube state, one stream of CubeField::stride() floats each
+enum Input { BaseX, BaseY, BaseZ, AxisX, AxisY, AxisZ, Spin, Phase, kInputs };
+
+// Cubes are 2 units wide with a gap of 2 between them
+constexpr float kSpacing = 4.0f;
+constexpr float kBobHeight = 0.5f;
+// Below this many cubes per thread, waking the workers costs more than
+// updating the cubes
+constexpr std::size_t kMinSliceCubes = 4096;
+
+// Reduction to [-pi, pi] subtracts 2*pi in two parts; the first part has few
+// enough bits that k * kTwoPiHigh is exact.
+constexpr float kInverseTwoPi = 0.159154943f;
+constexpr float kTwoPiHigh = 6.28125f;
+constexpr float kTwoPiLow = 1.93530718e-3f;
+
+// Taylor series of sin and cos, accurate to about 4e-6 on [-pi/2, pi/2]
+constexpr float kSin3 = -1.0f / 6.0f;
+constexpr float kSin5 = 1.0f / 120.0f;
+constexpr float kSin7 = -1.0f / 5040.0f;
+constexpr float kSin9 = 1.0f / 362880.0f;
+constexpr float kCos2 = -1.0f / 2.0f;
+constexpr float kCos4 = 1.0f / 24.0f;
+constexpr float kCos6 = -1.0f / 720.0f;
+constexpr float kCos8 = 1.0f / 40320.0f;
+constexpr float kCos10 = -1.0f / 3628800.0f;
+
+// Each cube is rotated by `angle` about its axis, so its quaternion holds the
+// sine and cosine of angle / 2. That half angle is reduced to [-pi, pi] and
+// halved once more to stay where the series is accurate, then doubled back
+// with the double-angle formulas. The bob height uses sin(angle), from the
+// same formulas. All kernels follow the same steps.
+
+void transformScalar(const float *inputs, float *transforms,
+                     std::size_t stride, std::size_t begin, std::size_t end,
+                     float seconds) {
+  const float *in[kInputs];
+  float *out[CubeField::kStreams];
+  for (std::size_t i = 0; i < kInputs; ++i)
+    in[i] = inputs + i * stride;
+  for (std::size_t i = 0; i < CubeField::kStreams; ++i)
+    out[i] = transforms + i * stride;
+
+  for (std::size_t i = begin; i < end; ++i) {
+    const float angle = in[Phase][i] + in[Spin][i] * seconds;
+    float half = 0.5f * angle;
+    const float turns = std::nearbyint(half * kInverseTwoPi);
+    half = (half - turns * kTwoPiHigh) - turns * kTwoPiLow;
+    const float quarter = 0.5f * half;
+    const float q2 = quarter * quarter;
+    const float sinQuarter =
+        quarter *
+        (1.0f + q2 * (kSin3 + q2 * (kSin5 + q2 * (kSin7 + q2 * kSin9))));
+    const float cosQuarter =
+        1.0f +
+        q2 * (kCos2 + q2 * (kCos4 + q2 * (kCos6 + q2 * (kCos8 + q2 * kCos10))));
+    const float sinHalf = 2.0f * sinQuarter * cosQuarter;
+    const float cosHalf = 1.0f - 2.0f * sinQuarter * sinQuarter;
+
+    out[CubeField::RotationX][i] = in[AxisX][i] * sinHalf;
+    out[CubeField::RotationY][i] = in[AxisY][i] * sinHalf;
+    out[CubeField::RotationZ][i] = in[AxisZ][i] * sinHalf;
+    out[CubeField::RotationW][i] = cosHalf;
+    out[CubeField::OffsetX][i] = in[BaseX][i];
+    out[CubeField::OffsetY][i] =
+        in[BaseY][i] + 2.0f * kBobHeight * (sinHalf * cosHalf);
+    out[CubeField::OffsetZ][i] = in[BaseZ][i];
+  }
+}
+
+#ifdef CUBE_FIELD_X86
+
+// Slices start and end on multiples of 16 floats and streams are 64-byte
+// aligned, so both kernels cover them in whole aligned registers.
+
+void transformSse2(const float *inputs, float *transforms, std::size_t stride,
+                   std::size_t begin, std::size_t end, float seconds) {
+  const float *in[kInputs];
+  float *out[CubeField::kStreams];
+  for (std::size_t i = 0; i < kInputs; ++i)
+    in[i] = inputs + i * stride;
+  for (std::size_t i = 0; i < CubeField::kStreams; ++i)
+    out[i] = transforms + i * stride;
+
+  const __m128 time = _mm_set1_ps(seconds);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 two = _mm_set1_ps(2.0f);
+  const __m128 bob = _mm_set1_ps(2.0f * kBobHeight);
+  for (std::size_t i = begin; i < end; i += 4) {
+    const __m128 angle =
+        _mm_add_ps(_mm_load_ps(in[Phase] + i),
+                   _mm_mul_ps(_mm_load_ps(in[Spin] + i), time));
+    __m128 h = _mm_mul_ps(half, angle);
+    const __m128 turns = _mm_cvtepi32_ps(
+        _mm_cvtps_epi32(_mm_mul_ps(h, _mm_set1_ps(kInverseTwoPi))));
+    h = _mm_sub_ps(h, _mm_mul_ps(turns, _mm_set1_ps(kTwoPiHigh)));
+    h = _mm_sub_ps(h, _mm_mul_ps(turns, _mm_set1_ps(kTwoPiLow)));
+    const __m128 q = _mm_mul_ps(half, h);
+    const __m128 q2 = _mm_mul_ps(q, q);
+    __m128 s = _mm_mul_ps(q2, _mm_set1_ps(kSin9));
+    s = _mm_mul_ps(q2, _mm_add_ps(_mm_set1_ps(kSin7), s));
+    s = _mm_mul_ps(q2, _mm_add_ps(_mm_set1_ps(kSin5), s));
+    s = _mm_mul_ps(q2, _mm_add_ps(_mm_set1_ps(kSin3), s));
+    const __m128 sinQuarter = _mm_mul_ps(q, _mm_add_ps(one, s));
+    __m128 c = _mm_mul_ps(q2, _mm_set1_ps(kCos10));
+    c = _mm_mul_ps(q2, _mm_add_ps(_mm_set1_ps(kCos8), c));
+    c = _mm_mul_ps(q2, _mm_add_ps(_mm_set1_ps(kCos6), c));
+    c = _mm_mul_ps(q2, _mm_add_ps(_mm_set1_ps(kCos4), c));
+    c = _mm_mul_ps(q2, _mm_add_ps(_mm_set1_ps(kCos2), c));
+    const __m128 cosQuarter = _mm_add_ps(one, c);
+    const __m128 sinHalf = _mm_mul_ps(two, _mm_mul_ps(sinQuarter, cosQuarter));
+    const __m128 cosHalf =
+        _mm_sub_ps(one, _mm_mul_ps(two, _mm_mul_ps(sinQuarter, sinQuarter)));
+
+    _mm_store_ps(out[CubeField::RotationX] + i,
+                 _mm_mul_ps(_mm_load_ps(in[AxisX] + i), sinHalf));
+    _mm_store_ps(out[CubeField::RotationY] + i,
+                 _mm_mul_ps(_mm_load_ps(in[AxisY] + i), sinHalf));
+    _mm_store_ps(out[CubeField::RotationZ] + i,
+                 _mm_mul_ps(_mm_load_ps(in[AxisZ] + i), sinHalf));
+    _mm_store_ps(out[CubeField::RotationW] + i, cosHalf);
+    _mm_store_ps(out[CubeField::OffsetX] + i, _mm_load_ps(in[BaseX] + i));
+    _mm_store_ps(out[CubeField::OffsetY] + i,
+                 _mm_add_ps(_mm_load_ps(in[BaseY] + i),
+                            _mm_mul_ps(bob, _mm_mul_ps(sinHalf, cosHalf))));
+    _mm_store_ps(out[CubeField::OffsetZ] + i, _mm_load_ps(in[BaseZ] + i));
+  }
+}
+
+__attribute__((target("avx2"))) void
+transformAvx2(const float *inputs, float *transforms, std::size_t stride,
+              std::size_t begin, std::size_t end, float seconds) {
+  const float *in[kInputs];
+  float *out[CubeField::kStreams];
+  for (std::size_t i = 0; i < kInputs; ++i)
+    in[i] = inputs + i * stride;
+  for (std::size_t i = 0; i < CubeField::kStreams; ++i)
+    out[i] = transforms + i * stride;
+
+  const __m256 time = _mm256_set1_ps(seconds);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  const __m256 bob = _mm256_set1_ps(2.0f * kBobHeight);
+  for (std::size_t i = begin; i < end; i += 8) {
+    const __m256 angle =
+        _mm256_add_ps(_mm256_load_ps(in[Phase] + i),
+                      _mm256_mul_ps(_mm256_load_ps(in[Spin] + i), time));
+    __m256 h = _mm256_mul_ps(half, angle);
+    const __m256 turns =
+        _mm256_round_ps(_mm256_mul_ps(h, _mm256_set1_ps(kInverseTwoPi)),
+                        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    h = _mm256_sub_ps(h, _mm256_mul_ps(turns, _mm256_set1_ps(kTwoPiHigh)));
+    h = _mm256_sub_ps(h, _mm256_mul_ps(turns, _mm256_set1_ps(kTwoPiLow)));
+    const __m256 q = _mm256_mul_ps(half, h);
+    const __m256 q2 = _mm256_mul_ps(q, q);
+    __m256 s = _mm256_mul_ps(q2, _mm256_set1_ps(kSin9));
+    s = _mm256_mul_ps(q2, _mm256_add_ps(_mm256_set1_ps(kSin7), s));
+    s = _mm256_mul_ps(q2, _mm256_add_ps(_mm256_set1_ps(kSin5), s));
+    s = _mm256_mul_ps(q2, _mm256_add_ps(_mm256_set1_ps(kSin3), s));
+    const __m256 sinQuarter = _mm256_mul_ps(q, _mm256_add_ps(one, s));
+    __m256 c = _mm256_mul_ps(q2, _mm256_set1_ps(kCos10));
+    c = _mm256_mul_ps(q2, _mm256_add_ps(_mm256_set1_ps(kCos8), c));
+    c = _mm256_mul_ps(q2, _mm256_add_ps(_mm256_set1_ps(kCos6), c));
+    c = _mm256_mul_ps(q2, _mm256_add_ps(_mm256_set1_ps(kCos4), c));
+    c = _mm256_mul_ps(q2, _mm256_add_ps(_mm256_set1_ps(kCos2), c));
+    const __m256 cosQuarter = _mm256_add_ps(one, c);
+    const __m256 sinHalf =
+        _mm256_mul_ps(two, _mm256_mul_ps(sinQuarter, cosQuarter));
+    const __m256 cosHalf = _mm256_sub_ps(
+        one, _mm256_mul_ps(two, _mm256_mul_ps(sinQuarter, sinQuarter)));
+
+    _mm256_store_ps(out[CubeField::RotationX] + i,
+                    _mm256_mul_ps(_mm256_load_ps(in[AxisX] + i), sinHalf));
+    _mm256_store_ps(out[CubeField::RotationY] + i,
+                    _mm256_mul_ps(_mm256_load_ps(in[AxisY] + i), sinHalf));
+    _mm256_store_ps(out[CubeField::RotationZ] + i,
+                    _mm256_mul_ps(_mm256_load_ps(in[AxisZ] + i), sinHalf));
+    _mm256_store_ps(out[CubeField::RotationW] + i, cosHalf);
+    _mm256_store_ps(out[CubeField::OffsetX] + i, _mm256_load_ps(in[BaseX] + i));
+    _mm256_store_ps(
+        out[CubeField::OffsetY] + i,
+        _mm256_add_ps(_mm256_load_ps(in[BaseY] + i),
+                      _mm256_mul_ps(bob, _mm256_mul_ps(sinHalf, cosHalf))));
+    _mm256_store_ps(out[CubeField::OffsetZ] + i, _mm256_load_ps(in[BaseZ] + i));
+  }
+}
+
+#endif
+
+Kernel kernelFunction(TransformKernel kernel) {
+  switch (kernel) {
+#ifdef CUBE_FIELD_X86
+  case TransformKernel::Sse2:
+    return transformSse2;
+  case TransformKernel::Avx2:
+    return transformAvx2;
+#endif
+  default:
+    return transformScalar;
+  }
+}
+
+} // namespace
+
+TransformKernel bestTransformKernel() {
+  static const TransformKernel best = [] {
+    if (transformKernelSupported(TransformKernel::Avx2))
+      return TransformKernel::Avx2;
+    if (transformKernelSupported(TransformKernel::Sse2))
+      return TransformKernel::Sse2;
+    return TransformKernel::Scalar;
+  }();
+  return best;
+}
+
+bool transformKernelSupported(TransformKernel kernel) {
+  switch (kernel) {
+  case TransformKernel::Scalar:
+    return true;
+#ifdef CUBE_FIELD_X86
+  case TransformKernel::Sse2:
+    return __builtin_cpu_supports("sse2");
+  case TransformKernel::Avx2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+const char *transformKernelName(TransformKernel kernel) {
+  switch (kernel) {
+  case TransformKernel::Sse2:
+    return "sse2";
+  case TransformKernel::Avx2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+void CubeField::AlignedDelete::operator()(float *data) const {
+  std::free(data);
+}
+
+CubeField::AlignedFloats CubeField::allocate(std::size_t floats) {
+  // aligned_alloc needs a multiple of the alignment
+  const std::size_t bytes =
+      std::max<std::size_t>((floats * sizeof(float) + 63) / 64 * 64, 64);
+  auto *data = static_cast<float *>(std::aligned_alloc(64, bytes));
+  if (!data)
+    throw std::bad_alloc();
+  std::memset(data, 0, bytes);
+  return AlignedFloats(data);
+}
+
+CubeField::CubeField(std::size_t count, unsigned int threads,
+                     std::uint32_t seed)
+    : count_(count), stride_((count + 15) / 16 * 16),
+      inputs_(allocate(kInputs * stride_)),
+      transforms_(allocate(kStreams * stride_)),
+      kernel_(bestTransformKernel()),
+      threadCount_(static_cast<unsigned int>(std::max<std::size_t>(
+          std::min<std::size_t>(threads, stride_ / kMinSliceCubes), 1))) {
+  const auto side = static_cast<std::size_t>(
+      std::ceil(std::cbrt(static_cast<double>(count))));
+  extent_ = 0.5f * kSpacing * static_cast<float>(side);
+  std::mt19937 rng(seed);
+  std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+  std::uniform_real_distribution<float> spin(0.5f, 2.0f);
+  std::uniform_real_distribution<float> phase(0.0f, 6.28318531f);
+  float *in[kInputs];
+  for (std::size_t i = 0; i < kInputs; ++i)
+    in[i] = inputs_.get() + i * stride_;
+  // Cells are filled one 4x4x4 brick at a time, so every run of 64
+  // consecutive cubes is a compact block that SceneBvh can cull as one leaf
+  const std::size_t bricks = (side + 3) / 4;
+  std::size_t brick = 0;
+  std::size_t local = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    std::size_t cell[3];
+    do {
+      cell[0] = brick % bricks * 4 + local % 4;
+      cell[1] = brick / bricks % bricks * 4 + local / 4 % 4;
+      cell[2] = brick / bricks / bricks * 4 + local / 16;
+      if (++local == 64) {
+        local = 0;
+        ++brick;
+      }
+    } while (cell[0] >= side || cell[1] >= side || cell[2] >= side);
+    for (int axis = 0; axis < 3; ++axis)
+      in[BaseX + axis][i] =
+          (static_cast<float>(cell[axis]) + 0.5f) * kSpacing - extent_;
+    // Uniform direction: a point in the unit ball, scaled to length 1
+    float axis[3];
+    float length;
+    do {
+      for (float &component : axis)
+        component = unit(rng);
+      length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] +
+                         axis[2] * axis[2]);
+    } while (length > 1.0f || length < 1e-3f);
+    for (int k = 0; k < 3; ++k)
+      in[AxisX + k][i] = axis[k] / length;
+    in[Spin][i] = unit(rng) < 0.0f ? -spin(rng) : spin(rng);
+    in[Phase][i] = phase(rng);
+  }
+
+  for (unsigned int slice = 1; slice < threadCount_; ++slice)
+    workers_.emplace_back([this, slice] { workerLoop(slice); });
+  update(0.0f);
+}
+
+CubeField::~CubeField() {
+  {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (auto &worker : workers_)
+    worker.join();
+}
+
+void CubeField::setKernel(TransformKernel kernel) {
+  if (transformKernelSupported(kernel))
+    kernel_ = kernel;
+}
+
+void CubeField::update(float seconds) {
+  PROFILE_SCOPE("CubeField::update");
+  seconds_ = seconds;
+  if (workers_.empty()) {
+    updateSlice(0);
+    return;
+  }
+  {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    pending_ = threadCount_ - 1;
+    ++generation_;
+  }
+  wake_.notify_all();
+  updateSlice(0);
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void CubeField::updateSlice(unsigned int slice) {
+  // Whole cache lines, so no two threads write to the same one
+  const std::size_t lines = stride_ / 16;
+  const std::size_t begin = lines * slice / threadCount_ * 16;
+  const std::size_t end = lines * (slice + 1) / threadCount_ * 16;
+  kernelFunction(kernel_)(inputs_.get(), transforms_.get(), stride_, begin,
+                          end, seconds_);
+}
+
+void CubeField::workerLoop(unsigned int slice) {
+  std::uint64_t seen = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+      if (stopping_)
+        return;
+      seen = generation_;
+    }
+
+    updateSlice(slice);
+
+    const std::lock_guard<std::mutex> lock(mutex_);
+    if (--pending_ == 0)
+      done_.notify_one();
+  }
+}
@@ -0,0 +1,155 @@
+#include "CubeFieldRenderer.hpp"
+
+#include <QDebug>
+#include <cstring>
+
+namespace {
+
+// Attribute 0 is the cube corner; the transform streams follow in
+// CubeField::Stream order
+const char *vertexShaderSource = R"(
+    #version 330 core
+    layout(location = 0) in vec3 position;
+    layout(location = 1) in float rotationX;
+    layout(location = 2) in float rotationY;
+    layout(location = 3) in float rotationZ;
+    layout(location = 4) in float rotationW;
+    layout(location = 5) in float offsetX;
+    layout(location = 6) in float offsetY;
+    layout(location = 7) in float offsetZ;
+    uniform mat4 viewProjection;
+    out vec3 color;
+    void main() {
+        // Rotation by a unit quaternion, without building a matrix
+        vec3 axis = vec3(rotationX, rotationY, rotationZ);
+        vec3 t = 2.0 * cross(axis, position);
+        vec3 rotated = position + rotationW * t + cross(axis, t);
+        vec3 offset = vec3(offsetX, offsetY, offsetZ);
+        gl_Position = viewProjection * vec4(rotated + offset, 1.0);
+        color = 0.6 + 0.4 * normalize(offset + vec3(1e-3));
+    }
+)";
+
+const char *fragmentShaderSource = R"(
+    #version 330 core
+    in vec3 color;
+    out vec4 fragColor;
+    void main() {
+        fragColor = vec4(color, 1.0);
+    }
+)";
+
+} // namespace
+
+CubeFieldRenderer::~CubeFieldRenderer() {
+  // The owner makes the context current before destroying the renderer
+  if (vao_ == 0)
+    return;
+  glDeleteBuffers(1, &instanceBuffer_);
+  glDeleteBuffers(1, &indexBuffer_);
+  glDeleteBuffers(1, &cubeBuffer_);
+  glDeleteVertexArrays(1, &vao_);
+}
+
+bool CubeFieldRenderer::initialize(render::ShaderCache &shaders) {
+  initializeOpenGLFunctions();
+
+  program_ = shaders.link({{QOpenGLShader::Vertex, vertexShaderSource},
+                           {QOpenGLShader::Fragment, fragmentShaderSource}});
+  if (!program_) {
+    qWarning() << "Cube field renderer unavailable:" << shaders.log();
+    return false;
+  }
+  viewProjectionLocation_ = program_->uniformLocation("viewProjection");
+  return true;
+}
+
+void CubeFieldRenderer::upload(const CubeField &field) {
+  // The same wireframe cube as the single-cube view
+  static const GLfloat cubeVertices[] = {
+      -1.0f, -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, 1.0f, 1.0f,
+      -1.0f, -1.0f, 1.0f,  -1.0f, -1.0f, -1.0f, 1.0f, 1.0f,
+      -1.0f, 1.0f,  1.0f,  1.0f,  1.0f,  -1.0f, 1.0f, 1.0f};
+  static const GLushort cubeIndices[] = {0, 1, 1, 2, 2, 3, 3, 0,
+                                         4, 5, 5, 6, 6, 7, 7, 4,
+                                         0, 4, 1, 5, 2, 6, 3, 7};
+
+  glGenVertexArrays(1, &vao_);
+  glBindVertexArray(vao_);
+  glGenBuffers(1, &cubeBuffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, cubeBuffer_);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), cubeVertices,
+               GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat),
+                        nullptr);
+  glGenBuffers(1, &indexBuffer_);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cubeIndices), cubeIndices,
+               GL_STATIC_DRAW);
+
+  glGenBuffers(1, &instanceBuffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer_);
+  glBufferData(GL_ARRAY_BUFFER, field.transformBytes(), nullptr,
+               GL_STREAM_DRAW);
+  for (GLuint stream = 0; stream < CubeField::kStreams; ++stream) {
+    const std::size_t offset = stream * field.stride() * sizeof(GLfloat);
+    glEnableVertexAttribArray(1 + stream);
+    glVertexAttribPointer(1 + stream, 1, GL_FLOAT, GL_FALSE, sizeof(GLfloat),
+                          reinterpret_cast<const void *>(offset));
+    glVertexAttribDivisor(1 + stream, 1);
+  }
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void CubeFieldRenderer::render(const CubeField &field,
+                               const QMatrix4x4 &viewProjection) {
+  glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer_);
+  glBufferData(GL_ARRAY_BUFFER, field.transformBytes(), nullptr,
+               GL_STREAM_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, field.transformBytes(),
+                  field.transforms());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  draw(viewProjection, static_cast<GLsizei>(field.count()));
+}
+
+void CubeFieldRenderer::render(const CubeField &field,
+                               const QMatrix4x4 &viewProjection,
+                               const std::vector<ObjectRange> &visible) {
+  // Invalidating the whole buffer orphans it, as glBufferData does above
+  glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer_);
+  auto *mapped = static_cast<float *>(glMapBufferRange(
+      GL_ARRAY_BUFFER, 0, field.transformBytes(),
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+  std::size_t instances = 0;
+  if (mapped) {
+    for (std::size_t stream = 0; stream < CubeField::kStreams; ++stream) {
+      const float *source = field.transforms() + stream * field.stride();
+      float *target = mapped + stream * field.stride();
+      instances = 0;
+      for (const ObjectRange &range : visible) {
+        std::memcpy(target + instances, source + range.begin,
+                    (range.end - range.begin) * sizeof(float));
+        instances += range.end - range.begin;
+      }
+    }
+    // The driver may drop mapped contents, e.g. on a display mode change
+    if (glUnmapBuffer(GL_ARRAY_BUFFER) != GL_TRUE)
+      instances = 0;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  draw(viewProjection, static_cast<GLsizei>(instances));
+}
+
+void CubeFieldRenderer::draw(const QMatrix4x4 &viewProjection,
+                             GLsizei instances) {
+  if (instances == 0)
+    return;
+  program_->bind();
+  program_->setUniformValue(viewProjectionLocation_, viewProjection);
+  glBindVertexArray(vao_);
+  glDrawElementsInstanced(GL_LINES, 24, GL_UNSIGNED_SHORT, nullptr, instances);
+  glBindVertexArray(0);
+  program_->release();
+}
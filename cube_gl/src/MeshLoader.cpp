@@ -0,0 +1,663 @@
+#include "MeshLoader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <string_view>
+
+#include "Profiler.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double millisecondsSince(Clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(Clock::now() - start)
+      .count();
+}
+
+// Calls body(i) for every i in [0, count) on up to `threads` threads. Indices
+// are handed out one at a time so uneven chunks balance out.
+template <typename Body>
+void parallelFor(unsigned int threads, std::size_t count, const Body &body) {
+  std::atomic<std::size_t> next{0};
+  const auto work = [&] {
+    for (std::size_t i; (i = next.fetch_add(1)) < count;)
+      body(i);
+  };
+  std::vector<std::thread> helpers;
+  for (std::size_t t = 1; t < std::min<std::size_t>(threads, count); ++t)
+    helpers.emplace_back(work);
+  work();
+  for (auto &helper : helpers)
+    helper.join();
+}
+
+// Enough chunks to balance the threads, but not so many that tiny files pay
+// for thread start-up
+std::size_t chunkCount(unsigned int threads, std::size_t items,
+                       std::size_t itemsPerChunk) {
+  return std::clamp<std::size_t>(items / itemsPerChunk, 1,
+                                 std::size_t(threads) * 4);
+}
+
+bool isBlank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+const char *skipBlanks(const char *p, const char *end) {
+  while (p < end && isBlank(*p))
+    ++p;
+  return p;
+}
+
+const char *skipToken(const char *p, const char *end) {
+  while (p < end && !isBlank(*p))
+    ++p;
+  return p;
+}
+
+const char *endOfLine(const char *p, const char *end) {
+  const void *newline = std::memchr(p, '\n', end - p);
+  return newline ? static_cast<const char *>(newline) : end;
+}
+
+// Decimal number with optional fraction and exponent, without the locale
+// lookups and allocation of strtof. Returns nullptr if there is no number.
+const char *parseFloat(const char *p, const char *end, float &value) {
+  static constexpr double kPowers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                       1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                       1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                       1e18, 1e19, 1e20, 1e21, 1e22};
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+'))
+    negative = *p++ == '-';
+  std::uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  bool any = false;
+  for (; p < end && isDigit(*p); ++p, any = true) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += mantissa != 0;
+    } else {
+      ++exponent;
+    }
+  }
+  if (p < end && *p == '.') {
+    for (++p; p < end && isDigit(*p); ++p, any = true) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits += mantissa != 0;
+        --exponent;
+      }
+    }
+  }
+  if (!any)
+    return nullptr;
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    ++p;
+    bool negativeExponent = false;
+    if (p < end && (*p == '-' || *p == '+'))
+      negativeExponent = *p++ == '-';
+    int written = 0;
+    for (; p < end && isDigit(*p); ++p)
+      written = std::min(written * 10 + (*p - '0'), 1000);
+    exponent += negativeExponent ? -written : written;
+  }
+  double result = static_cast<double>(mantissa);
+  if (exponent >= 0)
+    result *= exponent <= 22 ? kPowers[exponent] : std::pow(10.0, exponent);
+  else
+    result /= exponent >= -22 ? kPowers[-exponent] : std::pow(10.0, -exponent);
+  value = static_cast<float>(negative ? -result : result);
+  return p;
+}
+
+// OBJ face element such as "12", "-3" or "12/4/7"; only the position index is
+// used. Returns nullptr if it does not start with an integer.
+const char *parseFaceIndex(const char *p, const char *end, long long &value) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+'))
+    negative = *p++ == '-';
+  if (p == end || !isDigit(*p))
+    return nullptr;
+  value = 0;
+  for (; p < end && isDigit(*p); ++p)
+    value = std::min(value * 10 + (*p - '0'), 1LL << 40);
+  if (negative)
+    value = -value;
+  return skipToken(p, end);
+}
+
+struct ChunkBounds {
+  float min[3] = {std::numeric_limits<float>::max(),
+                  std::numeric_limits<float>::max(),
+                  std::numeric_limits<float>::max()};
+  float max[3] = {std::numeric_limits<float>::lowest(),
+                  std::numeric_limits<float>::lowest(),
+                  std::numeric_limits<float>::lowest()};
+
+  void add(const float *position) {
+    for (int k = 0; k < 3; ++k) {
+      min[k] = std::min(min[k], position[k]);
+      max[k] = std::max(max[k], position[k]);
+    }
+  }
+};
+
+MeshBounds mergeBounds(const std::vector<ChunkBounds> &chunks) {
+  ChunkBounds merged;
+  for (const ChunkBounds &chunk : chunks) {
+    // Chunks without vertices still hold the empty range
+    if (chunk.min[0] > chunk.max[0])
+      continue;
+    merged.add(chunk.min);
+    merged.add(chunk.max);
+  }
+  MeshBounds bounds;
+  std::copy(merged.min, merged.min + 3, bounds.min);
+  std::copy(merged.max, merged.max + 3, bounds.max);
+  return bounds;
+}
+
+} // namespace
+
+MeshLoader::MeshLoader(unsigned int threads)
+    : threads_(threads > 0 ? threads : 1) {}
+
+bool MeshLoader::fail(std::string message) {
+  error_ = std::move(message);
+  file_.close();
+  return false;
+}
+
+bool MeshLoader::open(const std::string &path) {
+  PROFILE_SCOPE("MeshLoader::open");
+  error_.clear();
+  layout_ = {};
+  chunks_.clear();
+  ply_ = {};
+  timings_ = {};
+
+  std::string extension = path.substr(std::min(path.size(), path.rfind('.')));
+  std::transform(extension.begin(), extension.end(), extension.begin(),
+                 [](unsigned char c) { return std::tolower(c); });
+  if (extension == ".obj")
+    format_ = Format::Obj;
+  else if (extension == ".ply")
+    format_ = Format::Ply;
+  else
+    return fail(path + ": not an .obj or .ply file");
+
+  auto start = Clock::now();
+  if (!file_.open(path))
+    return fail(path + ": " + std::strerror(errno));
+  timings_.mapMs = millisecondsSince(start);
+
+  start = Clock::now();
+  const bool scanned = format_ == Format::Obj ? scanObj() : scanPly();
+  timings_.scanMs = millisecondsSince(start);
+  if (!scanned)
+    return false;
+  if (layout_.indexCount == 0)
+    return fail(path + ": no triangles");
+  if (layout_.vertexCount > std::numeric_limits<std::uint32_t>::max())
+    return fail(path + ": too many vertices for 32-bit indices");
+  return true;
+}
+
+bool MeshLoader::load(float *vertices, void *indices) {
+  PROFILE_SCOPE("MeshLoader::load");
+  if (file_.contents().empty())
+    return fail("no mesh opened");
+  const auto start = Clock::now();
+  bool loaded;
+  if (format_ == Format::Obj)
+    loaded = layout_.wideIndices()
+                 ? parseObj(vertices, static_cast<std::uint32_t *>(indices))
+                 : parseObj(vertices, static_cast<std::uint16_t *>(indices));
+  else
+    loaded = layout_.wideIndices()
+                 ? parsePly(vertices, static_cast<std::uint32_t *>(indices))
+                 : parsePly(vertices, static_cast<std::uint16_t *>(indices));
+  timings_.parseMs = millisecondsSince(start);
+  file_.close();
+  return loaded;
+}
+
+// Chunks start at line starts; each counts its "v" and "f" lines
+bool MeshLoader::scanObj() {
+  const std::string_view text = file_.contents();
+  const std::size_t count = chunkCount(threads_, text.size(), 1 << 20);
+  chunks_.resize(count);
+  std::size_t previous = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    std::size_t begin = text.size() * i / count;
+    if (begin > 0 && text[begin - 1] != '\n') {
+      const std::size_t newline = text.find('\n', begin);
+      begin = newline == std::string_view::npos ? text.size() : newline + 1;
+    }
+    chunks_[i].begin = std::max(begin, previous);
+    previous = chunks_[i].begin;
+    if (i > 0)
+      chunks_[i - 1].end = chunks_[i].begin;
+  }
+  chunks_.back().end = text.size();
+
+  parallelFor(threads_, count, [&](std::size_t i) {
+    Chunk &chunk = chunks_[i];
+    const char *p = text.data() + chunk.begin;
+    const char *end = text.data() + chunk.end;
+    while (p < end) {
+      const char *lineEnd = endOfLine(p, end);
+      const char *q = skipBlanks(p, lineEnd);
+      if (lineEnd - q >= 2 && isBlank(q[1])) {
+        if (q[0] == 'v') {
+          ++chunk.vertices;
+        } else if (q[0] == 'f') {
+          std::size_t corners = 0;
+          for (q = skipBlanks(q + 1, lineEnd); q < lineEnd;
+               q = skipBlanks(skipToken(q, lineEnd), lineEnd))
+            ++corners;
+          if (corners >= 3)
+            chunk.indices += 3 * (corners - 2);
+        }
+      }
+      p = lineEnd + 1;
+    }
+  });
+
+  for (Chunk &chunk : chunks_) {
+    chunk.firstVertex = layout_.vertexCount;
+    chunk.firstIndex = layout_.indexCount;
+    layout_.vertexCount += chunk.vertices;
+    layout_.indexCount += chunk.indices;
+  }
+  return true;
+}
+
+template <typename Index>
+bool MeshLoader::parseObj(float *vertices, Index *indices) {
+  const std::string_view text = file_.contents();
+  const auto vertexCount = static_cast<long long>(layout_.vertexCount);
+  std::vector<ChunkBounds> bounds(chunks_.size());
+  std::atomic<bool> malformed{false};
+
+  parallelFor(threads_, chunks_.size(), [&](std::size_t i) {
+    const Chunk &chunk = chunks_[i];
+    const char *p = text.data() + chunk.begin;
+    const char *end = text.data() + chunk.end;
+    std::size_t vertex = chunk.firstVertex;
+    Index *out = indices + chunk.firstIndex;
+    bool bad = false;
+    while (p < end) {
+      const char *lineEnd = endOfLine(p, end);
+      const char *q = skipBlanks(p, lineEnd);
+      if (lineEnd - q >= 2 && isBlank(q[1]) && q[0] == 'v') {
+        float position[3] = {};
+        q += 1;
+        for (float &coordinate : position) {
+          q = parseFloat(skipBlanks(q, lineEnd), lineEnd, coordinate);
+          if (!q) {
+            bad = true;
+            break;
+          }
+        }
+        std::copy(position, position + 3, vertices + 3 * vertex);
+        bounds[i].add(position);
+        ++vertex;
+      } else if (lineEnd - q >= 2 && isBlank(q[1]) && q[0] == 'f') {
+        // Triangle fan around the first corner
+        Index first = 0;
+        Index previous = 0;
+        int corners = 0;
+        for (q = skipBlanks(q + 1, lineEnd); q < lineEnd;
+             q = skipBlanks(q, lineEnd)) {
+          long long value = 0;
+          const char *next = parseFaceIndex(q, lineEnd, value);
+          // Negative indices count back from the latest vertex
+          const long long resolved =
+              value > 0 ? value - 1
+                        : static_cast<long long>(vertex) + value;
+          if (!next || value == 0 || resolved < 0 ||
+              resolved >= vertexCount) {
+            bad = true;
+            // Keep the corner so the counted index slots are still filled
+            next = next ? next : skipToken(q, lineEnd);
+          }
+          q = next;
+          const auto index = static_cast<Index>(
+              resolved >= 0 && resolved < vertexCount ? resolved : 0);
+          if (corners == 0) {
+            first = index;
+          } else if (corners >= 2) {
+            out[0] = first;
+            out[1] = previous;
+            out[2] = index;
+            out += 3;
+          }
+          previous = index;
+          ++corners;
+        }
+      }
+      p = lineEnd + 1;
+    }
+    if (bad)
+      malformed.store(true, std::memory_order_relaxed);
+  });
+
+  bounds_ = mergeBounds(bounds);
+  if (malformed)
+    return fail("malformed vertex or face line");
+  return true;
+}
+
+namespace {
+
+std::size_t plySize(std::uint8_t type) {
+  static constexpr std::size_t kSizes[] = {1, 1, 2, 2, 4, 4, 4, 8};
+  return kSizes[type];
+}
+
+// Reads one PLY scalar of type `type`, swapping bytes if the file's byte
+// order differs from the host's
+double readPly(const unsigned char *p, std::uint8_t type, bool swap) {
+  const auto load = [&](auto raw) {
+    std::memcpy(&raw, p, sizeof(raw));
+    if (swap) {
+      unsigned char bytes[sizeof(raw)];
+      std::memcpy(bytes, &raw, sizeof(raw));
+      std::reverse(bytes, bytes + sizeof(raw));
+      std::memcpy(&raw, bytes, sizeof(raw));
+    }
+    return raw;
+  };
+  switch (type) {
+  case 0:
+    return load(std::int8_t());
+  case 1:
+    return load(std::uint8_t());
+  case 2:
+    return load(std::int16_t());
+  case 3:
+    return load(std::uint16_t());
+  case 4:
+    return load(std::int32_t());
+  case 5:
+    return load(std::uint32_t());
+  case 6:
+    return load(float());
+  default:
+    return load(double());
+  }
+}
+
+bool plyType(std::string_view name, std::uint8_t &type) {
+  static constexpr std::string_view kNames[][2] = {
+      {"char", "int8"},   {"uchar", "uint8"},   {"short", "int16"},
+      {"ushort", "uint16"}, {"int", "int32"},   {"uint", "uint32"},
+      {"float", "float32"}, {"double", "float64"}};
+  for (std::uint8_t i = 0; i < 8; ++i) {
+    if (name == kNames[i][0] || name == kNames[i][1]) {
+      type = i;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<std::string_view> splitWords(std::string_view line) {
+  std::vector<std::string_view> words;
+  const char *p = line.data();
+  const char *end = p + line.size();
+  for (p = skipBlanks(p, end); p < end; p = skipBlanks(p, end)) {
+    const char *wordEnd = skipToken(p, end);
+    words.emplace_back(p, wordEnd - p);
+    p = wordEnd;
+  }
+  return words;
+}
+
+} // namespace
+
+// Finds where the vertex positions and face lists live. Elements before the
+// faces must have fixed-size properties so their size is known up front.
+bool MeshLoader::parsePlyHeader() {
+  const std::string_view text = file_.contents();
+  if (!text.starts_with("ply\n") && !text.starts_with("ply\r\n"))
+    return fail("not a PLY file");
+
+  struct Element {
+    std::string_view name;
+    std::size_t count = 0;
+    std::size_t size = 0;
+    bool hasList = false;
+  };
+  std::vector<Element> elements;
+  bool sawVertex = false;
+  bool sawFace = false;
+  bool binary = false;
+  int positionsFound = 0;
+  std::size_t position = 0;
+  while (true) {
+    const std::size_t newline = text.find('\n', position);
+    if (newline == std::string_view::npos)
+      return fail("PLY header has no end_header");
+    const auto words = splitWords(text.substr(position, newline - position));
+    position = newline + 1;
+    if (words.empty())
+      continue;
+    if (words[0] == "end_header")
+      break;
+    if (words[0] == "format" && words.size() >= 2) {
+      binary = words[1] != "ascii";
+      ply_.bigEndian = words[1] == "binary_big_endian";
+    } else if (words[0] == "element" && words.size() >= 3) {
+      Element element;
+      element.name = words[1];
+      element.count = std::strtoull(std::string(words[2]).c_str(), nullptr, 10);
+      elements.push_back(element);
+    } else if (words[0] == "property" && !elements.empty()) {
+      Element &element = elements.back();
+      std::uint8_t type;
+      if (words.size() >= 5 && words[1] == "list") {
+        std::uint8_t countType;
+        if (!plyType(words[2], countType) || !plyType(words[3], type) ||
+            countType >= 6 || type >= 6)
+          return fail("unsupported PLY list property");
+        if (element.name != "face" || element.hasList)
+          return fail("unsupported PLY list in element " +
+                      std::string(element.name));
+        ply_.countType = static_cast<PlyType>(countType);
+        ply_.indexType = static_cast<PlyType>(type);
+        ply_.faceLeading = element.size;
+        element.hasList = true;
+        element.size = 0;
+      } else if (words.size() >= 3 && plyType(words[1], type)) {
+        if (element.name == "vertex") {
+          for (int axis = 0; axis < 3; ++axis) {
+            if (words[2] == std::string_view("xyz" + axis, 1)) {
+              ply_.positionOffset[axis] = element.size;
+              ply_.positionType[axis] = static_cast<PlyType>(type);
+              ++positionsFound;
+            }
+          }
+        }
+        element.size += plySize(type);
+      } else {
+        return fail("unsupported PLY property");
+      }
+    }
+  }
+  if (!binary)
+    return fail("ASCII PLY is not supported");
+
+  std::size_t offset = position;
+  for (const Element &element : elements) {
+    if (element.name == "vertex") {
+      if (sawFace)
+        return fail("PLY vertices must come before faces");
+      sawVertex = true;
+      ply_.vertexStart = offset;
+      ply_.vertexStride = element.size;
+      layout_.vertexCount = element.count;
+    } else if (element.name == "face") {
+      sawFace = true;
+      ply_.faceStart = offset;
+      ply_.faceCount = element.count;
+      ply_.faceTrailing = element.size;
+      // Later elements are never read
+      break;
+    } else if (element.hasList) {
+      return fail("unsupported PLY element " + std::string(element.name));
+    }
+    offset += element.count * element.size;
+  }
+  if (!sawVertex || !sawFace || positionsFound != 3)
+    return fail("PLY file needs vertex x, y, z and face vertex indices");
+  if (ply_.vertexStart + layout_.vertexCount * ply_.vertexStride > text.size())
+    return fail("PLY vertex data is truncated");
+  return true;
+}
+
+// Meshes of triangles only have fixed-size faces and are split by face
+// number; anything else is walked once to find where each chunk starts.
+bool MeshLoader::scanPly() {
+  if (!parsePlyHeader())
+    return false;
+  const std::string_view text = file_.contents();
+  const auto *data = reinterpret_cast<const unsigned char *>(text.data());
+  const bool swap = ply_.bigEndian != (std::endian::native == std::endian::big);
+  const auto countType = static_cast<std::uint8_t>(ply_.countType);
+  const std::size_t countSize = plySize(countType);
+  const std::size_t indexSize =
+      plySize(static_cast<std::uint8_t>(ply_.indexType));
+  const std::size_t triangleSize =
+      ply_.faceLeading + countSize + 3 * indexSize + ply_.faceTrailing;
+  const std::size_t faces = ply_.faceCount;
+  const std::size_t count = chunkCount(threads_, faces, 1 << 16);
+
+  std::atomic<bool> allTriangles{ply_.faceStart + faces * triangleSize <=
+                                 text.size()};
+  if (allTriangles) {
+    chunks_.resize(count);
+    parallelFor(threads_, count, [&](std::size_t i) {
+      Chunk &chunk = chunks_[i];
+      const std::size_t first = faces * i / count;
+      chunk.faces = faces * (i + 1) / count - first;
+      chunk.begin = ply_.faceStart + first * triangleSize;
+      chunk.firstIndex = 3 * first;
+      for (std::size_t face = 0; face < chunk.faces; ++face) {
+        const unsigned char *p =
+            data + chunk.begin + face * triangleSize + ply_.faceLeading;
+        if (readPly(p, countType, swap) != 3) {
+          allTriangles.store(false, std::memory_order_relaxed);
+          return;
+        }
+      }
+    });
+  }
+
+  if (allTriangles) {
+    layout_.indexCount = 3 * faces;
+    return true;
+  }
+
+  chunks_.assign(count, Chunk());
+  std::size_t position = ply_.faceStart;
+  std::size_t indices = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    Chunk &chunk = chunks_[i];
+    chunk.begin = position;
+    chunk.firstIndex = indices;
+    chunk.faces = faces * (i + 1) / count - faces * i / count;
+    for (std::size_t face = 0; face < chunk.faces; ++face) {
+      if (position + ply_.faceLeading + countSize > text.size())
+        return fail("PLY face data is truncated");
+      const auto corners = static_cast<std::size_t>(
+          readPly(data + position + ply_.faceLeading, countType, swap));
+      position += ply_.faceLeading + countSize + corners * indexSize +
+                  ply_.faceTrailing;
+      if (corners >= 3)
+        indices += 3 * (corners - 2);
+    }
+    if (position > text.size())
+      return fail("PLY face data is truncated");
+  }
+  layout_.indexCount = indices;
+  return true;
+}
+
+template <typename Index>
+bool MeshLoader::parsePly(float *vertices, Index *indices) {
+  const auto *data =
+      reinterpret_cast<const unsigned char *>(file_.contents().data());
+  const bool swap = ply_.bigEndian != (std::endian::native == std::endian::big);
+  const std::size_t vertexCount = layout_.vertexCount;
+  const std::size_t vertexChunks = chunkCount(threads_, vertexCount, 1 << 16);
+  std::vector<ChunkBounds> bounds(vertexChunks);
+
+  parallelFor(threads_, vertexChunks, [&](std::size_t i) {
+    const std::size_t first = vertexCount * i / vertexChunks;
+    const std::size_t last = vertexCount * (i + 1) / vertexChunks;
+    for (std::size_t vertex = first; vertex < last; ++vertex) {
+      const unsigned char *p =
+          data + ply_.vertexStart + vertex * ply_.vertexStride;
+      float position[3];
+      for (int axis = 0; axis < 3; ++axis)
+        position[axis] = static_cast<float>(readPly(
+            p + ply_.positionOffset[axis],
+            static_cast<std::uint8_t>(ply_.positionType[axis]), swap));
+      std::copy(position, position + 3, vertices + 3 * vertex);
+      bounds[i].add(position);
+    }
+  });
+  bounds_ = mergeBounds(bounds);
+
+  const auto countType = static_cast<std::uint8_t>(ply_.countType);
+  const auto indexType = static_cast<std::uint8_t>(ply_.indexType);
+  const std::size_t countSize = plySize(countType);
+  const std::size_t indexSize = plySize(indexType);
+  std::atomic<bool> malformed{false};
+  parallelFor(threads_, chunks_.size(), [&](std::size_t i) {
+    const Chunk &chunk = chunks_[i];
+    const unsigned char *p = data + chunk.begin;
+    Index *out = indices + chunk.firstIndex;
+    bool bad = false;
+    for (std::size_t face = 0; face < chunk.faces; ++face) {
+      p += ply_.faceLeading;
+      const auto corners =
+          static_cast<std::size_t>(readPly(p, countType, swap));
+      p += countSize;
+      Index first = 0;
+      Index previous = 0;
+      for (std::size_t corner = 0; corner < corners; ++corner, p += indexSize) {
+        const double value = readPly(p, indexType, swap);
+        if (value < 0 || value >= static_cast<double>(vertexCount))
+          bad = true;
+        const auto index = static_cast<Index>(bad ? 0 : value);
+        if (corner == 0) {
+          first = index;
+        } else if (corner >= 2) {
+          out[0] = first;
+          out[1] = previous;
+          out[2] = index;
+          out += 3;
+        }
+        previous = index;
+      }
+      p += ply_.faceTrailing;
+    }
+    if (bad)
+      malformed.store(true, std::memory_order_relaxed);
+  });
+  if (malformed)
+    return fail("PLY face refers to a missing vertex");
+  return true;
+}
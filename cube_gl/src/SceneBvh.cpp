@@ -0,0 +1,492 @@
+#include "SceneBvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Profiler.hpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define SCENE_BVH_X86 1
+#endif
+
+namespace {
+
+constexpr std::uint32_t kNoParent = std::numeric_limits<std::uint32_t>::max();
+
+enum Visibility { Outside, Partial, Inside };
+
+// Grows the bounds lo..hi to include a box
+void unite(float *lo, float *hi, const float *centre, const float *extent) {
+  for (int axis = 0; axis < 3; ++axis) {
+    lo[axis] = std::min(lo[axis], centre[axis] - extent[axis]);
+    hi[axis] = std::max(hi[axis], centre[axis] + extent[axis]);
+  }
+}
+
+// The frustum planes as one stream per coefficient, padded to eight lanes
+// with a plane that every box is inside. The absolute normals give a box's
+// projected radius onto each plane.
+struct PlaneSet {
+  alignas(32) float nx[8];
+  alignas(32) float ny[8];
+  alignas(32) float nz[8];
+  alignas(32) float d[8];
+  alignas(32) float ax[8];
+  alignas(32) float ay[8];
+  alignas(32) float az[8];
+
+  explicit PlaneSet(const Frustum &frustum) {
+    for (int lane = 0; lane < 8; ++lane) {
+      const bool used = lane < 6;
+      const float *plane = frustum.planes[used ? lane : 0];
+      nx[lane] = used ? plane[0] : 0.0f;
+      ny[lane] = used ? plane[1] : 0.0f;
+      nz[lane] = used ? plane[2] : 0.0f;
+      d[lane] = used ? plane[3] : 1.0f;
+      ax[lane] = std::fabs(nx[lane]);
+      ay[lane] = std::fabs(ny[lane]);
+      az[lane] = std::fabs(nz[lane]);
+    }
+  }
+};
+
+// Bounds of `count` values, written to lo and hi. The SIMD versions only
+// handle whole leaves of SceneBvh::kLeafObjects values.
+using RangeFunction = void (*)(const float *values, std::size_t count,
+                               float &lo, float &hi);
+
+void rangeScalar(const float *values, std::size_t count, float &lo,
+                 float &hi) {
+  lo = values[0];
+  hi = values[0];
+  for (std::size_t i = 1; i < count; ++i) {
+    lo = std::min(lo, values[i]);
+    hi = std::max(hi, values[i]);
+  }
+}
+
+// A box is outside if it lies entirely behind any plane, and inside if it
+// lies entirely in front of all of them. Every kernel tests the same way, one
+// box against all planes at once.
+
+struct ScalarTest {
+  const PlaneSet &planes;
+
+  Visibility operator()(const float *centre, const float *extent) const {
+    bool inside = true;
+    for (int p = 0; p < 6; ++p) {
+      const float distance = planes.nx[p] * centre[0] +
+                             planes.ny[p] * centre[1] +
+                             planes.nz[p] * centre[2] + planes.d[p];
+      const float radius = planes.ax[p] * extent[0] +
+                           planes.ay[p] * extent[1] + planes.az[p] * extent[2];
+      if (distance + radius < 0.0f)
+        return Outside;
+      inside = inside && distance - radius >= 0.0f;
+    }
+    return inside ? Inside : Partial;
+  }
+};
+
+#ifdef SCENE_BVH_X86
+
+struct Sse2Test {
+  const PlaneSet &planes;
+
+  Visibility operator()(const float *centre, const float *extent) const {
+    const __m128 cx = _mm_set1_ps(centre[0]);
+    const __m128 cy = _mm_set1_ps(centre[1]);
+    const __m128 cz = _mm_set1_ps(centre[2]);
+    const __m128 ex = _mm_set1_ps(extent[0]);
+    const __m128 ey = _mm_set1_ps(extent[1]);
+    const __m128 ez = _mm_set1_ps(extent[2]);
+    const __m128 zero = _mm_setzero_ps();
+    int outside = 0;
+    int partial = 0;
+    for (int lane = 0; lane < 8; lane += 4) {
+      const __m128 distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(_mm_load_ps(planes.nx + lane), cx),
+                     _mm_mul_ps(_mm_load_ps(planes.ny + lane), cy)),
+          _mm_add_ps(_mm_mul_ps(_mm_load_ps(planes.nz + lane), cz),
+                     _mm_load_ps(planes.d + lane)));
+      const __m128 radius =
+          _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(planes.ax + lane), ex),
+                                _mm_mul_ps(_mm_load_ps(planes.ay + lane), ey)),
+                     _mm_mul_ps(_mm_load_ps(planes.az + lane), ez));
+      outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(distance, radius),
+                                              zero));
+      partial |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(distance, radius),
+                                              zero));
+    }
+    return outside ? Outside : partial ? Partial : Inside;
+  }
+};
+
+void rangeSse2(const float *values, std::size_t, float &lo, float &hi) {
+  __m128 low = _mm_loadu_ps(values);
+  __m128 high = low;
+  for (std::size_t i = 4; i < SceneBvh::kLeafObjects; i += 4) {
+    const __m128 v = _mm_loadu_ps(values + i);
+    low = _mm_min_ps(low, v);
+    high = _mm_max_ps(high, v);
+  }
+  low = _mm_min_ps(low, _mm_movehl_ps(low, low));
+  low = _mm_min_ss(low, _mm_shuffle_ps(low, low, 1));
+  high = _mm_max_ps(high, _mm_movehl_ps(high, high));
+  high = _mm_max_ss(high, _mm_shuffle_ps(high, high, 1));
+  lo = _mm_cvtss_f32(low);
+  hi = _mm_cvtss_f32(high);
+}
+
+__attribute__((target("avx2"))) void rangeAvx2(const float *values,
+                                               std::size_t, float &lo,
+                                               float &hi) {
+  __m256 low = _mm256_loadu_ps(values);
+  __m256 high = low;
+  for (std::size_t i = 8; i < SceneBvh::kLeafObjects; i += 8) {
+    const __m256 v = _mm256_loadu_ps(values + i);
+    low = _mm256_min_ps(low, v);
+    high = _mm256_max_ps(high, v);
+  }
+  __m128 low4 = _mm_min_ps(_mm256_castps256_ps128(low),
+                           _mm256_extractf128_ps(low, 1));
+  __m128 high4 = _mm_max_ps(_mm256_castps256_ps128(high),
+                            _mm256_extractf128_ps(high, 1));
+  low4 = _mm_min_ps(low4, _mm_movehl_ps(low4, low4));
+  low4 = _mm_min_ss(low4, _mm_shuffle_ps(low4, low4, 1));
+  high4 = _mm_max_ps(high4, _mm_movehl_ps(high4, high4));
+  high4 = _mm_max_ss(high4, _mm_shuffle_ps(high4, high4, 1));
+  lo = _mm_cvtss_f32(low4);
+  hi = _mm_cvtss_f32(high4);
+}
+
+struct Avx2Test {
+  const PlaneSet &planes;
+
+  __attribute__((target("avx2"))) Visibility
+  operator()(const float *centre, const float *extent) const {
+    const __m256 distance = _mm256_add_ps(
+        _mm256_add_ps(
+            _mm256_mul_ps(_mm256_load_ps(planes.nx),
+                          _mm256_set1_ps(centre[0])),
+            _mm256_mul_ps(_mm256_load_ps(planes.ny),
+                          _mm256_set1_ps(centre[1]))),
+        _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(planes.nz),
+                                    _mm256_set1_ps(centre[2])),
+                      _mm256_load_ps(planes.d)));
+    const __m256 radius = _mm256_add_ps(
+        _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(planes.ax),
+                                    _mm256_set1_ps(extent[0])),
+                      _mm256_mul_ps(_mm256_load_ps(planes.ay),
+                                    _mm256_set1_ps(extent[1]))),
+        _mm256_mul_ps(_mm256_load_ps(planes.az), _mm256_set1_ps(extent[2])));
+    const __m256 zero = _mm256_setzero_ps();
+    if (_mm256_movemask_ps(
+            _mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_LT_OQ)))
+      return Outside;
+    return _mm256_movemask_ps(_mm256_cmp_ps(_mm256_sub_ps(distance, radius),
+                                            zero, _CMP_LT_OQ))
+               ? Partial
+               : Inside;
+  }
+};
+
+#endif
+
+RangeFunction rangeFunction(CullKernel kernel) {
+  switch (kernel) {
+#ifdef SCENE_BVH_X86
+  case CullKernel::Sse2:
+    return rangeSse2;
+  case CullKernel::Avx2:
+    return rangeAvx2;
+#endif
+  default:
+    return rangeScalar;
+  }
+}
+
+} // namespace
+
+CullKernel bestCullKernel() {
+  static const CullKernel best = [] {
+    if (cullKernelSupported(CullKernel::Avx2))
+      return CullKernel::Avx2;
+    if (cullKernelSupported(CullKernel::Sse2))
+      return CullKernel::Sse2;
+    return CullKernel::Scalar;
+  }();
+  return best;
+}
+
+bool cullKernelSupported(CullKernel kernel) {
+  switch (kernel) {
+  case CullKernel::Scalar:
+    return true;
+#ifdef SCENE_BVH_X86
+  case CullKernel::Sse2:
+    return __builtin_cpu_supports("sse2");
+  case CullKernel::Avx2:
+    return __builtin_cpu_supports("avx2");
+#endif
+  default:
+    return false;
+  }
+}
+
+const char *cullKernelName(CullKernel kernel) {
+  switch (kernel) {
+  case CullKernel::Sse2:
+    return "sse2";
+  case CullKernel::Avx2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+Frustum Frustum::fromMatrix(const float *m) {
+  // Row i of the column-major matrix is m[i], m[4 + i], m[8 + i], m[12 + i];
+  // each plane is the last row plus or minus one of the others
+  Frustum frustum;
+  for (int plane = 0; plane < 6; ++plane) {
+    const int row = plane / 2;
+    const float sign = plane % 2 == 0 ? 1.0f : -1.0f;
+    float *out = frustum.planes[plane];
+    for (int column = 0; column < 4; ++column)
+      out[column] = m[4 * column + 3] + sign * m[4 * column + row];
+    const float length =
+        std::sqrt(out[0] * out[0] + out[1] * out[1] + out[2] * out[2]);
+    if (length > 0.0f) {
+      for (int column = 0; column < 4; ++column)
+        out[column] /= length;
+    }
+  }
+  return frustum;
+}
+
+void SceneBvh::build(const float *x, const float *y, const float *z,
+                     std::size_t count, float radius) {
+  PROFILE_SCOPE("SceneBvh::build");
+  count_ = count;
+  radius_ = radius;
+  const std::size_t leafCount = (count + kLeafObjects - 1) / kLeafObjects;
+  leaves_.assign(leafCount, Box{});
+  moved_.assign(leafCount, 0);
+  for (std::size_t leaf = 0; leaf < leafCount; ++leaf)
+    fitLeaf(leaf, x, y, z);
+
+  leafOrder_.resize(leafCount);
+  for (std::size_t leaf = 0; leaf < leafCount; ++leaf)
+    leafOrder_[leaf] = static_cast<std::uint32_t>(leaf);
+  leafNode_.assign(leafCount, 0);
+  nodes_.clear();
+  parent_.clear();
+  nodes_.reserve(2 * leafCount);
+  parent_.reserve(2 * leafCount);
+  if (leafCount > 0)
+    buildNode(0, static_cast<std::uint32_t>(leafCount), kNoParent);
+  nodeMoved_.assign(nodes_.size(), 0);
+}
+
+// Splits the leaves at the median of their centres along the longest axis of
+// those centres
+std::uint32_t SceneBvh::buildNode(std::uint32_t firstLeaf,
+                                  std::uint32_t endLeaf, std::uint32_t parent) {
+  const auto index = static_cast<std::uint32_t>(nodes_.size());
+  nodes_.push_back(Node{});
+  parent_.push_back(parent);
+
+  constexpr float kInfinity = std::numeric_limits<float>::infinity();
+  float lo[3] = {kInfinity, kInfinity, kInfinity};
+  float hi[3] = {-kInfinity, -kInfinity, -kInfinity};
+  float centreLo[3] = {kInfinity, kInfinity, kInfinity};
+  float centreHi[3] = {-kInfinity, -kInfinity, -kInfinity};
+  for (std::uint32_t i = firstLeaf; i < endLeaf; ++i) {
+    const Box &box = leaves_[leafOrder_[i]];
+    unite(lo, hi, box.centre, box.extent);
+    for (int axis = 0; axis < 3; ++axis) {
+      centreLo[axis] = std::min(centreLo[axis], box.centre[axis]);
+      centreHi[axis] = std::max(centreHi[axis], box.centre[axis]);
+    }
+  }
+  Node node;
+  for (int axis = 0; axis < 3; ++axis) {
+    node.box.centre[axis] = 0.5f * (lo[axis] + hi[axis]);
+    node.box.extent[axis] = 0.5f * (hi[axis] - lo[axis]);
+  }
+  node.firstLeaf = firstLeaf;
+  node.endLeaf = endLeaf;
+
+  if (endLeaf - firstLeaf == 1) {
+    leafNode_[leafOrder_[firstLeaf]] = index;
+  } else {
+    int axis = 0;
+    for (int other = 1; other < 3; ++other) {
+      if (centreHi[other] - centreLo[other] > centreHi[axis] - centreLo[axis])
+        axis = other;
+    }
+    const std::uint32_t middle = firstLeaf + (endLeaf - firstLeaf) / 2;
+    std::nth_element(leafOrder_.begin() + firstLeaf,
+                     leafOrder_.begin() + middle, leafOrder_.begin() + endLeaf,
+                     [&](std::uint32_t a, std::uint32_t b) {
+                       return leaves_[a].centre[axis] <
+                              leaves_[b].centre[axis];
+                     });
+    buildNode(firstLeaf, middle, index);
+    buildNode(middle, endLeaf, index);
+  }
+  node.skip = static_cast<std::uint32_t>(nodes_.size());
+  nodes_[index] = node;
+  return index;
+}
+
+void SceneBvh::fitLeaf(std::size_t leaf, const float *x, const float *y,
+                       const float *z) {
+  const std::size_t begin = leaf * kLeafObjects;
+  const std::size_t count = std::min(kLeafObjects, count_ - begin);
+  // Only the last leaf can be partly filled
+  const RangeFunction range =
+      count == kLeafObjects ? rangeFunction(kernel_) : rangeScalar;
+  float lo[3];
+  float hi[3];
+  range(x + begin, count, lo[0], hi[0]);
+  range(y + begin, count, lo[1], hi[1]);
+  range(z + begin, count, lo[2], hi[2]);
+  Box &box = leaves_[leaf];
+  for (int axis = 0; axis < 3; ++axis) {
+    box.centre[axis] = 0.5f * (lo[axis] + hi[axis]);
+    box.extent[axis] = 0.5f * (hi[axis] - lo[axis]) + radius_;
+  }
+}
+
+void SceneBvh::markMoved(std::size_t begin, std::size_t end) {
+  end = std::min(end, count_);
+  if (begin >= end)
+    return;
+  std::fill(moved_.begin() + begin / kLeafObjects,
+            moved_.begin() + (end - 1) / kLeafObjects + 1, 1);
+}
+
+void SceneBvh::refit(const float *x, const float *y, const float *z) {
+  PROFILE_SCOPE("SceneBvh::refit");
+  for (std::size_t leaf = 0; leaf < leaves_.size(); ++leaf) {
+    if (!moved_[leaf])
+      continue;
+    moved_[leaf] = 0;
+    fitLeaf(leaf, x, y, z);
+    const std::uint32_t node = leafNode_[leaf];
+    nodes_[node].box = leaves_[leaf];
+    for (std::uint32_t p = parent_[node]; p != kNoParent && !nodeMoved_[p];
+         p = parent_[p])
+      nodeMoved_[p] = 1;
+  }
+  // Children always follow their parent, so a backwards sweep refits them
+  // first
+  for (std::size_t i = nodes_.size(); i-- > 0;) {
+    if (!nodeMoved_[i])
+      continue;
+    nodeMoved_[i] = 0;
+    const Node &left = nodes_[i + 1];
+    const Node &right = nodes_[left.skip];
+    float lo[3];
+    float hi[3];
+    for (int axis = 0; axis < 3; ++axis) {
+      lo[axis] = left.box.centre[axis] - left.box.extent[axis];
+      hi[axis] = left.box.centre[axis] + left.box.extent[axis];
+    }
+    unite(lo, hi, right.box.centre, right.box.extent);
+    Box &box = nodes_[i].box;
+    for (int axis = 0; axis < 3; ++axis) {
+      box.centre[axis] = 0.5f * (lo[axis] + hi[axis]);
+      box.extent[axis] = 0.5f * (hi[axis] - lo[axis]);
+    }
+  }
+}
+
+void SceneBvh::setKernel(CullKernel kernel) {
+  if (cullKernelSupported(kernel))
+    kernel_ = kernel;
+}
+
+void SceneBvh::emitLeaf(std::size_t leaf, std::vector<ObjectRange> &visible,
+                        CullStats &stats) const {
+  const auto begin = static_cast<std::uint32_t>(leaf * kLeafObjects);
+  const auto end = static_cast<std::uint32_t>(
+      std::min<std::size_t>(begin + kLeafObjects, count_));
+  if (!visible.empty() && visible.back().end == begin)
+    visible.back().end = end;
+  else
+    visible.push_back({begin, end});
+  stats.visibleObjects += end - begin;
+}
+
+template <typename Test>
+CullStats SceneBvh::traverse(const Test &test,
+                             std::vector<ObjectRange> &visible) const {
+  CullStats stats;
+  const auto nodeCount = static_cast<std::uint32_t>(nodes_.size());
+  for (std::uint32_t i = 0; i < nodeCount;) {
+    const Node &node = nodes_[i];
+    ++stats.nodesTested;
+    const Visibility visibility = test(node.box.centre, node.box.extent);
+    if (visibility == Outside) {
+      i = node.skip;
+    } else if (visibility == Inside || node.skip == i + 1) {
+      for (std::uint32_t leaf = node.firstLeaf; leaf < node.endLeaf; ++leaf)
+        emitLeaf(leafOrder_[leaf], visible, stats);
+      i = node.skip;
+    } else {
+      ++i;
+    }
+  }
+  return stats;
+}
+
+template <typename Test>
+CullStats SceneBvh::testLeaves(const Test &test,
+                               std::vector<ObjectRange> &visible) const {
+  CullStats stats;
+  for (std::size_t leaf = 0; leaf < leaves_.size(); ++leaf) {
+    ++stats.nodesTested;
+    const Box &box = leaves_[leaf];
+    if (test(box.centre, box.extent) != Outside)
+      emitLeaf(leaf, visible, stats);
+  }
+  return stats;
+}
+
+CullStats SceneBvh::cull(const Frustum &frustum,
+                         std::vector<ObjectRange> &visible) const {
+  PROFILE_SCOPE("SceneBvh::cull");
+  visible.clear();
+  const PlaneSet planes(frustum);
+  switch (kernel_) {
+#ifdef SCENE_BVH_X86
+  case CullKernel::Sse2:
+    return traverse(Sse2Test{planes}, visible);
+  case CullKernel::Avx2:
+    return traverse(Avx2Test{planes}, visible);
+#endif
+  default:
+    return traverse(ScalarTest{planes}, visible);
+  }
+}
+
+CullStats SceneBvh::cullLeaves(const Frustum &frustum,
+                               std::vector<ObjectRange> &visible) const {
+  visible.clear();
+  const PlaneSet planes(frustum);
+  switch (kernel_) {
+#ifdef SCENE_BVH_X86
+  case CullKernel::Sse2:
+    return testLeaves(Sse2Test{planes}, visible);
+  case CullKernel::Avx2:
+    return testLeaves(Avx2Test{planes}, visible);
+#endif
+  default:
+    return testLeaves(ScalarTest{planes}, visible);
+  }
+}
@@ -1,5 +1,6 @@
 #include <QApplication>
 #include <QDebug>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QImage>
 #include <QLabel>
@@ -7,17 +8,36 @@
 #include <QOpenGLShaderProgram>
 #include <QOpenGLWidget>
 #include <QPainter>
+#include <QShowEvent>
 #include <QSizePolicy>
 #include <QTabWidget>
 #include <QTimer>
 #include <memory>
 
-class MyGLWidget : public QOpenGLWidget, protected QOpenGLFunctions {
+#include "GpuFrameTimer.hpp"
+#include "OffscreenBench.hpp"
+#include "Profiler.hpp"
+#include "ProfilerOverlay.hpp"
+#include "RenderState.hpp"
+#include "ShaderCache.hpp"
+
+class MyGLWidget : public QOpenGLWidget,
+                   public render::BenchScene,
+                   protected QOpenGLFunctions {
+  render::ShaderCache shaderCache;
   std::unique_ptr<QOpenGLShaderProgram> program;
   GLuint vbo, ebo;
   GLuint textures[2];
+  render::VertexInput vertexInput;
+  GLint fadeFactorLocation = -1;
   float fadeFactor;
+  float fadeTime = 0.0f;
   QTimer timer;
+  profiler::FrameStats frameStats;
+  bool logPaintTimes = false;
+  profiler::DurationStats paintTimes;
+  profiler::GpuFrameTimer gpuTimer;
+  profiler::StartupTimings *startup = nullptr;
 
 public:
   MyGLWidget() : fadeFactor(0.0f) {
@@ -25,9 +45,36 @@ public:
     timer.start(8);
   }
 
+  ~MyGLWidget() override {
+    makeCurrent();
+    gpuTimer.destroy();
+    vertexInput.destroy();
+    doneCurrent();
+  }
+
+  // Logs paintGL CPU time every 300 frames
+  void setFrameStatsEnabled(bool enabled) { logPaintTimes = enabled; }
+  // Marks the startup phases in initializeGL and reports them after the
+  // first frame
+  void setStartupTimings(profiler::StartupTimings *timings) {
+    startup = timings;
+  }
+
+  void benchInitialize(const QSize &size) override {
+    initializeGL();
+    resizeGL(size.width(), size.height());
+  }
+
+  void benchFrame(QPaintDevice &device) override {
+    stepFadeFactor();
+    paintFrame(device);
+  }
+
 protected:
   void initializeGL() override {
+    markStartup("context");
     initializeOpenGLFunctions();
+    gpuTimer.initialize();
     glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
     // Vertex shader
@@ -56,18 +103,23 @@ protected:
             }
         )";
 
-    program = std::make_unique<QOpenGLShaderProgram>();
-    if (!program->addShaderFromSourceCode(QOpenGLShader::Vertex,
-                                          vertexShaderSource)) {
-      qWarning() << "Vertex shader compilation failed:" << program->log();
-    }
-    if (!program->addShaderFromSourceCode(QOpenGLShader::Fragment,
-                                          fragmentShaderSource)) {
-      qWarning() << "Fragment shader compilation failed:" << program->log();
-    }
-    if (!program->link()) {
-      qWarning() << "Shader program linking failed:" << program->log();
+    // A fixed location lets the vertex array be recorded before drawing
+    program = shaderCache.link(
+        {{QOpenGLShader::Vertex, vertexShaderSource},
+         {QOpenGLShader::Fragment, fragmentShaderSource}},
+        {{"position", 0}});
+    if (!program) {
+      qWarning() << "Shader program compilation failed:" << shaderCache.log();
+      // Leaves an unlinked program so that paintGL still clears the window
+      program = std::make_unique<QOpenGLShaderProgram>();
     }
+    fadeFactorLocation = program->uniformLocation("fade_factor");
+    // The samplers always read units 0 and 1, so they are set only once
+    program->bind();
+    program->setUniformValue(program->uniformLocation("textures[0]"), 0);
+    program->setUniformValue(program->uniformLocation("textures[1]"), 1);
+    program->release();
+    markStartup("shaders");
 
     // Vertex data for the four corners of the screen
     static const GLfloat g_vertex_buffer_data[] = {-1.0f, -1.0f, 1.0f, -1.0f,
@@ -83,42 +135,85 @@ protected:
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
     glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(g_element_buffer_data),
                  g_element_buffer_data, GL_STATIC_DRAW);
+    vertexInput.create(vbo, ebo, {{0, 2, 2 * sizeof(GLfloat), 0}});
 
     // Create and load textures
     glGenTextures(2, textures);
     createAndLoadTexture(textures[0], ":/hello1.tga");
     createAndLoadTexture(textures[1], ":/hello2.tga");
+    markStartup("upload");
+  }
+
+  void showEvent(QShowEvent *event) override {
+    // The widget sits in the last tab, so it may be opened long after
+    // startup; the time until then belongs to the user
+    if (startup && !isValid())
+      startup->skip();
+    QOpenGLWidget::showEvent(event);
   }
 
   void resizeGL(int w, int h) override { glViewport(0, 0, w, h); }
 
-  void paintGL() override {
+  void paintGL() override { paintFrame(*this); }
+
+private:
+  // The profiler overlay is painted on `overlayDevice`, the widget itself
+  // unless benchmarking
+  void paintFrame(QPaintDevice &overlayDevice) {
+    PROFILE_SCOPE("paintGL");
+    frameStats.markFrame();
+    QElapsedTimer paintTimer;
+    paintTimer.start();
+    gpuTimer.beginFrame();
     glClear(GL_COLOR_BUFFER_BIT);
+    gpuTimer.mark("clear");
 
     program->bind();
-
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-    int posLocation = program->attributeLocation("position");
-    program->enableAttributeArray(posLocation);
-    glVertexAttribPointer(posLocation, 2, GL_FLOAT, GL_FALSE,
-                          2 * sizeof(GLfloat), nullptr);
-
-    program->setUniformValue("fade_factor", fadeFactor);
+    program->setUniformValue(fadeFactorLocation, fadeFactor);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, textures[0]);
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, textures[1]);
-    program->setUniformValue("textures[0]", 0);
-    program->setUniformValue("textures[1]", 1);
 
+    vertexInput.bind();
     glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_SHORT, nullptr);
-
-    program->disableAttributeArray(posLocation);
+    vertexInput.release();
     program->release();
+    gpuTimer.mark("quad");
+
+    if (profiler::overlayEnabled()) {
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+      glActiveTexture(GL_TEXTURE0);
+      QPainter painter(&overlayDevice);
+      profiler::drawOverlay(painter, frameStats);
+      painter.end();
+      gpuTimer.mark("overlay");
+    }
+    gpuTimer.endFrame();
+
+    if (startup && !startup->reported()) {
+      // The first frame only counts once the GL has finished drawing it
+      glFinish();
+      startup->mark("first paintGL");
+      startup->report(shaderCache.summary());
+    }
+
+    if (logPaintTimes) {
+      paintTimes.record(paintTimer.nsecsElapsed());
+      if (paintTimes.count() == 300) {
+        qInfo("paintGL CPU time over 300 frames: mean %.1f us, p99 %.1f us",
+              paintTimes.meanMs() * 1e3, paintTimes.percentileMs(0.99) * 1e3);
+        paintTimes.reset();
+      }
+    }
+  }
+
+  void markStartup(const char *phase) {
+    if (startup)
+      startup->mark(phase);
   }
 
-private:
   void createAndLoadTexture(GLuint texture, const QString &resourcePath) {
     QImage image;
     if (!image.load(resourcePath)) {
@@ -137,16 +232,29 @@ private:
   }
 
   void updateFadeFactor() {
-    static float time = 0.0f;
-    fadeFactor = 0.5f * (1.0f + sin(time));
-    time += 0.01f;
+    PROFILE_SCOPE("updateFadeFactor");
+    stepFadeFactor();
     update();
   }
+
+  void stepFadeFactor() {
+    fadeFactor = 0.5f * (1.0f + sin(fadeTime));
+    fadeTime += 0.01f;
+  }
 };
 
 int main(int argc, char *argv[]) {
+  profiler::initFromEnvironment();
+  profiler::StartupTimings startup;
   QApplication app(argc, argv);
 
+  // --bench N renders N frames offscreen as fast as possible
+  if (const int frames = render::benchFrames(argc, argv)) {
+    render::OffscreenBench bench(QSize(800, 600));
+    MyGLWidget scene;
+    return bench.run(scene, frames);
+  }
+
   QTabWidget tabWidget;
   tabWidget.setWindowTitle("Image and GLWidget Viewer");
 
@@ -168,8 +276,11 @@ int main(int argc, char *argv[]) {
   tabWidget.addTab(&imageLabel2, "Image 2");
 
   MyGLWidget glWidget;
+  glWidget.setFrameStatsEnabled(app.arguments().contains("--frame-stats"));
   glWidget.setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
   tabWidget.addTab(&glWidget, "GLWidget");
+  startup.mark("application");
+  glWidget.setStartupTimings(&startup);
   tabWidget.show();
 
   return app.exec();
@@ -0,0 +1,91 @@
+#ifndef GPUFRAMETIMER_HPP
+#define GPUFRAMETIMER_HPP
+
+#include <QOpenGLExtraFunctions>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+
+#include "Profiler.hpp"
+
+namespace profiler {
+
+// Times the passes of each paintGL on the GPU with GL_TIMESTAMP queries
+// (OpenGL 3.3 or ARB_timer_query, which Mesa's llvmpipe also provides) next
+// to the CPU time of the same frame.
+//
+// Every frame writes its timestamps into the next slot of a small ring and
+// results are only read once the driver reports them available, a few frames
+// later, so timing never waits for the GPU. If the GPU falls so far behind
+// that the next slot is still pending, that frame goes untimed instead.
+class GpuFrameTimer : protected QOpenGLExtraFunctions {
+public:
+  static constexpr int kMaxPasses = 8;
+
+  GpuFrameTimer() = default;
+  ~GpuFrameTimer();
+
+  GpuFrameTimer(const GpuFrameTimer &) = delete;
+  GpuFrameTimer &operator=(const GpuFrameTimer &) = delete;
+
+  // Needs a current context. Returns false, leaving every call below a no-op,
+  // unless gpuTimingEnabled() and the context has timer queries. Opens
+  // gpuCsvPath() when one is set.
+  bool initialize();
+  // Needs the context current again; the destructor only closes the CSV.
+  void destroy();
+
+  // Bracket paintGL with beginFrame and endFrame, and call mark after each
+  // pass with a string literal naming it.
+  void beginFrame();
+  void mark(const char *pass);
+  void endFrame();
+
+  // Logs CPU and GPU frame time percentiles and the mean time of each pass
+  // every `frames` timed frames; 0 turns the log off. The default is 300.
+  void setReportInterval(int frames) { reportInterval_ = frames; }
+  // Appends a row per timed frame: frame, cpu_ms, gpu_ms, then each pass.
+  bool openCsv(const std::string &path);
+
+private:
+  struct Slot {
+    std::array<GLuint, kMaxPasses + 1> queries{};
+    std::array<const char *, kMaxPasses> passes{};
+    int marks = 0;
+    std::int64_t cpuNs = 0;
+    std::uint64_t frame = 0;
+    bool pending = false;
+  };
+  static constexpr int kSlots = 6;
+
+  using QueryCounterFunction = void(QOPENGLF_APIENTRYP)(GLuint, GLenum);
+  using GetQueryObjectui64vFunction = void(QOPENGLF_APIENTRYP)(GLuint, GLenum,
+                                                               GLuint64 *);
+
+  void collect();
+  void resolve(Slot &slot);
+  void report();
+
+  QueryCounterFunction queryCounter_ = nullptr;
+  GetQueryObjectui64vFunction getQueryObjectui64v_ = nullptr;
+  std::array<Slot, kSlots> slots_{};
+  int next_ = 0;
+  Slot *active_ = nullptr;
+  std::int64_t cpuStartNs_ = 0;
+  std::uint64_t frames_ = 0;
+  std::uint64_t skipped_ = 0;
+
+  int reportInterval_ = 300;
+  int sinceReport_ = 0;
+  DurationStats cpuTimes_;
+  DurationStats gpuTimes_;
+  std::array<const char *, kMaxPasses> passNames_{};
+  std::array<DurationStats, kMaxPasses> passTimes_;
+
+  std::FILE *csv_ = nullptr;
+  bool csvHeaderWritten_ = false;
+};
+
+} // namespace profiler
+
+#endif // GPUFRAMETIMER_HPP
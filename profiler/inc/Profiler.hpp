@@ -0,0 +1,142 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Low-overhead scoped timers shared by the demo executables.
+//
+// Each thread appends finished scopes to its own fixed-size ring buffer, so
+// recording never takes a lock; when a ring is full the oldest events are
+// overwritten. While recording is off a scope costs one relaxed atomic load.
+// Building with PROFILER_DISABLED compiles the macros away entirely.
+//
+// Set PROFILER_TRACE=<file.json> to record and write a Chrome trace
+// (chrome://tracing, Perfetto) at exit, and PROFILER_OVERLAY=1 to draw FPS
+// and frame-time percentiles over each widget. PROFILER_GPU=1 has the GL
+// demos time their passes on the GPU (see GpuFrameTimer.hpp), and
+// PROFILER_GPU_CSV=<file.csv> also writes one row per timed frame.
+namespace profiler {
+
+// Reads the PROFILER_* variables above. Call once at the top of main.
+void initFromEnvironment();
+
+void setEnabled(bool enabled);
+void setOverlayEnabled(bool enabled);
+bool overlayEnabled();
+bool gpuTimingEnabled();
+// Empty unless PROFILER_GPU_CSV is set.
+const std::string &gpuCsvPath();
+
+// Writes every buffered event as Chrome trace JSON. Returns false if the file
+// cannot be written.
+bool writeChromeTrace(const std::string &path);
+
+extern std::atomic<bool> recording;
+
+std::int64_t nowNanoseconds();
+void recordEvent(const char *name, std::int64_t startNs, std::int64_t endNs);
+
+class ScopedTimer {
+public:
+    explicit ScopedTimer(const char *name)
+        : name_(name),
+          startNs_(recording.load(std::memory_order_relaxed) ? nowNanoseconds() : -1) {}
+    ~ScopedTimer() {
+        if (startNs_ >= 0)
+            recordEvent(name_, startNs_, nowNanoseconds());
+    }
+
+    ScopedTimer(const ScopedTimer &) = delete;
+    ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+private:
+    const char *name_;
+    std::int64_t startNs_;
+};
+
+// Rolling window of recent frame intervals for the overlay.
+class FrameStats {
+public:
+    // Call once per frame, at the start of paintGL.
+    void markFrame();
+
+    double fps() const;
+    // Frame interval percentile in milliseconds over the window, 0..1.
+    double percentileMs(double fraction) const;
+
+private:
+    static constexpr std::size_t kWindow = 240;
+
+    std::array<std::int64_t, kWindow> intervals_{};
+    std::size_t count_ = 0;
+    std::size_t next_ = 0;
+    std::int64_t lastFrameNs_ = -1;
+};
+
+// Rolling window of recent durations, such as the CPU time spent in paintGL.
+class DurationStats {
+public:
+    void record(std::int64_t nanoseconds);
+    void reset();
+
+    std::size_t count() const { return count_; }
+    double meanMs() const;
+    // Duration percentile in milliseconds over the window, 0..1.
+    double percentileMs(double fraction) const;
+
+private:
+    static constexpr std::size_t kWindow = 300;
+
+    std::array<std::int64_t, kWindow> durations_{};
+    std::size_t count_ = 0;
+    std::size_t next_ = 0;
+};
+
+// Time to first frame, split into the phases of startup. The clock starts
+// when the object is created, first thing in main; each mark() ends the
+// current phase under `phase`, a string literal, so marking "context" on
+// entering initializeGL times everything since the previous mark. While
+// recording, phases also go into the trace.
+class StartupTimings {
+public:
+    static constexpr std::size_t kMaxPhases = 8;
+
+    StartupTimings();
+
+    void mark(const char *phase);
+    // Leaves the time since the last mark out of every phase and the total,
+    // e.g. while waiting on the user
+    void skip();
+    // Logs each phase and the time to first frame, followed by `note`, such
+    // as whether the shader cache was cold. Only the first call logs.
+    void report(const char *note);
+    bool reported() const { return reported_; }
+
+private:
+    std::array<const char *, kMaxPhases> phases_{};
+    std::array<std::int64_t, kMaxPhases> durations_{};
+    std::size_t count_ = 0;
+    std::int64_t startNs_;
+    std::int64_t lastNs_;
+    bool reported_ = false;
+};
+
+} // namespace profiler
+
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+
+#ifdef PROFILER_DISABLED
+#define PROFILE_SCOPE(name) ((void)0)
+#else
+// Times the rest of the enclosing scope under `name`, a string literal.
+#define PROFILE_SCOPE(name)                                                    \
+    const ::profiler::ScopedTimer PROFILER_CONCAT(profilerScope, __LINE__)(name)
+#endif
+
+#endif // PROFILER_HPP
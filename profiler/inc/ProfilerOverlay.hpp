@@ -0,0 +1,16 @@
+#ifndef PROFILEROVERLAY_HPP
+#define PROFILEROVERLAY_HPP
+
+#include <QPainter>
+
+#include "Profiler.hpp"
+
+namespace profiler {
+
+// Draws FPS and p50/p99 frame time in the top-left corner. Call at the end of
+// paintGL, after any raw GL drawing, when overlayEnabled() is true.
+void drawOverlay(QPainter &painter, const FrameStats &stats);
+
+} // namespace profiler
+
+#endif // PROFILEROVERLAY_HPP
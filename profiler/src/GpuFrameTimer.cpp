@@ -0,0 +1,168 @@
+#include "GpuFrameTimer.hpp"
+
+#include <QOpenGLContext>
+#include <QString>
+#include <QtDebug>
+
+namespace profiler {
+
+GpuFrameTimer::~GpuFrameTimer() {
+  if (csv_)
+    std::fclose(csv_);
+}
+
+bool GpuFrameTimer::initialize() {
+  if (!gpuTimingEnabled())
+    return false;
+  QOpenGLContext *context = QOpenGLContext::currentContext();
+  const bool supported =
+      !context->isOpenGLES() &&
+      (context->format().version() >= qMakePair(3, 3) ||
+       context->hasExtension("GL_ARB_timer_query"));
+  if (!supported) {
+    qWarning("GPU timing unavailable: no timer queries on this context");
+    return false;
+  }
+  initializeOpenGLFunctions();
+  queryCounter_ = reinterpret_cast<QueryCounterFunction>(
+      context->getProcAddress("glQueryCounter"));
+  getQueryObjectui64v_ = reinterpret_cast<GetQueryObjectui64vFunction>(
+      context->getProcAddress("glGetQueryObjectui64v"));
+  if (!queryCounter_ || !getQueryObjectui64v_) {
+    qWarning("GPU timing unavailable: timer query functions not found");
+    queryCounter_ = nullptr;
+    return false;
+  }
+  for (Slot &slot : slots_)
+    glGenQueries(static_cast<GLsizei>(slot.queries.size()),
+                 slot.queries.data());
+  if (!gpuCsvPath().empty() && !openCsv(gpuCsvPath()))
+    qWarning("Could not write GPU timings to %s", gpuCsvPath().c_str());
+  return true;
+}
+
+void GpuFrameTimer::destroy() {
+  if (!queryCounter_)
+    return;
+  for (Slot &slot : slots_) {
+    glDeleteQueries(static_cast<GLsizei>(slot.queries.size()),
+                    slot.queries.data());
+    slot = Slot{};
+  }
+  queryCounter_ = nullptr;
+  active_ = nullptr;
+}
+
+bool GpuFrameTimer::openCsv(const std::string &path) {
+  if (csv_)
+    std::fclose(csv_);
+  csv_ = std::fopen(path.c_str(), "w");
+  csvHeaderWritten_ = false;
+  return csv_ != nullptr;
+}
+
+void GpuFrameTimer::beginFrame() {
+  if (!queryCounter_)
+    return;
+  collect();
+  Slot &slot = slots_[next_];
+  if (slot.pending) {
+    ++skipped_;
+    return;
+  }
+  active_ = &slot;
+  slot.marks = 0;
+  cpuStartNs_ = nowNanoseconds();
+  queryCounter_(slot.queries[0], GL_TIMESTAMP);
+}
+
+void GpuFrameTimer::mark(const char *pass) {
+  if (!active_ || active_->marks == kMaxPasses)
+    return;
+  active_->passes[active_->marks] = pass;
+  ++active_->marks;
+  queryCounter_(active_->queries[active_->marks], GL_TIMESTAMP);
+}
+
+void GpuFrameTimer::endFrame() {
+  if (!active_)
+    return;
+  Slot &slot = *active_;
+  active_ = nullptr;
+  slot.frame = frames_++;
+  if (slot.marks == 0)
+    return;
+  slot.cpuNs = nowNanoseconds() - cpuStartNs_;
+  slot.pending = true;
+  next_ = (next_ + 1) % kSlots;
+}
+
+// Resolves finished frames oldest first. Queries complete in submission
+// order, so the first frame that is not ready ends the scan.
+void GpuFrameTimer::collect() {
+  for (int i = 0; i < kSlots; ++i) {
+    Slot &slot = slots_[(next_ + i) % kSlots];
+    if (!slot.pending)
+      continue;
+    GLuint available = 0;
+    glGetQueryObjectuiv(slot.queries[slot.marks], GL_QUERY_RESULT_AVAILABLE,
+                        &available);
+    if (!available)
+      return;
+    resolve(slot);
+  }
+}
+
+void GpuFrameTimer::resolve(Slot &slot) {
+  slot.pending = false;
+  std::array<GLuint64, kMaxPasses + 1> stamps{};
+  for (int i = 0; i <= slot.marks; ++i)
+    getQueryObjectui64v_(slot.queries[i], GL_QUERY_RESULT, &stamps[i]);
+
+  const auto gpuNs = static_cast<std::int64_t>(stamps[slot.marks] - stamps[0]);
+  cpuTimes_.record(slot.cpuNs);
+  gpuTimes_.record(gpuNs);
+  for (int pass = 0; pass < slot.marks; ++pass) {
+    passNames_[pass] = slot.passes[pass];
+    passTimes_[pass].record(
+        static_cast<std::int64_t>(stamps[pass + 1] - stamps[pass]));
+  }
+
+  if (csv_) {
+    if (!csvHeaderWritten_) {
+      std::fprintf(csv_, "frame,cpu_ms,gpu_ms");
+      for (int pass = 0; pass < slot.marks; ++pass)
+        std::fprintf(csv_, ",%s_ms", slot.passes[pass]);
+      std::fprintf(csv_, "\n");
+      csvHeaderWritten_ = true;
+    }
+    std::fprintf(csv_, "%llu,%.4f,%.4f",
+                 static_cast<unsigned long long>(slot.frame), slot.cpuNs / 1e6,
+                 gpuNs / 1e6);
+    for (int pass = 0; pass < slot.marks; ++pass)
+      std::fprintf(csv_, ",%.4f", (stamps[pass + 1] - stamps[pass]) / 1e6);
+    std::fprintf(csv_, "\n");
+  }
+
+  if (reportInterval_ > 0 && ++sinceReport_ >= reportInterval_)
+    report();
+}
+
+void GpuFrameTimer::report() {
+  QString passes;
+  for (int pass = 0; pass < kMaxPasses && passNames_[pass]; ++pass)
+    passes += QString("%1%2 %3")
+                  .arg(passes.isEmpty() ? "" : ", ")
+                  .arg(passNames_[pass])
+                  .arg(passTimes_[pass].meanMs(), 0, 'f', 3);
+  qInfo("frame time over %d frames: cpu p50 %.3f ms, p99 %.3f ms | gpu p50 "
+        "%.3f ms, p99 %.3f ms | gpu mean ms: %s | %llu untimed",
+        sinceReport_, cpuTimes_.percentileMs(0.5),
+        cpuTimes_.percentileMs(0.99), gpuTimes_.percentileMs(0.5),
+        gpuTimes_.percentileMs(0.99), qPrintable(passes),
+        static_cast<unsigned long long>(skipped_));
+  sinceReport_ = 0;
+  skipped_ = 0;
+}
+
+} // namespace profiler
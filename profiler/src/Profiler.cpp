@@ -0,0 +1,246 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace profiler {
+
+std::atomic<bool> recording{false};
+
+namespace {
+
+struct Event {
+  const char *name;
+  std::int64_t startNs;
+  std::int64_t durationNs;
+};
+
+// Written only by its owning thread; read by the exporter at exit
+struct EventRing {
+  static constexpr std::size_t kCapacity = 1 << 16;
+
+  std::vector<Event> events = std::vector<Event>(kCapacity);
+  std::atomic<std::uint64_t> written{0};
+  int threadIndex = 0;
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<EventRing>> rings;
+  std::string tracePath;
+  std::string gpuCsvPath;
+};
+
+Registry &registry() {
+  static Registry instance;
+  return instance;
+}
+
+std::atomic<bool> overlay{false};
+std::atomic<bool> gpuTiming{false};
+
+const std::chrono::steady_clock::time_point epoch =
+    std::chrono::steady_clock::now();
+
+EventRing &threadRing() {
+  // The registry owns the rings so events outlive the threads that wrote them
+  thread_local EventRing *ring = nullptr;
+  if (!ring) {
+    Registry &reg = registry();
+    const std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.rings.push_back(std::make_unique<EventRing>());
+    ring = reg.rings.back().get();
+    ring->threadIndex = static_cast<int>(reg.rings.size());
+  }
+  return *ring;
+}
+
+void writeTraceAtExit() {
+  const std::string &path = registry().tracePath;
+  if (!path.empty() && writeChromeTrace(path))
+    std::fprintf(stderr, "Profiler trace written to %s\n", path.c_str());
+}
+
+bool flagSet(const char *value) {
+  return value && value[0] != '\0' && value[0] != '0';
+}
+
+} // namespace
+
+void initFromEnvironment() {
+  if (const char *overlayVar = std::getenv("PROFILER_OVERLAY"))
+    setOverlayEnabled(flagSet(overlayVar));
+  // A CSV path turns GPU timing on by itself
+  const char *gpuCsv = std::getenv("PROFILER_GPU_CSV");
+  if (gpuCsv && gpuCsv[0] != '\0')
+    registry().gpuCsvPath = gpuCsv;
+  gpuTiming.store(flagSet(std::getenv("PROFILER_GPU")) ||
+                      !registry().gpuCsvPath.empty(),
+                  std::memory_order_relaxed);
+  const char *trace = std::getenv("PROFILER_TRACE");
+  if (!trace || trace[0] == '\0')
+    return;
+  registry().tracePath = trace;
+  setEnabled(true);
+  std::atexit(writeTraceAtExit);
+}
+
+void setEnabled(bool enabled) {
+  recording.store(enabled, std::memory_order_relaxed);
+}
+
+void setOverlayEnabled(bool enabled) {
+  overlay.store(enabled, std::memory_order_relaxed);
+}
+
+bool overlayEnabled() { return overlay.load(std::memory_order_relaxed); }
+
+bool gpuTimingEnabled() { return gpuTiming.load(std::memory_order_relaxed); }
+
+const std::string &gpuCsvPath() { return registry().gpuCsvPath; }
+
+std::int64_t nowNanoseconds() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - epoch)
+      .count();
+}
+
+void recordEvent(const char *name, std::int64_t startNs, std::int64_t endNs) {
+  EventRing &ring = threadRing();
+  const std::uint64_t index = ring.written.load(std::memory_order_relaxed);
+  ring.events[index % EventRing::kCapacity] = {name, startNs, endNs - startNs};
+  ring.written.store(index + 1, std::memory_order_release);
+}
+
+bool writeChromeTrace(const std::string &path) {
+  std::FILE *file = std::fopen(path.c_str(), "w");
+  if (!file)
+    return false;
+
+  Registry &reg = registry();
+  const std::lock_guard<std::mutex> lock(reg.mutex);
+  std::fprintf(file, "{\"traceEvents\":[");
+  bool first = true;
+  for (const auto &ring : reg.rings) {
+    const std::uint64_t written = ring->written.load(std::memory_order_acquire);
+    const std::uint64_t begin =
+        written > EventRing::kCapacity ? written - EventRing::kCapacity : 0;
+    for (std::uint64_t i = begin; i < written; ++i) {
+      const Event &event = ring->events[i % EventRing::kCapacity];
+      // Chrome trace timestamps are in microseconds
+      std::fprintf(file,
+                   "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                   "\"ts\":%.3f,\"dur\":%.3f}",
+                   first ? "" : ",", event.name, ring->threadIndex,
+                   event.startNs / 1000.0, event.durationNs / 1000.0);
+      first = false;
+    }
+  }
+  std::fprintf(file, "\n]}\n");
+  return std::fclose(file) == 0;
+}
+
+namespace {
+
+// Percentile of the first `count` entries of a rolling window, in ms
+template <std::size_t N>
+double windowPercentileMs(const std::array<std::int64_t, N> &window,
+                          std::size_t count, double fraction) {
+  if (count == 0)
+    return 0.0;
+  std::array<std::int64_t, N> sorted;
+  std::copy_n(window.begin(), count, sorted.begin());
+  const auto rank = static_cast<std::size_t>(
+      std::clamp(fraction, 0.0, 1.0) * static_cast<double>(count - 1));
+  std::nth_element(sorted.begin(), sorted.begin() + rank,
+                   sorted.begin() + count);
+  return sorted[rank] / 1e6;
+}
+
+} // namespace
+
+void FrameStats::markFrame() {
+  const std::int64_t now = nowNanoseconds();
+  if (lastFrameNs_ >= 0) {
+    intervals_[next_] = now - lastFrameNs_;
+    next_ = (next_ + 1) % kWindow;
+    count_ = std::min(count_ + 1, kWindow);
+  }
+  lastFrameNs_ = now;
+}
+
+double FrameStats::fps() const {
+  if (count_ == 0)
+    return 0.0;
+  std::int64_t total = 0;
+  for (std::size_t i = 0; i < count_; ++i)
+    total += intervals_[i];
+  return total > 0 ? count_ * 1e9 / total : 0.0;
+}
+
+double FrameStats::percentileMs(double fraction) const {
+  return windowPercentileMs(intervals_, count_, fraction);
+}
+
+void DurationStats::record(std::int64_t nanoseconds) {
+  durations_[next_] = nanoseconds;
+  next_ = (next_ + 1) % kWindow;
+  count_ = std::min(count_ + 1, kWindow);
+}
+
+void DurationStats::reset() {
+  count_ = 0;
+  next_ = 0;
+}
+
+double DurationStats::meanMs() const {
+  if (count_ == 0)
+    return 0.0;
+  std::int64_t total = 0;
+  for (std::size_t i = 0; i < count_; ++i)
+    total += durations_[i];
+  return total / 1e6 / count_;
+}
+
+double DurationStats::percentileMs(double fraction) const {
+  return windowPercentileMs(durations_, count_, fraction);
+}
+
+StartupTimings::StartupTimings()
+    : startNs_(nowNanoseconds()), lastNs_(startNs_) {}
+
+void StartupTimings::mark(const char *phase) {
+  const std::int64_t now = nowNanoseconds();
+  if (recording.load(std::memory_order_relaxed))
+    recordEvent(phase, lastNs_, now);
+  if (count_ < kMaxPhases) {
+    phases_[count_] = phase;
+    durations_[count_] = now - lastNs_;
+    ++count_;
+  }
+  lastNs_ = now;
+}
+
+void StartupTimings::skip() {
+  const std::int64_t now = nowNanoseconds();
+  startNs_ += now - lastNs_;
+  lastNs_ = now;
+}
+
+void StartupTimings::report(const char *note) {
+  if (reported_)
+    return;
+  reported_ = true;
+  std::fprintf(stderr, "startup:");
+  for (std::size_t i = 0; i < count_; ++i)
+    std::fprintf(stderr, "%s %s %.1f ms", i == 0 ? "" : ",", phases_[i],
+                 durations_[i] / 1e6);
+  std::fprintf(stderr, "; time to first frame %.1f ms (%s)\n",
+               (lastNs_ - startNs_) / 1e6, note);
+}
+
+} // namespace profiler
@@ -0,0 +1,24 @@
+#include "ProfilerOverlay.hpp"
+
+#include <QString>
+
+namespace profiler {
+
+void drawOverlay(QPainter &painter, const FrameStats &stats) {
+  const QString text = QString("%1 fps  p50 %2 ms  p99 %3 ms")
+                           .arg(stats.fps(), 0, 'f', 1)
+                           .arg(stats.percentileMs(0.50), 0, 'f', 2)
+                           .arg(stats.percentileMs(0.99), 0, 'f', 2);
+
+  painter.save();
+  painter.setFont(QFont("Monospace", 9));
+  const QRect bounds =
+      painter.fontMetrics().boundingRect(text).adjusted(-4, -2, 4, 2);
+  const QRect box(QPoint(4, 4), bounds.size());
+  painter.fillRect(box, QColor(0, 0, 0, 160));
+  painter.setPen(Qt::white);
+  painter.drawText(box, Qt::AlignCenter, text);
+  painter.restore();
+}
+
+} // namespace profiler
@@ -0,0 +1,59 @@
+#ifndef OFFSCREENBENCH_HPP
+#define OFFSCREENBENCH_HPP
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QSize>
+#include <memory>
+
+class QPaintDevice;
+
+// The --bench N mode of the demos: their drawing code renders N frames into a
+// framebuffer object on an offscreen surface, back to back, instead of being
+// paced by a QTimer and the display's vsync.
+namespace render {
+
+// Implemented by a demo widget next to initializeGL and paintGL, sharing
+// their code. The bench's context is current during every call.
+class BenchScene {
+public:
+  virtual ~BenchScene() = default;
+
+  // Sets up GL resources for a framebuffer of `size`, as initializeGL and
+  // resizeGL would.
+  virtual void benchInitialize(const QSize &size) = 0;
+  // Advances the animation by one step of the widget's timer, with a fixed
+  // time step so that the final image is the same on every run, then draws a
+  // frame. `device` paints into the bound framebuffer for QPainter; GL scenes
+  // draw into it directly.
+  virtual void benchFrame(QPaintDevice &device) = 0;
+};
+
+// The frame count following --bench on the command line, or 0 without it.
+int benchFrames(int argc, char *argv[]);
+
+class OffscreenBench {
+public:
+  // Creates a context with the default surface format and keeps it current
+  // until the bench is destroyed, so a scene declared after the bench can
+  // still release its GL resources in its destructor.
+  explicit OffscreenBench(const QSize &size);
+
+  bool isValid() const { return framebuffer_ != nullptr; }
+
+  // Renders `frames` frames, waiting for each to finish before starting the
+  // next, and prints the frame rate, frame time percentiles and a hash of the
+  // final image on one line. Returns the exit code for main().
+  int run(BenchScene &scene, int frames);
+
+private:
+  QSize size_;
+  QOffscreenSurface surface_;
+  QOpenGLContext context_;
+  std::unique_ptr<QOpenGLFramebufferObject> framebuffer_;
+};
+
+} // namespace render
+
+#endif // OFFSCREENBENCH_HPP
@@ -0,0 +1,93 @@
+#ifndef RENDERSTATE_HPP
+#define RENDERSTATE_HPP
+
+#include <QMatrix4x4>
+#include <QOpenGLFunctions>
+#include <QOpenGLVertexArrayObject>
+#include <QVector3D>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+// State the GL demos set up once in initializeGL so that paintGL is left with
+// a handful of calls on pre-resolved handles.
+namespace render {
+
+// A float vertex attribute read from the bound vertex buffer.
+struct VertexAttribute {
+  GLuint location;
+  GLint components;
+  GLsizei stride;
+  std::size_t offset;
+};
+
+// The buffer bindings and attribute pointers for one draw. Where vertex array
+// objects are available (OpenGL 3.0, ES 3.0 or the ARB/APPLE extensions) they
+// are recorded once and bind() is a single call; otherwise bind() specifies
+// them again, as the widgets used to on every frame.
+class VertexInput {
+public:
+  // Needs a current context. The buffers stay owned by the caller.
+  void create(GLuint vertexBuffer, GLuint indexBuffer,
+              std::initializer_list<VertexAttribute> attributes);
+  void destroy();
+
+  void bind();
+  // Leaves no vertex array or buffers bound, so QPainter can draw afterwards.
+  void release();
+
+  bool usesVertexArray() const { return vao_.isCreated(); }
+
+private:
+  void specify(QOpenGLFunctions *gl) const;
+
+  QOpenGLVertexArrayObject vao_;
+  GLuint vertexBuffer_ = 0;
+  GLuint indexBuffer_ = 0;
+  std::vector<VertexAttribute> attributes_;
+};
+
+// Perspective camera whose matrices are only rebuilt after a setter changed
+// something. revision() increases with every change, so a widget can keep the
+// view and projection uniforms it uploaded until the camera moves.
+class Camera {
+public:
+  void setViewport(int width, int height);
+  void setPerspective(float verticalAngle, float nearPlane, float farPlane);
+  void lookAt(const QVector3D &eye, const QVector3D &centre,
+              const QVector3D &up);
+  // Turns the scene about the y axis through the origin, after lookAt.
+  void setYaw(float degrees);
+
+  const QMatrix4x4 &view();
+  const QMatrix4x4 &projection();
+  const QMatrix4x4 &viewProjection();
+
+  std::uint64_t revision() const { return revision_; }
+
+private:
+  void viewChanged();
+  void projectionChanged();
+
+  float aspect_ = 1.0f;
+  float verticalAngle_ = 45.0f;
+  float nearPlane_ = 0.1f;
+  float farPlane_ = 100.0f;
+  QVector3D eye_{0.0f, 0.0f, 5.0f};
+  QVector3D centre_;
+  QVector3D up_{0.0f, 1.0f, 0.0f};
+  float yaw_ = 0.0f;
+
+  QMatrix4x4 view_;
+  QMatrix4x4 projection_;
+  QMatrix4x4 viewProjection_;
+  bool viewDirty_ = true;
+  bool projectionDirty_ = true;
+  bool viewProjectionDirty_ = true;
+  std::uint64_t revision_ = 1;
+};
+
+} // namespace render
+
+#endif // RENDERSTATE_HPP
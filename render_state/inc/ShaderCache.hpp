@@ -0,0 +1,56 @@
+#ifndef SHADERCACHE_HPP
+#define SHADERCACHE_HPP
+
+#include <QOpenGLShader>
+#include <QOpenGLShaderProgram>
+#include <QString>
+#include <initializer_list>
+#include <memory>
+
+namespace render {
+
+struct ShaderSource {
+  QOpenGLShader::ShaderType type;
+  const char *code;
+};
+
+struct AttributeBinding {
+  const char *name;
+  GLuint location;
+};
+
+// Links the demos' shader programs through Qt's program binary disk cache
+// (QOpenGLShaderProgram::addCacheableShaderFromSourceCode), and counts how
+// many came from it for the startup log. Qt keys a binary by the sources and
+// the GL vendor, renderer and version strings, stores it in "qtshadercache-*"
+// under the application's cache location, and compiles from source when the
+// binary is missing, stale or rejected, or when the context cannot load
+// binaries at all.
+//
+// Attribute bindings are not part of Qt's key, so one set of sources has to be
+// linked with the same bindings everywhere, as the demos do.
+class ShaderCache {
+public:
+  // Needs a current context. Returns a linked program, or nullptr if the
+  // sources do not compile or link; log() then says why.
+  std::unique_ptr<QOpenGLShaderProgram>
+  link(std::initializer_list<ShaderSource> sources,
+       std::initializer_list<AttributeBinding> attributes = {});
+  const QString &log() const { return log_; }
+
+  int loadedCount() const { return loaded_; }
+  int compiledCount() const { return compiled_; }
+  // "warm shader cache" when every program so far was loaded from disk,
+  // "cold shader cache" when any was compiled, or "no shader cache" when
+  // Qt::AA_DisableShaderDiskCache is set
+  const char *summary() const;
+
+private:
+  int loaded_ = 0;
+  int compiled_ = 0;
+  QString log_;
+};
+
+} // namespace render
+
+#endif // SHADERCACHE_HPP
@@ -0,0 +1,115 @@
+#include "OffscreenBench.hpp"
+
+#include <QElapsedTimer>
+#include <QImage>
+#include <QOpenGLFunctions>
+#include <QOpenGLPaintDevice>
+#include <QSurfaceFormat>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace render {
+
+namespace {
+
+// FNV-1a over the visible pixels in RGBA byte order, so that the hash does
+// not depend on the scanline padding or the platform's byte order
+std::uint64_t imageHash(const QImage &image) {
+  const QImage rgba = image.convertToFormat(QImage::Format_RGBA8888);
+  std::uint64_t hash = 14695981039346656037ull;
+  for (int y = 0; y < rgba.height(); ++y) {
+    const uchar *line = rgba.constScanLine(y);
+    for (int x = 0; x < rgba.width() * 4; ++x) {
+      hash ^= line[x];
+      hash *= 1099511628211ull;
+    }
+  }
+  return hash;
+}
+
+double percentileMs(const std::vector<qint64> &sorted, double fraction) {
+  const std::size_t index = std::min(
+      sorted.size() - 1, static_cast<std::size_t>(fraction * sorted.size()));
+  return sorted[index] / 1e6;
+}
+
+} // namespace
+
+int benchFrames(int argc, char *argv[]) {
+  for (int i = 1; i + 1 < argc; ++i) {
+    if (std::strcmp(argv[i], "--bench") == 0)
+      return std::max(0, std::atoi(argv[i + 1]));
+  }
+  return 0;
+}
+
+OffscreenBench::OffscreenBench(const QSize &size) : size_(size) {
+  // Frames are never swapped, so nothing waits for vsync; a zero swap
+  // interval keeps it that way on platforms that sync elsewhere
+  QSurfaceFormat format = QSurfaceFormat::defaultFormat();
+  format.setSwapInterval(0);
+  context_.setFormat(format);
+  if (!context_.create()) {
+    std::fprintf(stderr, "bench: could not create an OpenGL context\n");
+    return;
+  }
+  surface_.setFormat(context_.format());
+  surface_.create();
+  if (!context_.makeCurrent(&surface_)) {
+    std::fprintf(stderr, "bench: could not make the context current\n");
+    return;
+  }
+  framebuffer_ = std::make_unique<QOpenGLFramebufferObject>(
+      size_, QOpenGLFramebufferObject::CombinedDepthStencil);
+  if (!framebuffer_->isValid()) {
+    std::fprintf(stderr, "bench: could not create a %dx%d framebuffer\n",
+                 size_.width(), size_.height());
+    framebuffer_.reset();
+  }
+}
+
+int OffscreenBench::run(BenchScene &scene, int frames) {
+  if (!isValid() || frames <= 0)
+    return EXIT_FAILURE;
+  QOpenGLFunctions *gl = context_.functions();
+  framebuffer_->bind();
+  gl->glViewport(0, 0, size_.width(), size_.height());
+  scene.benchInitialize(size_);
+  QOpenGLPaintDevice device(size_);
+
+  std::vector<qint64> frameNs(frames);
+  QElapsedTimer total;
+  total.start();
+  for (int frame = 0; frame < frames; ++frame) {
+    QElapsedTimer timer;
+    timer.start();
+    // QPainter and the scenes may leave another framebuffer bound
+    framebuffer_->bind();
+    scene.benchFrame(device);
+    // Without a swap to throttle on, the time of a frame is only known once
+    // the GL has finished it
+    gl->glFinish();
+    frameNs[frame] = timer.nsecsElapsed();
+  }
+  const double seconds = total.nsecsElapsed() / 1e9;
+
+  const std::uint64_t hash = imageHash(framebuffer_->toImage());
+  std::sort(frameNs.begin(), frameNs.end());
+  const char *renderer =
+      reinterpret_cast<const char *>(gl->glGetString(GL_RENDERER));
+  std::printf("bench: renderer=\"%s\" size=%dx%d frames=%d fps=%.1f "
+              "p50_ms=%.3f p90_ms=%.3f p99_ms=%.3f max_ms=%.3f "
+              "hash=%016llx\n",
+              renderer ? renderer : "unknown", size_.width(), size_.height(),
+              frames, frames / seconds, percentileMs(frameNs, 0.5),
+              percentileMs(frameNs, 0.9), percentileMs(frameNs, 0.99),
+              frameNs.back() / 1e6, static_cast<unsigned long long>(hash));
+  std::fflush(stdout);
+  return EXIT_SUCCESS;
+}
+
+} // namespace render
@@ -0,0 +1,142 @@
+#include "RenderState.hpp"
+
+#include <QOpenGLContext>
+
+namespace render {
+
+namespace {
+
+QOpenGLFunctions *currentFunctions() {
+  return QOpenGLContext::currentContext()->functions();
+}
+
+} // namespace
+
+void VertexInput::create(GLuint vertexBuffer, GLuint indexBuffer,
+                         std::initializer_list<VertexAttribute> attributes) {
+  destroy();
+  vertexBuffer_ = vertexBuffer;
+  indexBuffer_ = indexBuffer;
+  attributes_.assign(attributes);
+
+  if (!vao_.create())
+    return;
+  QOpenGLFunctions *gl = currentFunctions();
+  vao_.bind();
+  specify(gl);
+  vao_.release();
+  // The array buffer binding is not part of the vertex array
+  gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void VertexInput::destroy() {
+  vao_.destroy();
+  attributes_.clear();
+}
+
+void VertexInput::bind() {
+  if (vao_.isCreated())
+    vao_.bind();
+  else
+    specify(currentFunctions());
+}
+
+void VertexInput::release() {
+  if (vao_.isCreated()) {
+    vao_.release();
+    return;
+  }
+  QOpenGLFunctions *gl = currentFunctions();
+  for (const VertexAttribute &attribute : attributes_)
+    gl->glDisableVertexAttribArray(attribute.location);
+  gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+  gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void VertexInput::specify(QOpenGLFunctions *gl) const {
+  gl->glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer_);
+  gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer_);
+  for (const VertexAttribute &attribute : attributes_) {
+    gl->glEnableVertexAttribArray(attribute.location);
+    gl->glVertexAttribPointer(attribute.location, attribute.components,
+                              GL_FLOAT, GL_FALSE, attribute.stride,
+                              reinterpret_cast<const void *>(attribute.offset));
+  }
+}
+
+void Camera::setViewport(int width, int height) {
+  const float aspect = height > 0 ? float(width) / height : 1.0f;
+  if (aspect == aspect_)
+    return;
+  aspect_ = aspect;
+  projectionChanged();
+}
+
+void Camera::setPerspective(float verticalAngle, float nearPlane,
+                            float farPlane) {
+  if (verticalAngle == verticalAngle_ && nearPlane == nearPlane_ &&
+      farPlane == farPlane_)
+    return;
+  verticalAngle_ = verticalAngle;
+  nearPlane_ = nearPlane;
+  farPlane_ = farPlane;
+  projectionChanged();
+}
+
+void Camera::lookAt(const QVector3D &eye, const QVector3D &centre,
+                    const QVector3D &up) {
+  if (eye == eye_ && centre == centre_ && up == up_)
+    return;
+  eye_ = eye;
+  centre_ = centre;
+  up_ = up;
+  viewChanged();
+}
+
+void Camera::setYaw(float degrees) {
+  if (degrees == yaw_)
+    return;
+  yaw_ = degrees;
+  viewChanged();
+}
+
+const QMatrix4x4 &Camera::view() {
+  if (viewDirty_) {
+    view_.setToIdentity();
+    view_.lookAt(eye_, centre_, up_);
+    view_.rotate(yaw_, QVector3D(0.0f, 1.0f, 0.0f));
+    viewDirty_ = false;
+  }
+  return view_;
+}
+
+const QMatrix4x4 &Camera::projection() {
+  if (projectionDirty_) {
+    projection_.setToIdentity();
+    projection_.perspective(verticalAngle_, aspect_, nearPlane_, farPlane_);
+    projectionDirty_ = false;
+  }
+  return projection_;
+}
+
+const QMatrix4x4 &Camera::viewProjection() {
+  if (viewProjectionDirty_) {
+    viewProjection_ = projection() * view();
+    viewProjectionDirty_ = false;
+  }
+  return viewProjection_;
+}
+
+void Camera::viewChanged() {
+  viewDirty_ = true;
+  viewProjectionDirty_ = true;
+  ++revision_;
+}
+
+void Camera::projectionChanged() {
+  projectionDirty_ = true;
+  viewProjectionDirty_ = true;
+  ++revision_;
+}
+
+} // namespace render
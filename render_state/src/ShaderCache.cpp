@@ -0,0 +1,42 @@
+#include "ShaderCache.hpp"
+
+#include <QCoreApplication>
+
+namespace render {
+
+std::unique_ptr<QOpenGLShaderProgram>
+ShaderCache::link(std::initializer_list<ShaderSource> sources,
+                  std::initializer_list<AttributeBinding> attributes) {
+  log_.clear();
+  auto program = std::make_unique<QOpenGLShaderProgram>();
+  // Cacheable shaders are only compiled in link(), and only if Qt finds no
+  // usable binary
+  for (const ShaderSource &source : sources) {
+    if (!program->addCacheableShaderFromSourceCode(source.type, source.code)) {
+      log_ = program->log();
+      return nullptr;
+    }
+  }
+  for (const AttributeBinding &attribute : attributes)
+    program->bindAttributeLocation(attribute.name, attribute.location);
+  if (!program->link()) {
+    log_ = program->log();
+    return nullptr;
+  }
+
+  // A program Qt loaded from its cache never had shader objects attached;
+  // one it compiled keeps them
+  if (program->shaders().isEmpty())
+    ++loaded_;
+  else
+    ++compiled_;
+  return program;
+}
+
+const char *ShaderCache::summary() const {
+  if (QCoreApplication::testAttribute(Qt::AA_DisableShaderDiskCache))
+    return "no shader cache";
+  return compiled_ == 0 ? "warm shader cache" : "cold shader cache";
+}
+
+} // namespace render
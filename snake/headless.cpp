@@ -0,0 +1,507 @@
+#include "Profiler.hpp"
+#include "SnakeAutopilot.hpp"
+#include "SnakeBatch.hpp"
+#include "SnakeReplay.hpp"
+#include "SnakeSnapshot.hpp"
+#include "SnakeState.hpp"
+#include "WorkerPool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Runs the snake reducer without a GUI, driven by a simple seeded policy, and
+// reports throughput. Used for regression and training workloads.
+
+namespace {
+
+struct Options {
+  int rows = 25;
+  int cols = 25;
+  long long ticks = 10'000'000;
+  unsigned int seed = 1;
+  bool placement = false;
+  int batch = 0;
+  unsigned int threads = std::thread::hardware_concurrency();
+  bool verify = false;
+  bool autopilot = false;
+  long long budgetMicroseconds = 1000;
+  std::string recordPath;
+  std::string replayPath;
+  bool snapshot = false;
+};
+
+void printUsage(const char *program) {
+  std::printf("Usage: %s [--rows N] [--cols N] [--ticks N] [--seed N] "
+              "[--record FILE] [--placement] [--snapshot]\n"
+              "       %s --replay FILE\n"
+              "       %s --batch GAMES [--threads N] [--verify] [--rows N] "
+              "[--cols N] [--ticks N] [--seed N]\n"
+              "       %s --autopilot [--budget-us N] [--rows N] [--cols N] "
+              "[--ticks N] [--seed N]\n",
+              program, program, program, program);
+}
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (std::strcmp(arg, "--rows") == 0 && hasValue) {
+      options.rows = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--cols") == 0 && hasValue) {
+      options.cols = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--ticks") == 0 && hasValue) {
+      options.ticks = std::atoll(argv[++i]);
+    } else if (std::strcmp(arg, "--seed") == 0 && hasValue) {
+      options.seed = static_cast<unsigned int>(std::strtoul(argv[++i],
+                                                            nullptr, 10));
+    } else if (std::strcmp(arg, "--placement") == 0) {
+      options.placement = true;
+    } else if (std::strcmp(arg, "--snapshot") == 0) {
+      options.snapshot = true;
+    } else if (std::strcmp(arg, "--batch") == 0 && hasValue) {
+      options.batch = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--threads") == 0 && hasValue) {
+      options.threads = static_cast<unsigned int>(std::atoi(argv[++i]));
+    } else if (std::strcmp(arg, "--verify") == 0) {
+      options.verify = true;
+    } else if (std::strcmp(arg, "--record") == 0 && hasValue) {
+      options.recordPath = argv[++i];
+    } else if (std::strcmp(arg, "--replay") == 0 && hasValue) {
+      options.replayPath = argv[++i];
+    } else if (std::strcmp(arg, "--autopilot") == 0) {
+      options.autopilot = true;
+    } else if (std::strcmp(arg, "--budget-us") == 0 && hasValue) {
+      options.budgetMicroseconds = std::atoll(argv[++i]);
+    } else {
+      return false;
+    }
+  }
+  return options.rows >= kMinBoardSide && options.rows <= kMaxBoardSide &&
+         options.cols >= kMinBoardSide && options.cols <= kMaxBoardSide &&
+         options.ticks > 0 && options.batch >= 0 && options.threads > 0;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+// Occasionally turns, preferring directions whose next cell is free so games
+// run long enough to be representative.
+Direction choosePolicyDirection(const GameState &state, std::minstd_rand &rng) {
+  static constexpr std::array<std::array<Direction, 3>, 4> candidates = {{
+      {Direction::Up, Direction::Left, Direction::Right},
+      {Direction::Down, Direction::Right, Direction::Left},
+      {Direction::Left, Direction::Down, Direction::Up},
+      {Direction::Right, Direction::Up, Direction::Down},
+  }};
+  const auto &options = candidates[static_cast<int>(state.currentDirection)];
+  const unsigned int roll = rng();
+  const int first = roll % 8 == 0 ? 1 + static_cast<int>(roll / 8 % 2) : 0;
+  for (int i = 0; i < 3; ++i) {
+    const Direction direction = options[(first + i) % 3];
+    if (!isSnakeCell(state,
+                     neighborCell(state, state.snake.front(), direction)))
+      return direction;
+  }
+  return state.currentDirection;
+}
+
+int runSimulation(const Options &options) {
+  std::minstd_rand policyRng(options.seed);
+  GameState state =
+      initializeGameState(options.rows, options.cols, options.seed);
+
+  // A recording covers the first game only, as a replay starts from one seed
+  std::unique_ptr<ReplayRecorder> recorder;
+  if (!options.recordPath.empty()) {
+    recorder = std::make_unique<ReplayRecorder>(
+        options.recordPath, options.rows, options.cols, options.seed);
+    if (!recorder->isOpen()) {
+      std::fprintf(stderr, "cannot open %s: %s\n", options.recordPath.c_str(),
+                   std::strerror(errno));
+      return 1;
+    }
+  }
+  bool recorded = true;
+
+  long long games = 0;
+  long long totalScore = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (long long tick = 0; tick < options.ticks; ++tick) {
+    const Direction direction = choosePolicyDirection(state, policyRng);
+    if (direction != state.currentDirection) {
+      const UserDirectionAction turn{direction};
+      reduceInPlace(state, turn);
+      if (recorder)
+        recorder->record(turn, state);
+    }
+    reduceInPlace(state, RequestNextFrameAction{});
+    if (recorder)
+      recorder->record(RequestNextFrameAction{}, state);
+
+    if (state.status == GameStatus::GameOver) {
+      if (recorder) {
+        recorded = recorder->finish(state);
+        recorder.reset();
+      }
+      ++games;
+      totalScore += state.snake.size();
+      state = initializeGameState(options.rows, options.cols, policyRng());
+    }
+  }
+  if (recorder)
+    recorded = recorder->finish(state);
+  const double elapsed = secondsSince(start);
+  if (!recorded) {
+    std::fprintf(stderr, "could not write the replay %s\n",
+                 options.recordPath.c_str());
+    return 1;
+  }
+
+  std::printf("board:        %dx%d\n", options.rows, options.cols);
+  std::printf("ticks:        %lld\n", options.ticks);
+  std::printf("elapsed:      %.3f s\n", elapsed);
+  std::printf("ticks/second: %.0f\n", options.ticks / elapsed);
+  std::printf("games over:   %lld\n", games);
+  if (games > 0)
+    std::printf("mean score:   %.1f\n",
+                static_cast<double>(totalScore) / games);
+  std::printf("final length: %zu\n", state.snake.size());
+  return 0;
+}
+
+// Times reward placement on growing boards to show it does not depend on the
+// grid size.
+int runPlacementBenchmark(const Options &options) {
+  constexpr int placements = 1'000'000;
+  for (const int size : {25, 200, 1000}) {
+    GameState state = initializeGameState(size, size, options.seed);
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < placements; ++i)
+      placeReward(state);
+    const double elapsed = secondsSince(start);
+    std::printf("%4dx%-4d %8.1f ns/placement\n", size, size,
+                elapsed * 1e9 / placements);
+  }
+  return 0;
+}
+
+// Plays with the autopilot and reports how its decisions were made and how
+// long they took.
+int runAutopilot(const Options &options) {
+  SnakeAutopilot autopilot(
+      options.rows, options.cols,
+      std::chrono::microseconds(options.budgetMicroseconds));
+  GameState state =
+      initializeGameState(options.rows, options.cols, options.seed);
+
+  long long games = 0;
+  std::size_t bestLength = state.snake.size();
+  for (long long tick = 0; tick < options.ticks; ++tick) {
+    reduceInPlace(state, autopilot.decide(state));
+    reduceInPlace(state, RequestNextFrameAction{});
+    bestLength = std::max(bestLength, state.snake.size());
+
+    if (state.status == GameStatus::GameOver) {
+      ++games;
+      state = initializeGameState(options.rows, options.cols,
+                                  options.seed + games);
+    }
+  }
+
+  using Strategy = SnakeAutopilot::Strategy;
+  const auto &latencies = autopilot.latencies();
+  std::printf("board:        %dx%d\n", options.rows, options.cols);
+  std::printf("decisions:    %llu (path %llu, cycle %llu, greedy %llu, "
+              "over budget %llu)\n",
+              static_cast<unsigned long long>(latencies.count()),
+              static_cast<unsigned long long>(
+                  autopilot.decisions(Strategy::Path)),
+              static_cast<unsigned long long>(
+                  autopilot.decisions(Strategy::Cycle)),
+              static_cast<unsigned long long>(
+                  autopilot.decisions(Strategy::Greedy)),
+              static_cast<unsigned long long>(
+                  autopilot.decisions(Strategy::OverBudget)));
+  std::printf("games over:   %lld\n", games);
+  std::printf("best length:  %zu\n", bestLength);
+  std::printf("latency (us): mean %.2f  p50 %.2f  p90 %.2f  p99 %.2f  "
+              "max %.2f\n",
+              latencies.mean() / 1e3, latencies.percentile(0.5) / 1e3,
+              latencies.percentile(0.9) / 1e3,
+              latencies.percentile(0.99) / 1e3, latencies.max() / 1e3);
+  return 0;
+}
+
+int runReplay(const Options &options) {
+  const auto start = std::chrono::steady_clock::now();
+  const ReplayResult result = replayFile(options.replayPath);
+  const double elapsed = secondsSince(start);
+  if (!result.ok) {
+    std::printf("replay failed: %s\n", result.error.c_str());
+    return 1;
+  }
+
+  std::printf("file:         %s (%zu bytes)\n", options.replayPath.c_str(),
+              result.bytes);
+  std::printf("ticks:        %llu\n",
+              static_cast<unsigned long long>(result.ticks));
+  std::printf("turns:        %llu\n",
+              static_cast<unsigned long long>(result.directionActions));
+  std::printf("checkpoints:  %llu verified\n",
+              static_cast<unsigned long long>(result.checkpoints));
+  std::printf("final length: %zu\n", result.finalState.snake.size());
+  std::printf("elapsed:      %.3f ms\n", elapsed * 1e3);
+  return 0;
+}
+
+// Keeps the head on a cycle through every cell: right along even rows, left
+// along odd rows and down at the ends. With a row count divisible by four the
+// starting snake already faces along this cycle.
+Direction serpentineDirection(const GameState &state) {
+  const auto &head = state.snake.front();
+  if (head.first % 2 == 0)
+    return head.second < state.cols - 1 ? Direction::Right : Direction::Down;
+  return head.second > 0 ? Direction::Left : Direction::Down;
+}
+
+void serpentineTick(GameState &state) {
+  reduceInPlace(state, UserDirectionAction{serpentineDirection(state)});
+  reduceInPlace(state, RequestNextFrameAction{});
+}
+
+// Measures the spectator snapshot stream as the snake grows: delta and
+// keyframe sizes, the average bytes per tick, and encode and decode cost.
+int runSnapshotBenchmark(const Options &options) {
+  const long long ticks = std::min(options.ticks, 100'000LL);
+  const long long verifyTicks = std::min(ticks, 5'000LL);
+  std::printf("%7s  %9s  %8s  %10s  %10s  %10s  %10s\n", "length", "board",
+              "delta B", "keyframe B", "bytes/tick", "encode ns",
+              "decode ns");
+  for (const std::size_t length : {16, 256, 4096, 65536}) {
+    // The snake eats about once per lap of the board, so leave room for it
+    // to keep growing for the whole run
+    int side = 8;
+    while (std::size_t(side) * side < 2 * length ||
+           double(side) * side * side * side < 16.0 * ticks)
+      side += 4;
+    GameState grown = initializeGameState(side, side, options.seed);
+    // Grow the snake by keeping the reward just ahead of the head
+    while (grown.snake.size() < length) {
+      reduceInPlace(grown, UserDirectionAction{serpentineDirection(grown)});
+      grown.reward =
+          neighborCell(grown, grown.snake.front(), grown.currentDirection);
+      reduceInPlace(grown, RequestNextFrameAction{});
+    }
+
+    // Check every decoded tick against the simulation before timing anything
+    {
+      GameState state = grown;
+      SnapshotEncoder encoder;
+      SnapshotDecoder decoder;
+      for (long long tick = 0; tick < verifyTicks; ++tick) {
+        serpentineTick(state);
+        if (!decoder.decode(encoder.encode(state)) ||
+            hashGameState(decoder.state()) != hashGameState(state)) {
+          std::printf("decoded state differs at length %zu, tick %lld\n",
+                      length, tick);
+          return 1;
+        }
+      }
+    }
+
+    GameState state = grown;
+    auto start = std::chrono::steady_clock::now();
+    for (long long tick = 0; tick < ticks; ++tick)
+      serpentineTick(state);
+    const double simulateSeconds = secondsSince(start);
+
+    state = grown;
+    SnapshotEncoder encoder;
+    std::vector<unsigned char> stream;
+    stream.reserve(ticks * 8);
+    std::size_t keyframes = 0;
+    std::size_t keyframeBytes = 0;
+    start = std::chrono::steady_clock::now();
+    for (long long tick = 0; tick < ticks; ++tick) {
+      serpentineTick(state);
+      const auto record = encoder.encode(state);
+      if (record[0] & 1) {
+        ++keyframes;
+        keyframeBytes += record.size();
+      }
+      stream.insert(stream.end(), record.begin(), record.end());
+    }
+    const double encodeSeconds = secondsSince(start) - simulateSeconds;
+    if (state.status != GameStatus::Running) {
+      std::printf("snake died at length %zu\n", length);
+      return 1;
+    }
+
+    SnapshotDecoder decoder;
+    start = std::chrono::steady_clock::now();
+    const bool decoded = decoder.decode(stream);
+    const double decodeSeconds = secondsSince(start);
+    if (!decoded || hashGameState(decoder.state()) != hashGameState(state)) {
+      std::printf("decoded stream differs at length %zu\n", length);
+      return 1;
+    }
+
+    const double deltaBytes = double(stream.size() - keyframeBytes) /
+                              double(ticks - keyframes);
+    std::printf("%7zu  %4dx%-4d  %8.2f  %10zu  %10.2f  %10.1f  %10.1f\n",
+                length, side, side, deltaBytes, keyframeBytes / keyframes,
+                double(stream.size()) / ticks,
+                std::max(encodeSeconds, 0.0) * 1e9 / ticks,
+                decodeSeconds * 1e9 / ticks);
+  }
+  return 0;
+}
+
+// Per-game action source for batch runs: occasionally requests a random turn
+// and otherwise advances, restarting finished games with a fresh seed. Both
+// the batch and the scalar reference draw from it in the same order.
+struct BatchDriver {
+  std::vector<std::minstd_rand> rngs;
+
+  BatchDriver(int games, unsigned int seed) {
+    for (int game = 0; game < games; ++game)
+      rngs.emplace_back(seed + game);
+  }
+
+  unsigned int restartSeed(std::size_t game) { return rngs[game](); }
+
+  Action nextAction(std::size_t game) {
+    const unsigned int roll = rngs[game]();
+    if (roll % 4 == 0)
+      return UserDirectionAction{static_cast<Direction>(roll / 4 % 4)};
+    return RequestNextFrameAction{};
+  }
+};
+
+std::vector<unsigned int> batchSeeds(const Options &options) {
+  std::vector<unsigned int> seeds(options.batch);
+  for (int game = 0; game < options.batch; ++game)
+    seeds[game] = options.seed * 7919u + game;
+  return seeds;
+}
+
+// Runs `options.ticks` steps of every game and returns the elapsed time.
+double runBatch(const Options &options, SnakeBatch &batch, WorkerPool &pool) {
+  BatchDriver driver(options.batch, options.seed);
+  std::vector<Action> actions(options.batch);
+  const auto fillActions = [&](std::size_t begin, std::size_t end) {
+    for (std::size_t game = begin; game < end; ++game) {
+      if (batch.status(game) == GameStatus::GameOver)
+        batch.resetGame(game, driver.restartSeed(game));
+      actions[game] = driver.nextAction(game);
+    }
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  for (long long step = 0; step < options.ticks; ++step) {
+    pool.parallelFor(actions.size(), fillActions);
+    batch.step(actions, pool);
+  }
+  return secondsSince(start);
+}
+
+bool sameGameState(const GameState &a, const GameState &b) {
+  if (a.snake.size() != b.snake.size())
+    return false;
+  for (std::size_t i = 0; i < a.snake.size(); ++i) {
+    if (a.snake[i] != b.snake[i])
+      return false;
+  }
+  return a.rows == b.rows && a.cols == b.cols && a.reward == b.reward &&
+         a.currentDirection == b.currentDirection &&
+         a.moveMade == b.moveMade && a.status == b.status &&
+         a.freeCells == b.freeCells && a.freeSlot == b.freeSlot &&
+         a.rng == b.rng;
+}
+
+// Replays the batch's action streams through the scalar reducer and compares
+// every game.
+int verifyBatch(const Options &options) {
+  const auto seeds = batchSeeds(options);
+  WorkerPool pool(options.threads);
+  SnakeBatch batch(options.rows, options.cols, seeds);
+  runBatch(options, batch, pool);
+
+  BatchDriver driver(options.batch, options.seed);
+  int mismatches = 0;
+  for (int game = 0; game < options.batch; ++game) {
+    GameState state = initializeGameState(options.rows, options.cols,
+                                          seeds[game]);
+    for (long long step = 0; step < options.ticks; ++step) {
+      if (state.status == GameStatus::GameOver)
+        state = initializeGameState(options.rows, options.cols,
+                                    driver.restartSeed(game));
+      reduceInPlace(state, driver.nextAction(game));
+    }
+    if (!sameGameState(state, batch.gameState(game)))
+      ++mismatches;
+  }
+
+  std::printf("verified %d games x %lld steps: %d mismatches\n",
+              options.batch, options.ticks, mismatches);
+  return mismatches == 0 ? 0 : 1;
+}
+
+// Reports game-steps per second for thread counts from 1 up to --threads.
+int runBatchScaling(const Options &options) {
+  const auto seeds = batchSeeds(options);
+  std::printf("board %dx%d, %d games, %lld steps\n", options.rows,
+              options.cols, options.batch, options.ticks);
+  std::printf("threads  steps/second  speedup\n");
+
+  double baseline = 0.0;
+  for (unsigned int threads = 1;; threads *= 2) {
+    if (threads > options.threads)
+      threads = options.threads;
+    WorkerPool pool(threads);
+    SnakeBatch batch(options.rows, options.cols, seeds);
+    const double elapsed = runBatch(options, batch, pool);
+    const double rate = options.batch * options.ticks / elapsed;
+    if (threads == 1)
+      baseline = rate;
+    std::printf("%7u  %12.0f  %6.2fx\n", threads, rate, rate / baseline);
+    if (threads == options.threads)
+      break;
+  }
+  return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  profiler::initFromEnvironment();
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  if (!options.replayPath.empty())
+    return runReplay(options);
+  if (options.autopilot)
+    return runAutopilot(options);
+  if (options.snapshot)
+    return runSnapshotBenchmark(options);
+  if (options.batch > 0)
+    return options.verify ? verifyBatch(options) : runBatchScaling(options);
+  return options.placement ? runPlacementBenchmark(options)
+                           : runSimulation(options);
+}
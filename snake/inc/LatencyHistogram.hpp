@@ -0,0 +1,62 @@
+#ifndef LATENCYHISTOGRAM_HPP
+#define LATENCYHISTOGRAM_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed-size histogram of nanosecond latencies with 16 linear sub-buckets per
+// power of two, so percentiles are accurate to about 6% without allocating.
+class LatencyHistogram {
+public:
+    void record(std::uint64_t nanoseconds) {
+        ++buckets_[bucketIndex(nanoseconds)];
+        ++count_;
+        total_ += nanoseconds;
+        max_ = std::max(max_, nanoseconds);
+    }
+
+    void reset() { *this = LatencyHistogram(); }
+
+    std::uint64_t count() const { return count_; }
+    std::uint64_t max() const { return max_; }
+    double mean() const { return count_ == 0 ? 0.0 : double(total_) / count_; }
+
+    // Lower bound of the bucket holding the given fraction (0..1) of samples.
+    std::uint64_t percentile(double fraction) const {
+        const auto target = static_cast<std::uint64_t>(fraction * count_);
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < buckets_.size(); ++i) {
+            seen += buckets_[i];
+            if (seen > target)
+                return bucketFloor(i);
+        }
+        return max_;
+    }
+
+private:
+    static constexpr int kSubBuckets = 16;
+
+    static std::size_t bucketIndex(std::uint64_t value) {
+        if (value < kSubBuckets)
+            return value;
+        const int shift = std::bit_width(value) - 5;
+        return kSubBuckets * (shift + 1) + ((value >> shift) - kSubBuckets);
+    }
+
+    static std::uint64_t bucketFloor(std::size_t index) {
+        if (index < kSubBuckets)
+            return index;
+        const int shift = static_cast<int>(index / kSubBuckets) - 1;
+        return (kSubBuckets + index % kSubBuckets) << shift;
+    }
+
+    std::array<std::uint64_t, kSubBuckets * 61> buckets_{};
+    std::uint64_t count_ = 0;
+    std::uint64_t total_ = 0;
+    std::uint64_t max_ = 0;
+};
+
+#endif // LATENCYHISTOGRAM_HPP
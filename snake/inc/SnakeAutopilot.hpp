@@ -0,0 +1,64 @@
+#ifndef SNAKEAUTOPILOT_HPP
+#define SNAKEAUTOPILOT_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+#include "LatencyHistogram.hpp"
+#include "SnakeState.hpp"
+
+// Chooses moves for the snake. Each decision runs an A* search (breadth-first
+// on boards with an odd side) from the head to the reward over the occupancy
+// grid; if the reward cannot be reached it follows a Hamiltonian cycle of the board, and if the search
+// exceeds its time budget it takes the safe move closest to the reward.
+// All search buffers are sized once for the board and reused.
+class SnakeAutopilot {
+public:
+    enum class Strategy { Path, Cycle, Greedy, OverBudget };
+
+    SnakeAutopilot(int rows, int cols,
+                   std::chrono::microseconds budget = std::chrono::microseconds(1000));
+
+    UserDirectionAction decide(const GameState &state);
+
+    Strategy lastStrategy() const { return lastStrategy_; }
+    const LatencyHistogram &latencies() const { return latencies_; }
+    std::uint64_t decisions(Strategy strategy) const {
+        return decisions_[static_cast<int>(strategy)];
+    }
+
+private:
+    enum class SearchResult { Found, Unreachable, OverBudget };
+
+    SearchResult searchPath(const GameState &state,
+                            std::chrono::steady_clock::time_point start,
+                            Direction &direction);
+    bool cycleDirection(const GameState &state, Direction &direction) const;
+    bool greedyDirection(const GameState &state, Direction &direction) const;
+    void buildCycle();
+
+    int rows_;
+    int cols_;
+    std::chrono::microseconds budget_;
+
+    // Search scratch space, one entry per cell. A cell's stamp says whether the
+    // current search has it open or closed; its cost, the steps from the head,
+    // is only valid then.
+    std::vector<std::uint32_t> visitStamp_;
+    std::vector<int> cost_;
+    std::vector<Direction> firstMove_;
+    std::vector<int> open_;
+    std::vector<int> deferred_;
+    std::uint32_t stamp_ = 0;
+
+    // Direction to leave each cell along the Hamiltonian cycle; empty when the
+    // board has no simple cycle (both sides odd).
+    std::vector<Direction> cycle_;
+
+    Strategy lastStrategy_ = Strategy::Path;
+    LatencyHistogram latencies_;
+    std::uint64_t decisions_[4] = {};
+};
+
+#endif // SNAKEAUTOPILOT_HPP
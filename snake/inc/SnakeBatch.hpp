@@ -0,0 +1,59 @@
+#ifndef SNAKEBATCH_HPP
+#define SNAKEBATCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "SnakeState.hpp"
+#include "WorkerPool.hpp"
+
+// Steps many snake games that share a board size at once. Each field lives in
+// one contiguous array indexed by game (bodies and free-cell lists in fixed
+// per-game slices), so stepping a batch walks memory linearly instead of
+// chasing one heap allocation per game. Every game evolves exactly as
+// reduce() would evolve the equivalent GameState.
+class SnakeBatch {
+public:
+    // Game i starts as initializeGameState(rows, cols, seeds[i]).
+    SnakeBatch(int rows, int cols, std::span<const unsigned int> seeds);
+
+    std::size_t size() const { return statuses_.size(); }
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    GameStatus status(std::size_t game) const { return statuses_[game]; }
+
+    // Applies actions[i] to game i, splitting the games across the pool.
+    void step(std::span<const Action> actions, WorkerPool &pool);
+    void resetGame(std::size_t game, unsigned int seed);
+    GameState gameState(std::size_t game) const;
+
+private:
+    void loadGame(std::size_t game, const GameState &state);
+    void stepGame(std::size_t game, const Action &action);
+    void advance(std::size_t game);
+    void occupyCell(std::size_t game, int cell);
+    void releaseCell(std::size_t game, int cell);
+
+    int rows_;
+    int cols_;
+    int cells_;
+    int bodyMask_;
+
+    std::vector<int> heads_;
+    std::vector<Direction> directions_;
+    std::vector<std::uint8_t> movesMade_;
+    std::vector<GameStatus> statuses_;
+    std::vector<int> rewards_;
+    std::vector<std::minstd_rand> rngs_;
+    std::vector<int> bodyStarts_;
+    std::vector<int> bodyLengths_;
+    std::vector<int> bodies_;
+    std::vector<int> freeCounts_;
+    std::vector<int> freeCells_;
+    std::vector<int> freeSlots_;
+};
+
+#endif // SNAKEBATCH_HPP
@@ -0,0 +1,54 @@
+#ifndef SNAKEGLRENDERER_HPP
+#define SNAKEGLRENDERER_HPP
+
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLShaderProgram>
+#include <QSize>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+#include "SnakeState.hpp"
+
+// Draws the board with OpenGL 3.3 instead of QPainter. The board lives on the
+// GPU as one byte per cell in a texture buffer; the fragment shader looks up
+// each pixel's cell and colors it, including the head's direction indicator,
+// so a frame is a single draw call whatever the board size. Each tick only
+// the changed cells are patched in with glBufferSubData.
+class SnakeGLRenderer : protected QOpenGLExtraFunctions {
+public:
+  SnakeGLRenderer() = default;
+  ~SnakeGLRenderer();
+
+  // Needs a current 3.3 core context. Returns false if it cannot render, in
+  // which case the caller should keep drawing with QPainter.
+  bool initialize();
+
+  // With fullUpload the whole board is re-sent; otherwise only dirtyCells.
+  void render(const GameState &state, bool fullUpload,
+              std::span<const std::pair<int, int>> dirtyCells,
+              QSize viewport, int cellPixels);
+
+private:
+  std::uint8_t cellCode(const GameState &state,
+                        const std::pair<int, int> &cell) const;
+  void uploadBoard(const GameState &state);
+
+  std::unique_ptr<QOpenGLShaderProgram> program_;
+  GLuint vao_ = 0;
+  GLuint quadBuffer_ = 0;
+  GLuint cellBuffer_ = 0;
+  GLuint cellTexture_ = 0;
+  GLint boardCellsLocation_ = -1;
+  GLint boardPixelsLocation_ = -1;
+  GLint viewportLocation_ = -1;
+  GLint cellPixelsLocation_ = -1;
+
+  // CPU copy of the cell buffer, used to skip patches that change nothing
+  std::vector<std::uint8_t> cells_;
+  int rows_ = 0;
+  int cols_ = 0;
+};
+
+#endif // SNAKEGLRENDERER_HPP
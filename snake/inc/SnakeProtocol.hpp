@@ -0,0 +1,84 @@
+#ifndef SNAKEPROTOCOL_HPP
+#define SNAKEPROTOCOL_HPP
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "SnakeState.hpp"
+
+// Wire format between snake_server and its clients.
+//
+// Client to server: one byte per input, a Direction (0-3), applied as a
+// UserDirectionAction as soon as it arrives.
+//
+// Server to client: a fixed-size frame after every tick (little endian):
+//
+//   u8  status, u8 direction, u16 reserved
+//   u32 tick
+//   u64 tickTimeNs   steady clock time the tick was due
+//   u16 headRow, headCol, rewardRow, rewardCol
+//   u32 length
+//
+// The body is not sent; a client that needs it keeps the last `length` heads.
+
+constexpr std::size_t kTickFrameSize = 28;
+
+struct TickFrame {
+    GameStatus status = GameStatus::Running;
+    Direction direction = Direction::Right;
+    std::uint32_t tick = 0;
+    std::uint64_t tickTimeNs = 0;
+    std::pair<int, int> head;
+    std::pair<int, int> reward;
+    std::uint32_t length = 0;
+};
+
+// Nanoseconds on the steady clock, comparable between processes on one host.
+inline std::uint64_t steadyNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+inline void encodeTickFrame(const TickFrame &frame, unsigned char *out) {
+    auto put = [&out](std::uint64_t value, int bytes) {
+        for (int i = 0; i < bytes; ++i)
+            *out++ = static_cast<unsigned char>(value >> (8 * i));
+    };
+    put(static_cast<std::uint64_t>(frame.status), 1);
+    put(static_cast<std::uint64_t>(frame.direction), 1);
+    put(0, 2);
+    put(frame.tick, 4);
+    put(frame.tickTimeNs, 8);
+    put(static_cast<std::uint16_t>(frame.head.first), 2);
+    put(static_cast<std::uint16_t>(frame.head.second), 2);
+    put(static_cast<std::uint16_t>(frame.reward.first), 2);
+    put(static_cast<std::uint16_t>(frame.reward.second), 2);
+    put(frame.length, 4);
+}
+
+inline TickFrame decodeTickFrame(const unsigned char *in) {
+    auto get = [&in](int bytes) {
+        std::uint64_t value = 0;
+        for (int i = 0; i < bytes; ++i)
+            value |= std::uint64_t(*in++) << (8 * i);
+        return value;
+    };
+    TickFrame frame;
+    frame.status = static_cast<GameStatus>(get(1));
+    frame.direction = static_cast<Direction>(get(1));
+    get(2);
+    frame.tick = static_cast<std::uint32_t>(get(4));
+    frame.tickTimeNs = get(8);
+    frame.head.first = static_cast<int>(get(2));
+    frame.head.second = static_cast<int>(get(2));
+    frame.reward.first = static_cast<int>(get(2));
+    frame.reward.second = static_cast<int>(get(2));
+    frame.length = static_cast<std::uint32_t>(get(4));
+    return frame;
+}
+
+#endif // SNAKEPROTOCOL_HPP
@@ -0,0 +1,74 @@
+#ifndef SNAKEREPLAY_HPP
+#define SNAKEREPLAY_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "SnakeState.hpp"
+
+// Replay files hold everything needed to reproduce a game deterministically:
+//
+//   header:  "SNKR" u8 version, u32 rows, u32 cols, u32 seed (little endian)
+//   records: varint((ticksSincePreviousRecord << 3) | kind)
+//            kind 0-3  a UserDirectionAction, the direction in the low bits
+//            kind 4    a checkpoint, followed by the u64 state hash
+//
+// Ticks are RequestNextFrameActions, so a record is usually a single byte.
+// The file always ends with a checkpoint covering the final tick. Records are
+// at most 2^20 ticks apart, as the recorder caps its checkpoint interval
+// there, and no tick follows the one that ends the game.
+
+std::uint64_t hashGameState(const GameState &state);
+
+class ReplayRecorder {
+public:
+    ReplayRecorder(const std::string &path, int rows, int cols, unsigned int seed,
+                   int checkpointInterval = 1000);
+    ~ReplayRecorder();
+
+    ReplayRecorder(const ReplayRecorder &) = delete;
+    ReplayRecorder &operator=(const ReplayRecorder &) = delete;
+
+    bool isOpen() const { return file_ != nullptr; }
+
+    // Call after each reduce with the action and the resulting state.
+    void record(const Action &action, const GameState &state);
+    // Writes the closing checkpoint and closes the file; later records are
+    // ignored. Returns false if the file could not be opened or any write
+    // failed, so the replay is missing or truncated.
+    bool finish(const GameState &state);
+
+private:
+    void writeRecord(unsigned int kind);
+    void writeVarint(std::uint64_t value);
+    void writeFixed(std::uint64_t value, int bytes);
+    void flush();
+
+    std::FILE *file_;
+    bool failed_;
+    std::vector<unsigned char> buffer_;
+    int checkpointInterval_;
+    std::uint64_t tick_ = 0;
+    std::uint64_t lastRecordTick_ = 0;
+};
+
+struct ReplayResult {
+    bool ok = false;
+    std::string error;
+    std::uint64_t ticks = 0;
+    std::uint64_t directionActions = 0;
+    std::uint64_t checkpoints = 0;
+    std::size_t bytes = 0;
+    GameState finalState;
+};
+
+// Memory-maps a replay file and runs it through the reducer without
+// rendering, verifying every checkpoint hash. Files with a board side outside
+// kMinBoardSide..kMaxBoardSide or records breaking the rules above fail with
+// an error instead.
+ReplayResult replayFile(const std::string &path);
+
+#endif // SNAKEREPLAY_HPP
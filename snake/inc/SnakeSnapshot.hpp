@@ -0,0 +1,79 @@
+#ifndef SNAKESNAPSHOT_HPP
+#define SNAKESNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "SnakeState.hpp"
+
+// Snapshot stream for spectators: one record per tick, a keyframe every
+// keyframeInterval ticks and a delta in between. Every record starts with
+//
+//   u8 flags   bit 0    keyframe
+//              bit 1    head advanced one cell in the current direction
+//              bit 2    tail cell dropped
+//              bit 3    reward moved (followed by varint cell index)
+//              bits 4-5 current direction
+//              bit 6    moveMade
+//              bit 7    game over
+//
+// A keyframe then holds varint rows, cols, reward index, length and head
+// index, and the body as the 2-bit direction from each segment to the next,
+// four per byte. A tick that only moves the snake is a single byte.
+//
+// The decoder rebuilds the observable state, the one hashGameState covers,
+// along with a valid free-cell index. The order of that index and the reward
+// RNG are not sent; spectators never place rewards.
+
+class SnapshotEncoder {
+public:
+    explicit SnapshotEncoder(int keyframeInterval = 256);
+
+    // Encodes the state after a tick. The returned bytes live in a buffer
+    // that is reused by the next call.
+    std::span<const unsigned char> encode(const GameState &state);
+    // Makes the next record a keyframe, e.g. when a spectator joins.
+    void forceKeyframe() { ticksSinceKeyframe_ = keyframeInterval_; }
+
+private:
+    bool encodeDelta(const GameState &state);
+    void encodeKeyframe(const GameState &state);
+    void remember(const GameState &state);
+
+    std::vector<unsigned char> buffer_;
+    int keyframeInterval_;
+    int ticksSinceKeyframe_;
+    int rows_ = 0;
+    int cols_ = 0;
+    std::pair<int, int> head_;
+    std::pair<int, int> tail_;
+    std::pair<int, int> reward_;
+    std::size_t length_ = 0;
+    GameStatus status_ = GameStatus::Running;
+};
+
+class SnapshotDecoder {
+public:
+    // Applies every record in `bytes`. Returns false on malformed input, such
+    // as an empty or self-crossing body or a board side outside
+    // kMinBoardSide..kMaxBoardSide, or on a delta before the first keyframe
+    // or one moving the head onto the body. The state is then unspecified
+    // until the next keyframe.
+    bool decode(std::span<const unsigned char> bytes);
+
+    bool hasState() const { return hasKeyframe_; }
+    const GameState &state() const { return state_; }
+
+private:
+    bool decodeKeyframe(unsigned char flags, const unsigned char *&cursor,
+                        const unsigned char *end);
+    bool applyDelta(unsigned char flags, std::pair<int, int> reward);
+
+    GameState state_ = {};
+    bool hasKeyframe_ = false;
+};
+
+#endif // SNAKESNAPSHOT_HPP
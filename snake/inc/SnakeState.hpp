@@ -1,6 +1,8 @@
 #ifndef SNAKESTATE_HPP
 #define SNAKESTATE_HPP
 
+#include <cstddef>
+#include <random>
 #include <utility>
 #include <vector>
 #include <variant>
@@ -9,13 +11,64 @@ const int SQUARE_SIZE_PIXELS = 15;
 
 enum class Direction { Up, Down, Left, Right };
 
+enum class GameStatus { Running, GameOver };
+
+// Ring buffer holding the snake body from the head (index 0) to the tail.
+// Moving the head and dropping the tail are O(1); capacity doubles when the
+// snake outgrows it.
+class SnakeBody {
+public:
+    using value_type = std::pair<int, int>;
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    const value_type &operator[](std::size_t i) const {
+        return cells_[(head_ + i) & mask()];
+    }
+    const value_type &front() const { return (*this)[0]; }
+    const value_type &back() const { return (*this)[size_ - 1]; }
+
+    void reserve(std::size_t capacity);
+    void clear() { head_ = size_ = 0; }
+    void push_front(const value_type &cell) {
+        if (size_ == cells_.size())
+            grow();
+        head_ = (head_ - 1) & mask();
+        cells_[head_] = cell;
+        ++size_;
+    }
+    void push_back(const value_type &cell) {
+        if (size_ == cells_.size())
+            grow();
+        ++size_;
+        cells_[(head_ + size_ - 1) & mask()] = cell;
+    }
+    void pop_back() { --size_; }
+
+private:
+    std::size_t mask() const { return cells_.size() - 1; }
+    void grow() { reserve(cells_.empty() ? 16 : cells_.size() * 2); }
+
+    std::vector<value_type> cells_;
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+};
+
 struct GameState {
     int rows;
     int cols;
-    std::vector<std::pair<int, int>> snake;
+    SnakeBody snake;
     std::pair<int, int> reward;
     Direction currentDirection;
     bool moveMade;
+    GameStatus status;
+    // Free-cell index: every cell not covered by the snake, plus the slot of
+    // each cell in that list (-1 while covered). Kept in sync as the head
+    // advances and the tail drops so rewards are placed in O(1), and doubles
+    // as the rows * cols occupancy map for collision checks.
+    std::vector<int> freeCells;
+    std::vector<int> freeSlot;
+    std::minstd_rand rng;
 };
 
 struct UserDirectionAction {
@@ -27,7 +80,24 @@ struct RequestNextFrameAction {};
 using Action = std::variant<UserDirectionAction, RequestNextFrameAction>;
 
 GameState reduce(const GameState &state, const Action &action);
-GameState initializeGameState(int rows, int cols);
+// Same transition as above, but reuses the buffers of a state the caller no
+// longer needs instead of copying it.
+GameState reduce(GameState &&state, const Action &action);
+void reduceInPlace(GameState &state, const Action &action);
+// Board sides that files read from disk or the network may claim: the
+// initial snake needs three cells in its row, and the upper bound keeps the
+// per-cell buffers of a corrupt header from exhausting memory.
+constexpr int kMinBoardSide = 3;
+constexpr int kMaxBoardSide = 4096;
+GameState initializeGameState(int rows, int cols,
+                              unsigned int seed = std::random_device{}());
 void placeReward(GameState &state);
+bool isSnakeCell(const GameState &state, const std::pair<int, int> &cell);
+// Keep the free-cell index in sync when a cell is covered or uncovered.
+void occupyCell(GameState &state, const std::pair<int, int> &cell);
+void releaseCell(GameState &state, const std::pair<int, int> &cell);
+// Cell reached by stepping once from `cell`, wrapping around the board edges.
+std::pair<int, int> neighborCell(const GameState &state,
+                                 std::pair<int, int> cell, Direction direction);
 
 #endif // SNAKESTATE_HPP
@@ -1,21 +1,112 @@
 #ifndef SNAKEWIDGET_HPP
 #define SNAKEWIDGET_HPP
 
+#include <QElapsedTimer>
 #include <QOpenGLWidget>
+#include <QPixmap>
+#include <QRectF>
+#include <QTimer>
+#include <array>
+#include <memory>
+#include <utility>
+#include "LatencyHistogram.hpp"
+#include "OffscreenBench.hpp"
+#include "Profiler.hpp"
+#include "SnakeAutopilot.hpp"
+#include "SnakeGLRenderer.hpp"
+#include "SnakeReplay.hpp"
 #include "SnakeState.hpp"
 
-class SnakeWidget : public QOpenGLWidget {
+class QPainter;
+
+class SnakeWidget : public QOpenGLWidget, public render::BenchScene {
 public:
   SnakeWidget(const GameState &initialState, QWidget *parent = nullptr);
+  ~SnakeWidget() override;
+
+  // Lets the autopilot steer instead of the keyboard. Finished games restart
+  // so the widget can run unattended.
+  void setAutopilot(std::unique_ptr<SnakeAutopilot> autopilot);
+  // Records every action of the current game for later replay. The recording
+  // ends when the game does.
+  void setRecorder(std::unique_ptr<ReplayRecorder> recorder);
+  // Incremental rendering (the default) keeps the previous frame and only
+  // repaints the cells that changed; disable it to redraw the whole board.
+  void setIncrementalRendering(bool enabled);
+  // Draws the board with SnakeGLRenderer instead of QPainter. Needs an OpenGL
+  // 3.3 core context; falls back to QPainter otherwise. Set before showing.
+  void setGLRendering(bool enabled);
+  // Logs paintGL CPU time, tick lateness and dropped ticks/frames every 300
+  // frames.
+  void setFrameStatsEnabled(bool enabled);
+  // Simulation step length, which must be positive; the default is 100 ms.
+  void setTickInterval(int milliseconds);
+  // With interpolation (the default) the widget repaints at display rate and
+  // slides the head and tail between cells; otherwise it repaints per tick.
+  void setInterpolation(bool enabled);
+
+  void benchInitialize(const QSize &size) override;
+  // Runs one tick per frame, without interpolation
+  void benchFrame(QPaintDevice &device) override;
 
 protected:
   void initializeGL() override;
+  void resizeGL(int w, int h) override;
   void paintGL() override;
   void keyPressEvent(QKeyEvent *event) override;
-  void timerEvent(QTimerEvent *event) override;
 
 private:
+  void advanceSimulation();
+  void tick();
+  void restartGame(unsigned int seed);
+  void scheduleNextTick();
+  void reportAutopilotGame();
+  void reportFrameStats();
+  void dispatch(const Action &action);
+  // Everything paintGL draws, on `device`: the widget itself unless
+  // benchmarking. `alpha` is the fraction of the tick to interpolate.
+  void drawFrame(QPaintDevice &device, double alpha);
+  QPixmap renderBackground() const;
+  void drawCell(QPainter &painter, const std::pair<int, int> &cell);
+  void drawBackground(QPainter &painter, const std::pair<int, int> &cell);
+  void drawHead(QPainter &painter, const QRectF &rect);
+  void drawInterpolated(QPainter &painter, double alpha);
+
+  // Ticks run back to back after a stall before the rest are dropped
+  static constexpr int kMaxCatchUpTicks = 5;
+
   GameState state_;
+  std::unique_ptr<SnakeAutopilot> autopilot_;
+  std::unique_ptr<ReplayRecorder> recorder_;
+  int autopilotGames_ = 0;
+  unsigned int benchGames_ = 0;
+
+  // Fixed-timestep simulation clock
+  QElapsedTimer clock_;
+  QTimer simulationTimer_;
+  qint64 tickIntervalNs_ = 100'000'000;
+  qint64 nextTickNs_ = 0;
+  bool interpolate_ = true;
+  std::pair<int, int> previousHead_;
+  std::pair<int, int> previousTail_;
+
+  // Static grid, rendered once and blitted behind the moving cells
+  QPixmap background_;
+  bool incrementalRendering_ = true;
+  bool needsFullRedraw_ = true;
+  int ticksSincePaint_ = 0;
+  std::array<std::pair<int, int>, 5> lastFrameCells_;
+
+  bool glRendering_ = false;
+  std::unique_ptr<SnakeGLRenderer> glRenderer_;
+
+  bool frameStats_ = false;
+  LatencyHistogram frameTimes_;
+  LatencyHistogram tickLateness_;
+  quint64 droppedTicks_ = 0;
+  quint64 droppedFrames_ = 0;
+  qint64 lastFrameNs_ = -1;
+  profiler::FrameStats profilerFrames_;
 };
 
 #endif // SNAKEWIDGET_HPP
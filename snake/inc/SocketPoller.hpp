@@ -0,0 +1,58 @@
+#ifndef SOCKETPOLLER_HPP
+#define SOCKETPOLLER_HPP
+
+#include <span>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+// Readiness notification for non-blocking sockets. Uses epoll on Linux, where
+// the server is expected to hold thousands of connections, and falls back to
+// poll() elsewhere.
+class SocketPoller {
+public:
+    struct Event {
+        int fd;
+        bool readable;
+        bool writable;
+        bool closed;
+    };
+
+    SocketPoller();
+    ~SocketPoller();
+
+    SocketPoller(const SocketPoller &) = delete;
+    SocketPoller &operator=(const SocketPoller &) = delete;
+
+    // Readability is always watched; writability only when asked for.
+    void add(int fd, bool writable = false);
+    void setWritable(int fd, bool writable);
+    void remove(int fd);
+
+    // Blocks for up to timeoutMs (-1 waits forever). The events stay valid
+    // until the next call.
+    std::span<const Event> wait(int timeoutMs);
+
+private:
+    std::vector<Event> events_;
+#ifdef __linux__
+    int epollFd_;
+    std::vector<epoll_event> ready_;
+#else
+    std::vector<pollfd> fds_;
+    std::vector<int> slots_; // fd -> index into fds_, or -1
+#endif
+};
+
+// Puts a socket into non-blocking mode and disables Nagle's algorithm for
+// TCP sockets. Returns false on failure.
+bool makeNonBlocking(int fd);
+
+// Raises the open file limit as far as the hard limit allows and returns it.
+long raiseFileLimit();
+
+#endif // SOCKETPOLLER_HPP
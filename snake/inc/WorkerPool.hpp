@@ -0,0 +1,44 @@
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops. The calling thread
+// takes part in every loop, so a pool of size 1 runs everything inline.
+class WorkerPool {
+public:
+    explicit WorkerPool(unsigned int threads = std::thread::hardware_concurrency());
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    unsigned int size() const { return threadCount_; }
+
+    // Splits [0, count) into one contiguous range per thread and blocks until
+    // every range has been processed.
+    void parallelFor(std::size_t count,
+                     const std::function<void(std::size_t, std::size_t)> &body);
+
+private:
+    void workerLoop(unsigned int index);
+
+    const unsigned int threadCount_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(std::size_t, std::size_t)> *job_ = nullptr;
+    std::size_t count_ = 0;
+    std::uint64_t generation_ = 0;
+    unsigned int pending_ = 0;
+    bool stopping_ = false;
+};
+
+#endif // WORKERPOOL_HPP
@@ -0,0 +1,194 @@
+#include "LatencyHistogram.hpp"
+#include "SnakeProtocol.hpp"
+#include "SocketPoller.hpp"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/in.h>
+#include <random>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+// Opens many connections to snake_server, steers each snake at random and
+// measures tick-to-client latency: the time from when a tick was due on the
+// server until its frame has been read by the client.
+
+namespace {
+
+struct Options {
+  int port = 7777;
+  int clients = 1000;
+  int seconds = 10;
+  // Each client turns on average once per this many frames
+  int turnEvery = 8;
+  unsigned int seed = 1;
+};
+
+struct Client {
+  int fd = -1;
+  std::array<unsigned char, kTickFrameSize> partial;
+  std::size_t partialSize = 0;
+  Direction direction = Direction::Right;
+};
+
+void printUsage(const char *program) {
+  std::printf("Usage: %s [--port N] [--clients N] [--seconds N] "
+              "[--turn-every N] [--seed N]\n",
+              program);
+}
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (std::strcmp(arg, "--port") == 0 && hasValue) {
+      options.port = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--clients") == 0 && hasValue) {
+      options.clients = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--seconds") == 0 && hasValue) {
+      options.seconds = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--turn-every") == 0 && hasValue) {
+      options.turnEvery = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--seed") == 0 && hasValue) {
+      options.seed = static_cast<unsigned int>(std::strtoul(argv[++i],
+                                                            nullptr, 10));
+    } else {
+      return false;
+    }
+  }
+  return options.clients > 0 && options.seconds > 0 && options.turnEvery > 0;
+}
+
+int connectClient(int port) {
+  const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(static_cast<std::uint16_t>(port));
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&address),
+                sizeof(address)) != 0 ||
+      !makeNonBlocking(fd)) {
+    ::close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+Direction perpendicularTurn(Direction direction, unsigned int roll) {
+  const bool vertical =
+      direction == Direction::Up || direction == Direction::Down;
+  if (vertical)
+    return roll % 2 ? Direction::Left : Direction::Right;
+  return roll % 2 ? Direction::Up : Direction::Down;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  std::signal(SIGPIPE, SIG_IGN);
+  raiseFileLimit();
+
+  SocketPoller poller;
+  std::vector<Client> clients;
+  std::vector<int> clientForFd;
+  for (int i = 0; i < options.clients; ++i) {
+    const int fd = connectClient(options.port);
+    if (fd < 0) {
+      std::fprintf(stderr, "connected %d of %d clients: %s\n", i,
+                   options.clients, std::strerror(errno));
+      break;
+    }
+    if (fd >= static_cast<int>(clientForFd.size()))
+      clientForFd.resize(fd + 1, -1);
+    clientForFd[fd] = static_cast<int>(clients.size());
+    Client client;
+    client.fd = fd;
+    clients.push_back(client);
+    poller.add(fd);
+  }
+  if (clients.empty())
+    return 1;
+
+  std::minstd_rand rng(options.seed);
+  LatencyHistogram latency;
+  long long frames = 0;
+  long long gameOvers = 0;
+  long long turns = 0;
+  int connected = static_cast<int>(clients.size());
+  const std::uint64_t start = steadyNanoseconds();
+  const std::uint64_t end =
+      start + std::uint64_t(options.seconds) * 1'000'000'000;
+
+  unsigned char buffer[64 * kTickFrameSize];
+  while (connected > 0 && steadyNanoseconds() < end) {
+    for (const auto &event : poller.wait(100)) {
+      const int index = event.fd < static_cast<int>(clientForFd.size())
+                            ? clientForFd[event.fd]
+                            : -1;
+      if (index < 0)
+        continue;
+      Client &client = clients[index];
+      for (;;) {
+        const ssize_t received = ::read(client.fd, buffer, sizeof(buffer));
+        if (received <= 0) {
+          if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            break;
+          if (received < 0 && errno == EINTR)
+            continue;
+          poller.remove(client.fd);
+          ::close(client.fd);
+          clientForFd[client.fd] = -1;
+          --connected;
+          break;
+        }
+        const std::uint64_t now = steadyNanoseconds();
+        for (ssize_t i = 0; i < received; ++i) {
+          client.partial[client.partialSize++] = buffer[i];
+          if (client.partialSize < kTickFrameSize)
+            continue;
+          client.partialSize = 0;
+          const TickFrame frame = decodeTickFrame(client.partial.data());
+          latency.record(now - frame.tickTimeNs);
+          ++frames;
+          if (frame.status == GameStatus::GameOver)
+            ++gameOvers;
+          client.direction = frame.direction;
+        }
+        if (rng() % options.turnEvery == 0) {
+          const auto turn = static_cast<unsigned char>(
+              perpendicularTurn(client.direction, rng()));
+          if (::write(client.fd, &turn, 1) == 1)
+            ++turns;
+        }
+      }
+    }
+  }
+
+  const double seconds = (steadyNanoseconds() - start) / 1e9;
+  std::printf("clients:      %d connected of %d requested\n", connected,
+              options.clients);
+  std::printf("frames:       %lld (%.0f/s)\n", frames, frames / seconds);
+  std::printf("turns sent:   %lld\n", turns);
+  std::printf("game overs:   %lld\n", gameOvers);
+  std::printf("tick-to-client latency (us): mean %.1f  p50 %.1f  p90 %.1f  "
+              "p99 %.1f  max %.1f\n",
+              latency.mean() / 1e3, latency.percentile(0.50) / 1e3,
+              latency.percentile(0.90) / 1e3, latency.percentile(0.99) / 1e3,
+              latency.max() / 1e3);
+  for (const auto &client : clients)
+    if (clientForFd[client.fd] >= 0)
+      ::close(client.fd);
+  return 0;
+}
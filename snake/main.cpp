@@ -1,17 +1,99 @@
+#include "OffscreenBench.hpp"
+#include "Profiler.hpp"
 #include "SnakeState.hpp"
 #include "SnakeWidget.hpp"
 #include <QApplication>
 #include <QMainWindow>
+#include <QStringList>
+#include <QSurfaceFormat>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+
+namespace {
+
+// Value following `name` on the command line, or `fallback` if absent
+int intArgument(const QStringList &arguments, const QString &name,
+                int fallback) {
+  const qsizetype index = arguments.indexOf(name);
+  if (index < 0 || index + 1 >= arguments.size())
+    return fallback;
+  bool ok = false;
+  const int value = arguments[index + 1].toInt(&ok);
+  return ok ? value : fallback;
+}
+
+} // namespace
 
 int main(int argc, char *argv[]) {
+  profiler::initFromEnvironment();
+
+  // The GL renderer needs a 3.3 core context, which has to be requested
+  // before the application object exists
+  const bool glRendering =
+      std::any_of(argv + 1, argv + argc, [](const char *arg) {
+        return std::strcmp(arg, "--gl") == 0;
+      });
+  if (glRendering) {
+    QSurfaceFormat format;
+    format.setVersion(3, 3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    QSurfaceFormat::setDefaultFormat(format);
+  }
+
   QApplication app(argc, argv);
 
-  constexpr int rows = 25; // Example number of rows
-  constexpr int cols = 25; // Example number of columns
+  const QStringList arguments = app.arguments();
+  const int rows = intArgument(arguments, "--rows", 25);
+  const int cols = intArgument(arguments, "--cols", 25);
+  const int tickMs = intArgument(arguments, "--tick-ms", 100);
+  if (tickMs <= 0) {
+    std::fprintf(stderr, "--tick-ms must be a positive number of "
+                         "milliseconds\n");
+    return 1;
+  }
+
+  // --bench N renders N ticks offscreen as fast as possible, from a fixed
+  // seed. The bench goes first so that its context outlives the widget's GL
+  // resources.
+  const int benchFrameCount = render::benchFrames(argc, argv);
+  std::optional<render::OffscreenBench> bench;
+  if (benchFrameCount > 0)
+    bench.emplace(QSize(cols * SQUARE_SIZE_PIXELS, rows * SQUARE_SIZE_PIXELS));
+
+  const unsigned int seed = bench ? 0 : std::random_device{}();
+  const GameState initialState = initializeGameState(rows, cols, seed);
 
-  const GameState initialState = initializeGameState(rows, cols);
+  std::unique_ptr<ReplayRecorder> recorder;
+  const qsizetype recordIndex = arguments.indexOf("--record");
+  if (!bench && recordIndex >= 0 && recordIndex + 1 < arguments.size()) {
+    const std::string path = arguments[recordIndex + 1].toStdString();
+    recorder = std::make_unique<ReplayRecorder>(path, rows, cols, seed);
+    if (!recorder->isOpen()) {
+      std::fprintf(stderr, "cannot open %s for the replay\n", path.c_str());
+      return 1;
+    }
+  }
 
   auto *widget = new SnakeWidget(initialState);
+  widget->setIncrementalRendering(!arguments.contains("--full-redraw"));
+  widget->setFrameStatsEnabled(arguments.contains("--frame-stats"));
+  widget->setGLRendering(glRendering);
+  widget->setTickInterval(tickMs);
+  widget->setInterpolation(!arguments.contains("--no-interpolate"));
+  if (arguments.contains("--autopilot"))
+    widget->setAutopilot(std::make_unique<SnakeAutopilot>(rows, cols));
+  if (bench) {
+    const std::unique_ptr<SnakeWidget> scene(widget);
+    return bench->run(*scene, benchFrameCount);
+  }
+  if (recorder)
+    widget->setRecorder(std::move(recorder));
   widget->resize(
       cols * SQUARE_SIZE_PIXELS,
       rows * SQUARE_SIZE_PIXELS); // Set the widget size based on grid size
@@ -0,0 +1,389 @@
+#include "LatencyHistogram.hpp"
+#include "Profiler.hpp"
+#include "SnakeProtocol.hpp"
+#include "SnakeState.hpp"
+#include "SocketPoller.hpp"
+#include "WorkerPool.hpp"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <netinet/in.h>
+#include <random>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Hosts many snake games in one process. Each TCP connection on localhost
+// gets its own game; all games advance together on one tick scheduler and
+// every client receives a TickFrame after each tick (see SnakeProtocol.hpp).
+
+namespace {
+
+struct Options {
+  int port = 7777;
+  int rows = 25;
+  int cols = 25;
+  int tickMs = 100;
+  int maxSessions = 10000;
+  unsigned int threads = std::thread::hardware_concurrency();
+  unsigned int seed = 1;
+};
+
+// Frames a client may fall behind by before it is disconnected. Together
+// with the board size this bounds the memory held per session.
+constexpr std::size_t kMaxPendingFrames = 64;
+constexpr int kMaxCatchUpTicks = 5;
+constexpr int kStatsIntervalTicks = 50;
+
+enum class FlushResult { Drained, Blocked, Failed };
+
+struct Session {
+  int fd = -1;
+  GameState state;
+  std::uint32_t tick = 0;
+  std::array<unsigned char, kMaxPendingFrames * kTickFrameSize> output;
+  std::size_t outputBegin = 0;
+  std::size_t outputEnd = 0;
+  bool waitingForWritable = false;
+  // Set by the tick workers, acted on by the event loop thread
+  FlushResult tickResult = FlushResult::Drained;
+  bool fellBehind = false;
+};
+
+void printUsage(const char *program) {
+  std::printf("Usage: %s [--port N] [--rows N] [--cols N] [--tick-ms N] "
+              "[--max-sessions N] [--threads N] [--seed N]\n",
+              program);
+}
+
+bool parseOptions(int argc, char *argv[], Options &options) {
+  for (int i = 1; i < argc; ++i) {
+    const char *arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (std::strcmp(arg, "--port") == 0 && hasValue) {
+      options.port = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--rows") == 0 && hasValue) {
+      options.rows = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--cols") == 0 && hasValue) {
+      options.cols = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--tick-ms") == 0 && hasValue) {
+      options.tickMs = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--max-sessions") == 0 && hasValue) {
+      options.maxSessions = std::atoi(argv[++i]);
+    } else if (std::strcmp(arg, "--threads") == 0 && hasValue) {
+      options.threads = static_cast<unsigned int>(std::atoi(argv[++i]));
+    } else if (std::strcmp(arg, "--seed") == 0 && hasValue) {
+      options.seed = static_cast<unsigned int>(std::strtoul(argv[++i],
+                                                            nullptr, 10));
+    } else {
+      return false;
+    }
+  }
+  // Every session allocates two ints per cell for its free-cell index, so the
+  // sides are capped to keep that bounded; frames carry them as u16 anyway
+  return options.rows >= kMinBoardSide && options.rows <= kMaxBoardSide &&
+         options.cols >= kMinBoardSide && options.cols <= kMaxBoardSide &&
+         options.tickMs > 0 &&
+         options.maxSessions > 0 && options.threads > 0;
+}
+
+class SnakeServer {
+public:
+  explicit SnakeServer(const Options &options)
+      : options_(options), seeds_(options.seed), pool_(options.threads),
+        tickIntervalNs_(std::int64_t(options.tickMs) * 1'000'000) {}
+
+  ~SnakeServer() {
+    for (auto &session : sessions_)
+      if (session)
+        ::close(session->fd);
+    if (listenFd_ >= 0)
+      ::close(listenFd_);
+  }
+
+  bool listen() {
+    listenFd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd_ < 0)
+      return false;
+    const int reuse = 1;
+    ::setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<std::uint16_t>(options_.port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::bind(listenFd_, reinterpret_cast<sockaddr *>(&address),
+               sizeof(address)) != 0 ||
+        ::listen(listenFd_, SOMAXCONN) != 0 || !makeNonBlocking(listenFd_))
+      return false;
+    poller_.add(listenFd_);
+    return true;
+  }
+
+  void run() {
+    nextTickNs_ = steadyNanoseconds() + tickIntervalNs_;
+    for (;;) {
+      const auto now = static_cast<std::int64_t>(steadyNanoseconds());
+      const std::int64_t untilTick = nextTickNs_ - now;
+      const int timeoutMs =
+          untilTick > 0 ? static_cast<int>((untilTick + 999'999) / 1'000'000)
+                        : 0;
+      for (const auto &event : poller_.wait(timeoutMs))
+        handleEvent(event);
+      advanceTicks();
+    }
+  }
+
+private:
+  void handleEvent(const SocketPoller::Event &event) {
+    if (event.fd == listenFd_) {
+      acceptClients();
+      return;
+    }
+    Session *session = sessionFor(event.fd);
+    if (!session)
+      return;
+    if (event.readable && !readInput(*session))
+      return;
+    if (event.closed) {
+      closeSession(*session);
+      return;
+    }
+    if (event.writable)
+      applyFlushResult(*session, writeOutput(*session));
+  }
+
+  void acceptClients() {
+    for (;;) {
+      const int fd = ::accept(listenFd_, nullptr, nullptr);
+      if (fd < 0)
+        return;
+      if (sessionCount_ >= options_.maxSessions || !makeNonBlocking(fd)) {
+        ::close(fd);
+        ++rejected_;
+        continue;
+      }
+      if (fd >= static_cast<int>(sessions_.size()))
+        sessions_.resize(fd + 1);
+      auto session = std::make_unique<Session>();
+      session->fd = fd;
+      session->state = initializeGameState(options_.rows, options_.cols,
+                                           seeds_());
+      sessions_[fd] = std::move(session);
+      poller_.add(fd);
+      ++sessionCount_;
+    }
+  }
+
+  // Returns false if the session was closed.
+  bool readInput(Session &session) {
+    unsigned char input[256];
+    for (;;) {
+      const ssize_t received = ::read(session.fd, input, sizeof(input));
+      if (received > 0) {
+        for (ssize_t i = 0; i < received; ++i)
+          if (input[i] < 4)
+            reduceInPlace(session.state, UserDirectionAction{
+                                             static_cast<Direction>(input[i])});
+        continue;
+      }
+      if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return true;
+      if (received < 0 && errno == EINTR)
+        continue;
+      closeSession(session);
+      return false;
+    }
+  }
+
+  void advanceTicks() {
+    const auto now = static_cast<std::int64_t>(steadyNanoseconds());
+    int ticks = 0;
+    while (now >= nextTickNs_) {
+      if (ticks == kMaxCatchUpTicks) {
+        const std::int64_t missed = (now - nextTickNs_) / tickIntervalNs_ + 1;
+        droppedTicks_ += missed;
+        nextTickNs_ += missed * tickIntervalNs_;
+        break;
+      }
+      tick(nextTickNs_);
+      nextTickNs_ += tickIntervalNs_;
+      ++ticks;
+    }
+  }
+
+  // Sessions are advanced and written to in parallel; anything that touches
+  // the poller or the session table happens afterwards on this thread.
+  void tick(std::int64_t dueNs) {
+    PROFILE_SCOPE("SnakeServer::tick");
+    const std::uint64_t start = steadyNanoseconds();
+    pool_.parallelFor(sessions_.size(), [&](std::size_t begin,
+                                            std::size_t end) {
+      for (std::size_t fd = begin; fd < end; ++fd)
+        if (sessions_[fd])
+          advanceSession(*sessions_[fd], dueNs);
+    });
+    for (auto &slot : sessions_) {
+      if (!slot)
+        continue;
+      if (slot->fellBehind) {
+        ++slowClients_;
+        closeSession(*slot);
+      } else {
+        applyFlushResult(*slot, slot->tickResult);
+      }
+    }
+    tickTimes_.record(steadyNanoseconds() - start);
+    if (++ticksSinceReport_ == kStatsIntervalTicks)
+      reportStats();
+  }
+
+  void advanceSession(Session &session, std::int64_t dueNs) {
+    reduceInPlace(session.state, RequestNextFrameAction{});
+    ++session.tick;
+
+    TickFrame frame;
+    frame.status = session.state.status;
+    frame.direction = session.state.currentDirection;
+    frame.tick = session.tick;
+    frame.tickTimeNs = static_cast<std::uint64_t>(dueNs);
+    frame.head = session.state.snake.front();
+    frame.reward = session.state.reward;
+    frame.length = static_cast<std::uint32_t>(session.state.snake.size());
+    if (!queueFrame(session, frame)) {
+      session.fellBehind = true;
+      return;
+    }
+    if (session.state.status == GameStatus::GameOver)
+      session.state = initializeGameState(options_.rows, options_.cols,
+                                          session.state.rng());
+    session.tickResult = session.waitingForWritable ? FlushResult::Blocked
+                                                    : writeOutput(session);
+  }
+
+  bool queueFrame(Session &session, const TickFrame &frame) {
+    if (session.outputEnd + kTickFrameSize > session.output.size()) {
+      if (session.outputBegin == 0)
+        return false;
+      std::memmove(session.output.data(),
+                   session.output.data() + session.outputBegin,
+                   session.outputEnd - session.outputBegin);
+      session.outputEnd -= session.outputBegin;
+      session.outputBegin = 0;
+    }
+    encodeTickFrame(frame, session.output.data() + session.outputEnd);
+    session.outputEnd += kTickFrameSize;
+    return true;
+  }
+
+  // Writes as much queued output as the socket accepts. Only touches the
+  // session itself, so it is safe to call from the tick workers.
+  FlushResult writeOutput(Session &session) {
+    while (session.outputBegin < session.outputEnd) {
+      const ssize_t sent =
+          ::write(session.fd, session.output.data() + session.outputBegin,
+                  session.outputEnd - session.outputBegin);
+      if (sent > 0) {
+        session.outputBegin += static_cast<std::size_t>(sent);
+        continue;
+      }
+      if (sent < 0 && errno == EINTR)
+        continue;
+      if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        return FlushResult::Blocked;
+      return FlushResult::Failed;
+    }
+    session.outputBegin = session.outputEnd = 0;
+    return FlushResult::Drained;
+  }
+
+  void applyFlushResult(Session &session, FlushResult result) {
+    if (result == FlushResult::Failed) {
+      closeSession(session);
+      return;
+    }
+    const bool blocked = result == FlushResult::Blocked;
+    if (blocked != session.waitingForWritable)
+      poller_.setWritable(session.fd, blocked);
+    session.waitingForWritable = blocked;
+  }
+
+  Session *sessionFor(int fd) {
+    return fd >= 0 && fd < static_cast<int>(sessions_.size())
+               ? sessions_[fd].get()
+               : nullptr;
+  }
+
+  void closeSession(Session &session) {
+    const int fd = session.fd;
+    poller_.remove(fd);
+    ::close(fd);
+    sessions_[fd].reset();
+    --sessionCount_;
+  }
+
+  void reportStats() {
+    std::printf("sessions %d  tick p50 %.2f ms  p99 %.2f ms  max %.2f ms  "
+                "dropped ticks %lld  slow clients %lld  rejected %lld\n",
+                sessionCount_, tickTimes_.percentile(0.50) / 1e6,
+                tickTimes_.percentile(0.99) / 1e6, tickTimes_.max() / 1e6,
+                droppedTicks_, slowClients_, rejected_);
+    std::fflush(stdout);
+    tickTimes_.reset();
+    ticksSinceReport_ = 0;
+  }
+
+  Options options_;
+  std::minstd_rand seeds_;
+  WorkerPool pool_;
+  SocketPoller poller_;
+  int listenFd_ = -1;
+  // Indexed by file descriptor
+  std::vector<std::unique_ptr<Session>> sessions_;
+  int sessionCount_ = 0;
+
+  std::int64_t tickIntervalNs_;
+  std::int64_t nextTickNs_ = 0;
+  LatencyHistogram tickTimes_;
+  int ticksSinceReport_ = 0;
+  long long droppedTicks_ = 0;
+  long long slowClients_ = 0;
+  long long rejected_ = 0;
+};
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  profiler::initFromEnvironment();
+  Options options;
+  if (!parseOptions(argc, argv, options)) {
+    printUsage(argv[0]);
+    return 1;
+  }
+  // Disconnected clients are detected from write errors instead
+  std::signal(SIGPIPE, SIG_IGN);
+  const long fileLimit = raiseFileLimit();
+  if (fileLimit >= 0 && fileLimit < options.maxSessions + 16)
+    std::fprintf(stderr, "warning: open file limit %ld is below "
+                         "--max-sessions %d\n",
+                 fileLimit, options.maxSessions);
+
+  SnakeServer server(options);
+  if (!server.listen()) {
+    std::fprintf(stderr, "cannot listen on 127.0.0.1:%d: %s\n", options.port,
+                 std::strerror(errno));
+    return 1;
+  }
+  std::printf("snake_server listening on 127.0.0.1:%d, %dx%d board, tick "
+              "%d ms, %u threads\n",
+              options.port, options.rows, options.cols, options.tickMs,
+              options.threads);
+  std::fflush(stdout);
+  server.run();
+  return 0;
+}
@@ -0,0 +1,252 @@
+#include "SnakeAutopilot.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+
+#include "Profiler.hpp"
+
+namespace {
+
+constexpr std::array<Direction, 4> kDirections = {
+    Direction::Up, Direction::Down, Direction::Left, Direction::Right};
+
+bool isReversal(Direction current, Direction requested) {
+  return (requested == Direction::Up && current == Direction::Down) ||
+         (requested == Direction::Down && current == Direction::Up) ||
+         (requested == Direction::Left && current == Direction::Right) ||
+         (requested == Direction::Right && current == Direction::Left);
+}
+
+// Shortest distance along one wrapping axis
+int wrappedDistance(int a, int b, int size) {
+  const int d = std::abs(a - b);
+  return std::min(d, size - d);
+}
+
+} // namespace
+
+SnakeAutopilot::SnakeAutopilot(int rows, int cols,
+                               std::chrono::microseconds budget)
+    : rows_(rows), cols_(cols), budget_(budget), visitStamp_(rows * cols),
+      cost_(rows * cols), firstMove_(rows * cols), open_(rows * cols),
+      deferred_(rows * cols) {
+  buildCycle();
+}
+
+UserDirectionAction SnakeAutopilot::decide(const GameState &state) {
+  PROFILE_SCOPE("SnakeAutopilot::decide");
+  const auto start = std::chrono::steady_clock::now();
+
+  Direction direction = state.currentDirection;
+  switch (searchPath(state, start, direction)) {
+  case SearchResult::Found:
+    lastStrategy_ = Strategy::Path;
+    break;
+  case SearchResult::OverBudget:
+    lastStrategy_ = Strategy::OverBudget;
+    greedyDirection(state, direction);
+    break;
+  case SearchResult::Unreachable:
+    if (cycleDirection(state, direction)) {
+      lastStrategy_ = Strategy::Cycle;
+    } else {
+      lastStrategy_ = Strategy::Greedy;
+      greedyDirection(state, direction);
+    }
+    break;
+  }
+
+  ++decisions_[static_cast<int>(lastStrategy_)];
+  latencies_.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start)
+                        .count());
+  return UserDirectionAction{direction};
+}
+
+// A* towards the reward with the wrapped Manhattan distance as heuristic.
+// Every step costs 1 and changes the heuristic by exactly 1, so a node's f is
+// either its parent's f or f + 2: the open list is just two buckets. The
+// current bucket is expanded last-in first-out, which prefers deeper nodes
+// among equal f and walks straight at the reward on open boards. A cell first
+// reached through the f + 2 bucket can still turn up 2 steps closer to the
+// head, so cells stay open, and are pushed again on a shorter path, until
+// they are expanded.
+//
+// On a board with an odd side, a step across the antipode of the reward can
+// leave the heuristic unchanged, and the two buckets no longer order nodes by
+// f. There the search falls back to a breadth-first search over open_, which
+// is exact for unit steps.
+SnakeAutopilot::SearchResult
+SnakeAutopilot::searchPath(const GameState &state,
+                           std::chrono::steady_clock::time_point start,
+                           Direction &direction) {
+  // A cell is open while its stamp is stamp_, and closed, its cost final,
+  // at stamp_ + 1
+  if (stamp_ > std::numeric_limits<std::uint32_t>::max() - 3) {
+    std::fill(visitStamp_.begin(), visitStamp_.end(), 0);
+    stamp_ = 0;
+  }
+  stamp_ += 2;
+  const std::uint32_t closed = stamp_ + 1;
+
+  const auto head = state.snake.front();
+  const auto reward = state.reward;
+  const auto heuristic = [&](const std::pair<int, int> &cell) {
+    return wrappedDistance(cell.first, reward.first, rows_) +
+           wrappedDistance(cell.second, reward.second, cols_);
+  };
+  visitStamp_[head.first * cols_ + head.second] = closed;
+
+  const bool breadthFirst = rows_ % 2 != 0 || cols_ % 2 != 0;
+  int openBegin = 0;
+  int openSize = 0;
+  int deferredSize = 0;
+  const auto push = [&](int cell, bool closer) {
+    if (breadthFirst || closer)
+      open_[openSize++] = cell;
+    else
+      deferred_[deferredSize++] = cell;
+  };
+
+  // Seed the search with the safe first moves; every cell reached later
+  // remembers which of them it came through.
+  const int headDistance = heuristic(head);
+  for (const Direction move : kDirections) {
+    if (isReversal(state.currentDirection, move))
+      continue;
+    const auto next = neighborCell(state, head, move);
+    const int cell = next.first * cols_ + next.second;
+    if (visitStamp_[cell] == closed || isSnakeCell(state, next))
+      continue;
+    if (next == reward) {
+      direction = move;
+      return SearchResult::Found;
+    }
+    visitStamp_[cell] = stamp_;
+    cost_[cell] = 1;
+    firstMove_[cell] = move;
+    push(cell, heuristic(next) < headDistance);
+  }
+
+  int expanded = 0;
+  while (openSize > openBegin || deferredSize > 0) {
+    if (openSize == 0) {
+      std::swap(open_, deferred_);
+      std::swap(openSize, deferredSize);
+    }
+    if (++expanded % 256 == 0 &&
+        std::chrono::steady_clock::now() - start > budget_)
+      return SearchResult::OverBudget;
+
+    const int cell = breadthFirst ? open_[openBegin++] : open_[--openSize];
+    // A cell pushed again on a shorter path leaves its first entry behind
+    if (visitStamp_[cell] == closed)
+      continue;
+    visitStamp_[cell] = closed;
+    const std::pair<int, int> current = {cell / cols_, cell % cols_};
+    const int currentDistance = heuristic(current);
+    const int nextCost = cost_[cell] + 1;
+    for (const Direction move : kDirections) {
+      const auto next = neighborCell(state, current, move);
+      const int nextCell = next.first * cols_ + next.second;
+      if (visitStamp_[nextCell] == closed || isSnakeCell(state, next))
+        continue;
+      if (next == reward) {
+        direction = firstMove_[cell];
+        return SearchResult::Found;
+      }
+      if (visitStamp_[nextCell] == stamp_ && cost_[nextCell] <= nextCost)
+        continue;
+      visitStamp_[nextCell] = stamp_;
+      cost_[nextCell] = nextCost;
+      firstMove_[nextCell] = firstMove_[cell];
+      push(nextCell, heuristic(next) < currentDistance);
+    }
+  }
+  return SearchResult::Unreachable;
+}
+
+bool SnakeAutopilot::cycleDirection(const GameState &state,
+                                    Direction &direction) const {
+  if (cycle_.empty())
+    return false;
+  const auto head = state.snake.front();
+  const Direction move = cycle_[head.first * cols_ + head.second];
+  if (isReversal(state.currentDirection, move) ||
+      isSnakeCell(state, neighborCell(state, head, move)))
+    return false;
+  direction = move;
+  return true;
+}
+
+bool SnakeAutopilot::greedyDirection(const GameState &state,
+                                     Direction &direction) const {
+  const auto head = state.snake.front();
+  int bestDistance = -1;
+  for (const Direction move : kDirections) {
+    if (isReversal(state.currentDirection, move))
+      continue;
+    const auto next = neighborCell(state, head, move);
+    if (isSnakeCell(state, next))
+      continue;
+    const int distance =
+        wrappedDistance(next.first, state.reward.first, rows_) +
+        wrappedDistance(next.second, state.reward.second, cols_);
+    if (bestDistance < 0 || distance < bestDistance ||
+        (distance == bestDistance && move == state.currentDirection)) {
+      bestDistance = distance;
+      direction = move;
+    }
+  }
+  return bestDistance >= 0;
+}
+
+// Serpentine cycle: sweep the rows back and forth over columns 1..n-1 and
+// return up column 0. It needs an even number of rows, so boards with an odd
+// row count and an even column count use the transposed sweep.
+void SnakeAutopilot::buildCycle() {
+  const bool transpose = rows_ % 2 != 0;
+  const int rows = transpose ? cols_ : rows_;
+  const int cols = transpose ? rows_ : cols_;
+  if (rows % 2 != 0 || cols < 2)
+    return;
+
+  cycle_.resize(rows_ * cols_);
+  for (int r = 0; r < rows; ++r) {
+    for (int c = 0; c < cols; ++c) {
+      Direction move;
+      if (c == 0)
+        move = r == 0 ? Direction::Right : Direction::Up;
+      else if (r % 2 == 0)
+        move = c < cols - 1 ? Direction::Right : Direction::Down;
+      else if (c > 1 || r == rows - 1)
+        move = Direction::Left;
+      else
+        move = Direction::Down;
+
+      if (transpose) {
+        // Swap the axes back: rows become columns and vice versa
+        switch (move) {
+        case Direction::Up:
+          move = Direction::Left;
+          break;
+        case Direction::Down:
+          move = Direction::Right;
+          break;
+        case Direction::Left:
+          move = Direction::Up;
+          break;
+        case Direction::Right:
+          move = Direction::Down;
+          break;
+        }
+        cycle_[c * cols_ + r] = move;
+      } else {
+        cycle_[r * cols_ + c] = move;
+      }
+    }
+  }
+}
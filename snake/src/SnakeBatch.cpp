@@ -0,0 +1,179 @@
+#include "SnakeBatch.hpp"
+
+#include <algorithm>
+#include <utility>
+#include <variant>
+
+#include "Profiler.hpp"
+
+namespace {
+
+bool isReversal(Direction current, Direction requested) {
+  return (requested == Direction::Up && current == Direction::Down) ||
+         (requested == Direction::Down && current == Direction::Up) ||
+         (requested == Direction::Left && current == Direction::Right) ||
+         (requested == Direction::Right && current == Direction::Left);
+}
+
+} // namespace
+
+SnakeBatch::SnakeBatch(int rows, int cols, std::span<const unsigned int> seeds)
+    : rows_(rows), cols_(cols), cells_(rows * cols) {
+  // Body slices are a power of two long so ring indices wrap with a mask
+  int bodyCapacity = 1;
+  while (bodyCapacity < cells_)
+    bodyCapacity *= 2;
+  bodyMask_ = bodyCapacity - 1;
+
+  const std::size_t games = seeds.size();
+  heads_.resize(games);
+  directions_.resize(games);
+  movesMade_.resize(games);
+  statuses_.resize(games);
+  rewards_.resize(games);
+  rngs_.resize(games);
+  bodyStarts_.resize(games);
+  bodyLengths_.resize(games);
+  bodies_.resize(games * bodyCapacity);
+  freeCounts_.resize(games);
+  freeCells_.resize(games * cells_);
+  freeSlots_.resize(games * cells_);
+
+  for (std::size_t game = 0; game < games; ++game)
+    resetGame(game, seeds[game]);
+}
+
+void SnakeBatch::step(std::span<const Action> actions, WorkerPool &pool) {
+  pool.parallelFor(size(), [&](std::size_t begin, std::size_t end) {
+    PROFILE_SCOPE("SnakeBatch::step");
+    for (std::size_t game = begin; game < end; ++game)
+      stepGame(game, actions[game]);
+  });
+}
+
+void SnakeBatch::resetGame(std::size_t game, unsigned int seed) {
+  loadGame(game, initializeGameState(rows_, cols_, seed));
+}
+
+GameState SnakeBatch::gameState(std::size_t game) const {
+  const int *body = &bodies_[game * (bodyMask_ + 1)];
+  const int *freeCells = &freeCells_[game * cells_];
+  const int *freeSlots = &freeSlots_[game * cells_];
+
+  GameState state = {rows_,
+                     cols_,
+                     {},
+                     {rewards_[game] / cols_, rewards_[game] % cols_},
+                     directions_[game],
+                     movesMade_[game] != 0,
+                     statuses_[game],
+                     {freeCells, freeCells + freeCounts_[game]},
+                     {freeSlots, freeSlots + cells_},
+                     rngs_[game]};
+  for (int i = 0; i < bodyLengths_[game]; ++i) {
+    const int cell = body[(bodyStarts_[game] + i) & bodyMask_];
+    state.snake.push_back({cell / cols_, cell % cols_});
+  }
+  return state;
+}
+
+void SnakeBatch::loadGame(std::size_t game, const GameState &state) {
+  int *body = &bodies_[game * (bodyMask_ + 1)];
+  for (std::size_t i = 0; i < state.snake.size(); ++i)
+    body[i] = state.snake[i].first * cols_ + state.snake[i].second;
+  bodyStarts_[game] = 0;
+  bodyLengths_[game] = static_cast<int>(state.snake.size());
+  heads_[game] = body[0];
+
+  directions_[game] = state.currentDirection;
+  movesMade_[game] = state.moveMade;
+  statuses_[game] = state.status;
+  rewards_[game] = state.reward.first * cols_ + state.reward.second;
+  rngs_[game] = state.rng;
+
+  freeCounts_[game] = static_cast<int>(state.freeCells.size());
+  std::copy(state.freeCells.begin(), state.freeCells.end(),
+            freeCells_.begin() + game * cells_);
+  std::copy(state.freeSlot.begin(), state.freeSlot.end(),
+            freeSlots_.begin() + game * cells_);
+}
+
+void SnakeBatch::stepGame(std::size_t game, const Action &action) {
+  if (const auto *turn = std::get_if<UserDirectionAction>(&action)) {
+    if (!movesMade_[game] && !isReversal(directions_[game], turn->direction)) {
+      directions_[game] = turn->direction;
+      movesMade_[game] = 1;
+    }
+  } else {
+    advance(game);
+  }
+}
+
+// Mirrors the RequestNextFrameAction branch of the scalar reducer, including
+// the order of free-list swaps and generator draws.
+void SnakeBatch::advance(std::size_t game) {
+  if (statuses_[game] == GameStatus::GameOver)
+    return;
+
+  int row = heads_[game] / cols_;
+  int col = heads_[game] % cols_;
+  switch (directions_[game]) {
+  case Direction::Up:
+    row = (row - 1 + rows_) % rows_;
+    break;
+  case Direction::Down:
+    row = (row + 1) % rows_;
+    break;
+  case Direction::Left:
+    col = (col - 1 + cols_) % cols_;
+    break;
+  case Direction::Right:
+    col = (col + 1) % cols_;
+    break;
+  }
+  const int head = row * cols_ + col;
+
+  // Check for self-intersection
+  if (freeSlots_[game * cells_ + head] < 0) {
+    statuses_[game] = GameStatus::GameOver;
+    return;
+  }
+
+  int *body = &bodies_[game * (bodyMask_ + 1)];
+  bodyStarts_[game] = (bodyStarts_[game] - 1) & bodyMask_;
+  body[bodyStarts_[game]] = head;
+  ++bodyLengths_[game];
+  heads_[game] = head;
+  occupyCell(game, head);
+
+  if (head == rewards_[game]) {
+    if (freeCounts_[game] > 0) {
+      std::uniform_int_distribution<std::size_t> pick(0,
+                                                      freeCounts_[game] - 1);
+      rewards_[game] = freeCells_[game * cells_ + pick(rngs_[game])];
+    }
+  } else {
+    --bodyLengths_[game];
+    releaseCell(game, body[(bodyStarts_[game] + bodyLengths_[game]) &
+                           bodyMask_]);
+  }
+
+  movesMade_[game] = 0;
+}
+
+void SnakeBatch::occupyCell(std::size_t game, int cell) {
+  int *freeCells = &freeCells_[game * cells_];
+  int *freeSlots = &freeSlots_[game * cells_];
+  const int slot = freeSlots[cell];
+  const int last = freeCells[--freeCounts_[game]];
+  freeCells[slot] = last;
+  freeSlots[last] = slot;
+  freeSlots[cell] = -1;
+}
+
+void SnakeBatch::releaseCell(std::size_t game, int cell) {
+  int *freeCells = &freeCells_[game * cells_];
+  int *freeSlots = &freeSlots_[game * cells_];
+  freeSlots[cell] = freeCounts_[game];
+  freeCells[freeCounts_[game]++] = cell;
+}
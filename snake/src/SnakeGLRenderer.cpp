@@ -0,0 +1,181 @@
+#include "SnakeGLRenderer.hpp"
+
+#include <QDebug>
+
+namespace {
+
+// Cell codes stored in the texture buffer
+constexpr std::uint8_t kEmpty = 0;
+constexpr std::uint8_t kBody = 1;
+constexpr std::uint8_t kReward = 2;
+constexpr std::uint8_t kHead = 4; // plus the Direction in the low two bits
+
+const char *vertexShaderSource = R"(
+    #version 330 core
+    layout(location = 0) in vec2 position;
+    uniform vec2 boardPixels;
+    uniform vec2 viewport;
+    uniform ivec2 boardCells;
+    out vec2 boardCoord;
+    void main() {
+        // position spans the board in [0, 1]; cells are counted from the top
+        boardCoord = position * vec2(boardCells);
+        vec2 pixel = position * boardPixels;
+        vec2 ndc = pixel / viewport * 2.0 - 1.0;
+        gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+    }
+)";
+
+const char *fragmentShaderSource = R"(
+    #version 330 core
+    uniform usamplerBuffer cells;
+    uniform ivec2 boardCells;
+    uniform float cellPixels;
+    in vec2 boardCoord;
+    out vec4 fragColor;
+    void main() {
+        ivec2 cell = min(ivec2(boardCoord), boardCells - 1);
+        vec2 local = fract(boardCoord);
+        uint code = texelFetch(cells, cell.y * boardCells.x + cell.x).r;
+
+        // Cell outlines, matching the QPainter renderer's black pen
+        if (any(lessThan(local * cellPixels, vec2(1.0)))) {
+            fragColor = vec4(0.0, 0.0, 0.0, 1.0);
+            return;
+        }
+
+        vec3 color = vec3(200.0, 200.0, 255.0) / 255.0; // Light blue background
+        if (code == 1u) {
+            color = vec3(0.0, 1.0, 0.0); // Green snake body
+        } else if (code == 2u) {
+            color = vec3(1.0, 0.0, 0.0); // Red reward
+        } else if (code >= 4u) {
+            // Yellow head, with the half facing the direction of movement black
+            uint direction = code - 4u;
+            bool facing = (direction == 0u && local.y < 0.5) ||
+                          (direction == 1u && local.y >= 0.5) ||
+                          (direction == 2u && local.x < 0.5) ||
+                          (direction == 3u && local.x >= 0.5);
+            color = facing ? vec3(0.0) : vec3(1.0, 1.0, 0.0);
+        }
+        fragColor = vec4(color, 1.0);
+    }
+)";
+
+} // namespace
+
+SnakeGLRenderer::~SnakeGLRenderer() {
+  // The owner makes the context current before destroying the renderer
+  if (vao_ == 0)
+    return;
+  glDeleteTextures(1, &cellTexture_);
+  glDeleteBuffers(1, &cellBuffer_);
+  glDeleteBuffers(1, &quadBuffer_);
+  glDeleteVertexArrays(1, &vao_);
+}
+
+bool SnakeGLRenderer::initialize() {
+  initializeOpenGLFunctions();
+
+  program_ = std::make_unique<QOpenGLShaderProgram>();
+  if (!program_->addShaderFromSourceCode(QOpenGLShader::Vertex,
+                                         vertexShaderSource) ||
+      !program_->addShaderFromSourceCode(QOpenGLShader::Fragment,
+                                         fragmentShaderSource) ||
+      !program_->link()) {
+    qWarning() << "Snake GL renderer unavailable:" << program_->log();
+    program_.reset();
+    return false;
+  }
+  boardCellsLocation_ = program_->uniformLocation("boardCells");
+  boardPixelsLocation_ = program_->uniformLocation("boardPixels");
+  viewportLocation_ = program_->uniformLocation("viewport");
+  cellPixelsLocation_ = program_->uniformLocation("cellPixels");
+
+  static const GLfloat quadVertices[] = {0.0f, 0.0f, 1.0f, 0.0f,
+                                         0.0f, 1.0f, 1.0f, 1.0f};
+  glGenVertexArrays(1, &vao_);
+  glBindVertexArray(vao_);
+  glGenBuffers(1, &quadBuffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, quadBuffer_);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices,
+               GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat),
+                        nullptr);
+  glBindVertexArray(0);
+
+  glGenBuffers(1, &cellBuffer_);
+  glGenTextures(1, &cellTexture_);
+  return true;
+}
+
+void SnakeGLRenderer::render(const GameState &state, bool fullUpload,
+                             std::span<const std::pair<int, int>> dirtyCells,
+                             QSize viewport, int cellPixels) {
+  if (fullUpload || state.rows != rows_ || state.cols != cols_) {
+    uploadBoard(state);
+  } else {
+    glBindBuffer(GL_TEXTURE_BUFFER, cellBuffer_);
+    for (const auto &cell : dirtyCells) {
+      const int index = cell.first * cols_ + cell.second;
+      const std::uint8_t code = cellCode(state, cell);
+      if (cells_[index] == code)
+        continue;
+      cells_[index] = code;
+      glBufferSubData(GL_TEXTURE_BUFFER, index, 1, &cells_[index]);
+    }
+  }
+
+  glClear(GL_COLOR_BUFFER_BIT);
+  program_->bind();
+  glUniform2i(boardCellsLocation_, cols_, rows_);
+  program_->setUniformValue(boardPixelsLocation_,
+                            GLfloat(cols_ * cellPixels),
+                            GLfloat(rows_ * cellPixels));
+  program_->setUniformValue(viewportLocation_, GLfloat(viewport.width()),
+                            GLfloat(viewport.height()));
+  program_->setUniformValue(cellPixelsLocation_, GLfloat(cellPixels));
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, cellTexture_);
+  glBindVertexArray(vao_);
+  glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+  glBindVertexArray(0);
+  program_->release();
+}
+
+std::uint8_t SnakeGLRenderer::cellCode(const GameState &state,
+                                       const std::pair<int, int> &cell) const {
+  if (cell == state.snake.front())
+    return kHead + static_cast<std::uint8_t>(state.currentDirection);
+  if (isSnakeCell(state, cell))
+    return kBody;
+  if (cell == state.reward)
+    return kReward;
+  return kEmpty;
+}
+
+void SnakeGLRenderer::uploadBoard(const GameState &state) {
+  const bool resized = state.rows != rows_ || state.cols != cols_;
+  rows_ = state.rows;
+  cols_ = state.cols;
+
+  cells_.assign(static_cast<std::size_t>(rows_) * cols_, kEmpty);
+  for (std::size_t i = 0; i < state.snake.size(); ++i)
+    cells_[state.snake[i].first * cols_ + state.snake[i].second] = kBody;
+  cells_[state.reward.first * cols_ + state.reward.second] =
+      cellCode(state, state.reward);
+  const auto head = state.snake.front();
+  cells_[head.first * cols_ + head.second] = cellCode(state, head);
+
+  glBindBuffer(GL_TEXTURE_BUFFER, cellBuffer_);
+  if (resized) {
+    glBufferData(GL_TEXTURE_BUFFER, cells_.size(), cells_.data(),
+                 GL_DYNAMIC_DRAW);
+    glBindTexture(GL_TEXTURE_BUFFER, cellTexture_);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, cellBuffer_);
+  } else {
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, cells_.size(), cells_.data());
+  }
+}
@@ -0,0 +1,215 @@
+#include "SnakeReplay.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <variant>
+
+#include "MappedFile.hpp"
+
+namespace {
+
+constexpr char kMagic[4] = {'S', 'N', 'K', 'R'};
+constexpr unsigned char kVersion = 1;
+constexpr std::size_t kHeaderSize = 4 + 1 + 3 * 4;
+constexpr unsigned int kCheckpoint = 4;
+constexpr std::size_t kFlushThreshold = 64 * 1024;
+// Records are never further apart than a recorder's checkpoint interval, so a
+// larger tick count can only come from a corrupt file
+constexpr int kMaxCheckpointInterval = 1 << 20;
+
+void hashValue(std::uint64_t &hash, std::uint64_t value) {
+  // FNV-1a over the value's bytes
+  for (int i = 0; i < 8; ++i) {
+    hash ^= (value >> (8 * i)) & 0xff;
+    hash *= 1099511628211ull;
+  }
+}
+
+std::uint64_t readFixed(const unsigned char *data, int bytes) {
+  std::uint64_t value = 0;
+  for (int i = 0; i < bytes; ++i)
+    value |= std::uint64_t(data[i]) << (8 * i);
+  return value;
+}
+
+bool readVarint(const unsigned char *&cursor, const unsigned char *end,
+                std::uint64_t &value) {
+  value = 0;
+  for (int shift = 0; cursor < end && shift < 64; shift += 7) {
+    const unsigned char byte = *cursor++;
+    value |= std::uint64_t(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+} // namespace
+
+std::uint64_t hashGameState(const GameState &state) {
+  std::uint64_t hash = 14695981039346656037ull;
+  hashValue(hash, state.snake.size());
+  for (std::size_t i = 0; i < state.snake.size(); ++i)
+    hashValue(hash, std::uint64_t(state.snake[i].first) << 32 |
+                        std::uint32_t(state.snake[i].second));
+  hashValue(hash, std::uint64_t(state.reward.first) << 32 |
+                      std::uint32_t(state.reward.second));
+  hashValue(hash, static_cast<std::uint64_t>(state.currentDirection));
+  hashValue(hash, state.moveMade);
+  hashValue(hash, static_cast<std::uint64_t>(state.status));
+  return hash;
+}
+
+ReplayRecorder::ReplayRecorder(const std::string &path, int rows, int cols,
+                               unsigned int seed, int checkpointInterval)
+    : file_(std::fopen(path.c_str(), "wb")), failed_(file_ == nullptr),
+      checkpointInterval_(std::clamp(checkpointInterval, 1,
+                                     kMaxCheckpointInterval)) {
+  buffer_.reserve(kFlushThreshold + 32);
+  buffer_.insert(buffer_.end(), kMagic, kMagic + 4);
+  buffer_.push_back(kVersion);
+  writeFixed(rows, 4);
+  writeFixed(cols, 4);
+  writeFixed(seed, 4);
+}
+
+ReplayRecorder::~ReplayRecorder() {
+  flush();
+  if (file_)
+    std::fclose(file_);
+}
+
+void ReplayRecorder::record(const Action &action, const GameState &state) {
+  if (!file_)
+    return;
+  if (const auto *turn = std::get_if<UserDirectionAction>(&action)) {
+    writeRecord(static_cast<unsigned int>(turn->direction));
+    return;
+  }
+  if (++tick_ % checkpointInterval_ == 0) {
+    writeRecord(kCheckpoint);
+    writeFixed(hashGameState(state), 8);
+  }
+}
+
+bool ReplayRecorder::finish(const GameState &state) {
+  if (!file_)
+    return !failed_;
+  writeRecord(kCheckpoint);
+  writeFixed(hashGameState(state), 8);
+  flush();
+  // fclose writes what the stream still buffers
+  if (std::fclose(file_) != 0)
+    failed_ = true;
+  file_ = nullptr;
+  return !failed_;
+}
+
+void ReplayRecorder::writeRecord(unsigned int kind) {
+  writeVarint((tick_ - lastRecordTick_) << 3 | kind);
+  lastRecordTick_ = tick_;
+  if (buffer_.size() >= kFlushThreshold)
+    flush();
+}
+
+void ReplayRecorder::writeVarint(std::uint64_t value) {
+  while (value >= 0x80) {
+    buffer_.push_back(static_cast<unsigned char>(value | 0x80));
+    value >>= 7;
+  }
+  buffer_.push_back(static_cast<unsigned char>(value));
+}
+
+void ReplayRecorder::writeFixed(std::uint64_t value, int bytes) {
+  for (int i = 0; i < bytes; ++i)
+    buffer_.push_back(static_cast<unsigned char>(value >> (8 * i)));
+}
+
+void ReplayRecorder::flush() {
+  if (file_ && !buffer_.empty() &&
+      std::fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size())
+    failed_ = true;
+  buffer_.clear();
+}
+
+ReplayResult replayFile(const std::string &path) {
+  ReplayResult result;
+  MappedFile file;
+  if (!file.open(path)) {
+    result.error = "cannot map " + path;
+    return result;
+  }
+  const std::string_view contents = file.contents();
+  const auto *data = reinterpret_cast<const unsigned char *>(contents.data());
+  result.bytes = contents.size();
+  if (contents.size() < kHeaderSize ||
+      std::memcmp(data, kMagic, 4) != 0 || data[4] != kVersion) {
+    result.error = "not a snake replay file";
+    return result;
+  }
+
+  const std::uint64_t rows = readFixed(data + 5, 4);
+  const std::uint64_t cols = readFixed(data + 9, 4);
+  if (rows < kMinBoardSide || rows > kMaxBoardSide || cols < kMinBoardSide ||
+      cols > kMaxBoardSide) {
+    result.error = "unsupported board size " + std::to_string(rows) + "x" +
+                   std::to_string(cols);
+    return result;
+  }
+  const auto seed = static_cast<unsigned int>(readFixed(data + 13, 4));
+  GameState state = initializeGameState(static_cast<int>(rows),
+                                        static_cast<int>(cols), seed);
+
+  const unsigned char *cursor = data + kHeaderSize;
+  const unsigned char *end = data + contents.size();
+  bool finished = false;
+  while (cursor < end) {
+    std::uint64_t record;
+    if (!readVarint(cursor, end, record)) {
+      result.error = "truncated record";
+      return result;
+    }
+    // The recording stops at the tick that ends the game
+    if ((record >> 3) > kMaxCheckpointInterval) {
+      result.error = "corrupt record";
+      return result;
+    }
+    for (std::uint64_t i = record >> 3; i > 0; --i) {
+      if (state.status == GameStatus::GameOver) {
+        result.error = "ticks after game over at tick " +
+                       std::to_string(result.ticks);
+        return result;
+      }
+      reduceInPlace(state, RequestNextFrameAction{});
+      ++result.ticks;
+    }
+
+    const unsigned int kind = record & 7;
+    if (kind < kCheckpoint) {
+      reduceInPlace(state, UserDirectionAction{static_cast<Direction>(kind)});
+      ++result.directionActions;
+      finished = false;
+    } else if (kind == kCheckpoint && end - cursor >= 8) {
+      const std::uint64_t expected = readFixed(cursor, 8);
+      cursor += 8;
+      ++result.checkpoints;
+      if (hashGameState(state) != expected) {
+        result.error = "state hash mismatch at tick " +
+                       std::to_string(result.ticks);
+        return result;
+      }
+      finished = true;
+    } else {
+      result.error = "corrupt record";
+      return result;
+    }
+  }
+
+  if (!finished) {
+    result.error = "missing final checkpoint";
+    return result;
+  }
+  result.ok = true;
+  result.finalState = std::move(state);
+  return result;
+}
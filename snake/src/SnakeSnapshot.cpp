@@ -0,0 +1,265 @@
+#include "SnakeSnapshot.hpp"
+
+namespace {
+
+constexpr unsigned char kKeyframe = 1 << 0;
+constexpr unsigned char kHeadAdvanced = 1 << 1;
+constexpr unsigned char kTailDropped = 1 << 2;
+constexpr unsigned char kRewardMoved = 1 << 3;
+constexpr int kDirectionShift = 4;
+constexpr unsigned char kMoveMade = 1 << 6;
+constexpr unsigned char kGameOver = 1 << 7;
+
+unsigned char stateFlags(const GameState &state) {
+  return static_cast<unsigned char>(
+      static_cast<unsigned int>(state.currentDirection) << kDirectionShift |
+      (state.moveMade ? kMoveMade : 0) |
+      (state.status == GameStatus::GameOver ? kGameOver : 0));
+}
+
+Direction flagDirection(unsigned char flags) {
+  return static_cast<Direction>((flags >> kDirectionShift) & 3);
+}
+
+void writeVarint(std::vector<unsigned char> &out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<unsigned char>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<unsigned char>(value));
+}
+
+bool readVarint(const unsigned char *&cursor, const unsigned char *end,
+                std::uint64_t &value) {
+  value = 0;
+  for (int shift = 0; cursor < end && shift < 64; shift += 7) {
+    const unsigned char byte = *cursor++;
+    value |= std::uint64_t(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+bool isAdjacent(const GameState &state, const std::pair<int, int> &a,
+                const std::pair<int, int> &b) {
+  for (const Direction direction : {Direction::Up, Direction::Down,
+                                    Direction::Left, Direction::Right})
+    if (neighborCell(state, a, direction) == b)
+      return true;
+  return false;
+}
+
+// Direction that steps from `from` to the adjacent cell `to`
+unsigned int stepDirection(int rows, int cols, const std::pair<int, int> &from,
+                           const std::pair<int, int> &to) {
+  if (to.first == (from.first - 1 + rows) % rows && to.second == from.second)
+    return static_cast<unsigned int>(Direction::Up);
+  if (to.first == (from.first + 1) % rows && to.second == from.second)
+    return static_cast<unsigned int>(Direction::Down);
+  if (to.second == (from.second - 1 + cols) % cols)
+    return static_cast<unsigned int>(Direction::Left);
+  return static_cast<unsigned int>(Direction::Right);
+}
+
+} // namespace
+
+SnapshotEncoder::SnapshotEncoder(int keyframeInterval)
+    : keyframeInterval_(keyframeInterval > 0 ? keyframeInterval : 1),
+      ticksSinceKeyframe_(keyframeInterval_) {}
+
+std::span<const unsigned char> SnapshotEncoder::encode(const GameState &state) {
+  buffer_.clear();
+  if (ticksSinceKeyframe_ >= keyframeInterval_ || !encodeDelta(state)) {
+    buffer_.clear();
+    encodeKeyframe(state);
+    ticksSinceKeyframe_ = 0;
+  }
+  ++ticksSinceKeyframe_;
+  remember(state);
+  return buffer_;
+}
+
+bool SnapshotEncoder::encodeDelta(const GameState &state) {
+  // Anything a single tick cannot produce, such as a new game or a skipped
+  // tick, falls back to a keyframe
+  if (state.rows != rows_ || state.cols != cols_ || length_ == 0 ||
+      state.snake.empty() ||
+      (status_ == GameStatus::GameOver &&
+       state.status == GameStatus::Running))
+    return false;
+
+  const auto &head = state.snake.front();
+  const bool headAdvanced = head != head_;
+  if (headAdvanced &&
+      head != neighborCell(state, head_, state.currentDirection))
+    return false;
+  const auto dropped = static_cast<long long>(length_) + headAdvanced -
+                       static_cast<long long>(state.snake.size());
+  if (dropped < 0 || dropped > 1 || (dropped == 1 && !headAdvanced))
+    return false;
+  const bool tailDropped = dropped == 1;
+  if (tailDropped ? !isAdjacent(state, tail_, state.snake.back())
+                  : state.snake.back() != tail_)
+    return false;
+
+  const bool rewardMoved = state.reward != reward_;
+  buffer_.push_back(stateFlags(state) | (headAdvanced ? kHeadAdvanced : 0) |
+                    (tailDropped ? kTailDropped : 0) |
+                    (rewardMoved ? kRewardMoved : 0));
+  if (rewardMoved)
+    writeVarint(buffer_, state.reward.first * state.cols + state.reward.second);
+  return true;
+}
+
+void SnapshotEncoder::encodeKeyframe(const GameState &state) {
+  buffer_.push_back(stateFlags(state) | kKeyframe);
+  writeVarint(buffer_, state.rows);
+  writeVarint(buffer_, state.cols);
+  writeVarint(buffer_, state.reward.first * state.cols + state.reward.second);
+  writeVarint(buffer_, state.snake.size());
+  if (state.snake.empty())
+    return;
+  const auto &head = state.snake.front();
+  writeVarint(buffer_, head.first * state.cols + head.second);
+
+  unsigned char packed = 0;
+  int count = 0;
+  for (std::size_t i = 1; i < state.snake.size(); ++i) {
+    packed |= stepDirection(state.rows, state.cols, state.snake[i - 1],
+                            state.snake[i])
+              << (2 * count);
+    if (++count == 4) {
+      buffer_.push_back(packed);
+      packed = 0;
+      count = 0;
+    }
+  }
+  if (count > 0)
+    buffer_.push_back(packed);
+}
+
+void SnapshotEncoder::remember(const GameState &state) {
+  rows_ = state.rows;
+  cols_ = state.cols;
+  length_ = state.snake.size();
+  if (length_ > 0) {
+    head_ = state.snake.front();
+    tail_ = state.snake.back();
+  }
+  reward_ = state.reward;
+  status_ = state.status;
+}
+
+bool SnapshotDecoder::decode(std::span<const unsigned char> bytes) {
+  const unsigned char *cursor = bytes.data();
+  const unsigned char *end = cursor + bytes.size();
+  while (cursor < end) {
+    const unsigned char flags = *cursor++;
+    if (flags & kKeyframe) {
+      if (!decodeKeyframe(flags, cursor, end))
+        return hasKeyframe_ = false;
+      continue;
+    }
+    if (!hasKeyframe_)
+      return false;
+    std::pair<int, int> reward = state_.reward;
+    if (flags & kRewardMoved) {
+      std::uint64_t index;
+      if (!readVarint(cursor, end, index) ||
+          index >= std::uint64_t(state_.rows) * state_.cols)
+        return hasKeyframe_ = false;
+      reward = {static_cast<int>(index / state_.cols),
+                static_cast<int>(index % state_.cols)};
+    }
+    if (!applyDelta(flags, reward))
+      return hasKeyframe_ = false;
+  }
+  return true;
+}
+
+bool SnapshotDecoder::decodeKeyframe(unsigned char flags,
+                                     const unsigned char *&cursor,
+                                     const unsigned char *end) {
+  std::uint64_t rows, cols, reward, length;
+  if (!readVarint(cursor, end, rows) || !readVarint(cursor, end, cols) ||
+      !readVarint(cursor, end, reward) || !readVarint(cursor, end, length) ||
+      rows < kMinBoardSide || rows > kMaxBoardSide || cols < kMinBoardSide ||
+      cols > kMaxBoardSide || reward >= rows * cols || length == 0 ||
+      length > rows * cols)
+    return false;
+  std::uint64_t head;
+  if (!readVarint(cursor, end, head) || head >= rows * cols)
+    return false;
+  const std::size_t bodyBytes = length > 1 ? (length - 1 + 3) / 4 : 0;
+  if (static_cast<std::size_t>(end - cursor) < bodyBytes)
+    return false;
+
+  // Reuse the buffers when the board size is unchanged: uncovering the old
+  // body costs O(length) instead of rebuilding the whole free-cell index
+  if (hasKeyframe_ && std::uint64_t(state_.rows) == rows &&
+      std::uint64_t(state_.cols) == cols) {
+    for (std::size_t i = 0; i < state_.snake.size(); ++i)
+      releaseCell(state_, state_.snake[i]);
+  } else {
+    state_.rows = static_cast<int>(rows);
+    state_.cols = static_cast<int>(cols);
+    state_.freeCells.resize(rows * cols);
+    state_.freeSlot.resize(rows * cols);
+    for (std::size_t i = 0; i < rows * cols; ++i) {
+      state_.freeCells[i] = static_cast<int>(i);
+      state_.freeSlot[i] = static_cast<int>(i);
+    }
+  }
+  state_.snake.clear();
+  state_.reward = {static_cast<int>(reward / cols),
+                   static_cast<int>(reward % cols)};
+  state_.currentDirection = flagDirection(flags);
+  state_.moveMade = (flags & kMoveMade) != 0;
+  state_.status =
+      (flags & kGameOver) ? GameStatus::GameOver : GameStatus::Running;
+
+  std::pair<int, int> cell = {static_cast<int>(head / cols),
+                              static_cast<int>(head % cols)};
+  state_.snake.reserve(length);
+  state_.snake.push_back(cell);
+  occupyCell(state_, cell);
+  for (std::uint64_t i = 1; i < length; ++i) {
+    const unsigned int shift = 2 * ((i - 1) % 4);
+    const unsigned int step = (cursor[(i - 1) / 4] >> shift) & 3;
+    cell = neighborCell(state_, cell, static_cast<Direction>(step));
+    // A body crossing itself would claim a cell twice and break the index;
+    // decode() then drops the partial state
+    if (isSnakeCell(state_, cell))
+      return false;
+    state_.snake.push_back(cell);
+    occupyCell(state_, cell);
+  }
+  cursor += bodyBytes;
+  hasKeyframe_ = true;
+  return true;
+}
+
+bool SnapshotDecoder::applyDelta(unsigned char flags,
+                                 std::pair<int, int> reward) {
+  // Same order as the reducer: claim the new head, then free the tail. The
+  // reducer ends the game instead of moving onto the body, tail included.
+  state_.currentDirection = flagDirection(flags);
+  if (flags & kHeadAdvanced) {
+    const auto head =
+        neighborCell(state_, state_.snake.front(), state_.currentDirection);
+    if (isSnakeCell(state_, head))
+      return false;
+    state_.snake.push_front(head);
+    occupyCell(state_, head);
+  }
+  if ((flags & kTailDropped) && state_.snake.size() > 1) {
+    releaseCell(state_, state_.snake.back());
+    state_.snake.pop_back();
+  }
+  state_.reward = reward;
+  state_.moveMade = (flags & kMoveMade) != 0;
+  state_.status =
+      (flags & kGameOver) ? GameStatus::GameOver : GameStatus::Running;
+  return true;
+}
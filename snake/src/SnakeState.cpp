@@ -1,144 +1,172 @@
-#include <QApplication>
-#include <QDebug>
-#include <QKeyEvent>
-#include <QMainWindow>
-#include <QMessageBox>
-#include <QOpenGLWidget>
-#include <QPainter>
-#include <algorithm>
-#include <cstdlib>
-#include <ctime>
-#include <set>
 #include <utility>
 #include <variant>
 #include <vector>
 
-const int SQUARE_SIZE_PIXELS = 15;
+#include "Profiler.hpp"
+#include "SnakeState.hpp"
 
-enum class Direction { Up, Down, Left, Right };
+namespace {
 
-struct GameState {
-  int rows;
-  int cols;
-  std::vector<std::pair<int, int>> snake;
-  std::pair<int, int> reward;
-  Direction currentDirection;
-  bool moveMade; // Track if a move has been made in the current time step
-};
+int cellIndex(const GameState &state, const std::pair<int, int> &cell) {
+  return cell.first * state.cols + cell.second;
+}
 
-struct UserDirectionAction {
-  Direction direction;
-};
+} // namespace
+
+// Remove a cell from the free list by swapping the last free cell into its
+// slot.
+void occupyCell(GameState &state, const std::pair<int, int> &cell) {
+  const int index = cellIndex(state, cell);
+  const int slot = state.freeSlot[index];
+  if (slot < 0)
+    return;
+  const int last = state.freeCells.back();
+  state.freeCells[slot] = last;
+  state.freeSlot[last] = slot;
+  state.freeCells.pop_back();
+  state.freeSlot[index] = -1;
+}
 
-struct RequestNextFrameAction {};
+void releaseCell(GameState &state, const std::pair<int, int> &cell) {
+  const int index = cellIndex(state, cell);
+  if (state.freeSlot[index] >= 0)
+    return;
+  state.freeSlot[index] = static_cast<int>(state.freeCells.size());
+  state.freeCells.push_back(index);
+}
 
-using Action = std::variant<UserDirectionAction, RequestNextFrameAction>;
+void SnakeBody::reserve(std::size_t capacity) {
+  // Keep the capacity a power of two so indices wrap with a mask
+  std::size_t rounded = 1;
+  while (rounded < capacity)
+    rounded *= 2;
+  if (rounded <= cells_.size())
+    return;
+  std::vector<value_type> cells(rounded);
+  for (std::size_t i = 0; i < size_; ++i)
+    cells[i] = (*this)[i];
+  cells_ = std::move(cells);
+  head_ = 0;
+}
 
-void placeReward(GameState &state) {
-  std::srand(std::time(nullptr));
+bool isSnakeCell(const GameState &state, const std::pair<int, int> &cell) {
+  return state.freeSlot[cellIndex(state, cell)] < 0;
+}
 
-  // Create a set of all possible grid positions
-  std::set<std::pair<int, int>> gridPositions;
-  for (int i = 0; i < state.rows; ++i) {
-    for (int j = 0; j < state.cols; ++j) {
-      gridPositions.insert({i, j});
-    }
+std::pair<int, int> neighborCell(const GameState &state,
+                                 std::pair<int, int> cell,
+                                 Direction direction) {
+  switch (direction) {
+  case Direction::Up:
+    cell.first = (cell.first - 1 + state.rows) % state.rows;
+    break;
+  case Direction::Down:
+    cell.first = (cell.first + 1) % state.rows;
+    break;
+  case Direction::Left:
+    cell.second = (cell.second - 1 + state.cols) % state.cols;
+    break;
+  case Direction::Right:
+    cell.second = (cell.second + 1) % state.cols;
+    break;
   }
+  return cell;
+}
 
-  // Create a set of snake positions
-  const std::set<std::pair<int, int>> snakePositions(state.snake.begin(),
-                                                     state.snake.end());
-
-  // Calculate the set difference to find available positions
-  std::vector<std::pair<int, int>> availablePositions;
-  std::set_difference(gridPositions.begin(), gridPositions.end(),
-                      snakePositions.begin(), snakePositions.end(),
-                      std::back_inserter(availablePositions));
-
-  // Randomly select a position from the available positions
-  if (!availablePositions.empty()) {
-    const int index = std::rand() % availablePositions.size();
-    state.reward = availablePositions[index];
+void placeReward(GameState &state) {
+  // Randomly select a position from the cells the snake does not cover
+  if (!state.freeCells.empty()) {
+    std::uniform_int_distribution<std::size_t> pick(
+        0, state.freeCells.size() - 1);
+    const int index = state.freeCells[pick(state.rng)];
+    state.reward = {index / state.cols, index % state.cols};
   }
 }
 
+// Applies actions to the state in place, reusing its buffers
 class ActionVisitor {
 public:
-  GameState operator()(const UserDirectionAction &action,
-                       const GameState &state) const {
-    GameState newState = state;
-    if (newState.moveMade)
-      return newState;
+  void operator()(const UserDirectionAction &action, GameState &state) const {
+    if (state.moveMade)
+      return;
     if ((action.direction == Direction::Up &&
-         newState.currentDirection != Direction::Down) ||
+         state.currentDirection != Direction::Down) ||
         (action.direction == Direction::Down &&
-         newState.currentDirection != Direction::Up) ||
+         state.currentDirection != Direction::Up) ||
         (action.direction == Direction::Left &&
-         newState.currentDirection != Direction::Right) ||
+         state.currentDirection != Direction::Right) ||
         (action.direction == Direction::Right &&
-         newState.currentDirection != Direction::Left)) {
-      newState.currentDirection = action.direction;
-      newState.moveMade = true;
+         state.currentDirection != Direction::Left)) {
+      state.currentDirection = action.direction;
+      state.moveMade = true;
     }
-    return newState;
   }
 
-  GameState operator()(const RequestNextFrameAction &,
-                       const GameState &state) const {
-    GameState newState = state;
-    auto head = newState.snake.front();
-    switch (newState.currentDirection) {
-    case Direction::Up:
-      head.first = (head.first - 1 + newState.rows) % newState.rows;
-      break;
-    case Direction::Down:
-      head.first = (head.first + 1) % newState.rows;
-      break;
-    case Direction::Left:
-      head.second = (head.second - 1 + newState.cols) % newState.cols;
-      break;
-    case Direction::Right:
-      head.second = (head.second + 1) % newState.cols;
-      break;
-    }
+  void operator()(const RequestNextFrameAction &, GameState &state) const {
+    if (state.status == GameStatus::GameOver)
+      return;
+
+    const auto head =
+        neighborCell(state, state.snake.front(), state.currentDirection);
 
     // Check for self-intersection
-    if (std::find(newState.snake.begin(), newState.snake.end(), head) !=
-        newState.snake.end()) {
-      const int score = newState.snake.size();
-      QMessageBox::information(nullptr, "Game Over",
-                               QString("Game Over! Your score: %1").arg(score));
-      QApplication::quit();
-      return newState;
+    if (isSnakeCell(state, head)) {
+      state.status = GameStatus::GameOver;
+      return;
     }
 
-    newState.snake.insert(newState.snake.begin(), head);
+    state.snake.push_front(head);
+    occupyCell(state, head);
 
     // Check if the snake has eaten the reward
-    if (head == newState.reward) {
-      placeReward(newState);
+    if (head == state.reward) {
+      placeReward(state);
     } else {
-      newState.snake.pop_back(); // Remove the tail if no reward is eaten
+      // Remove the tail if no reward is eaten
+      releaseCell(state, state.snake.back());
+      state.snake.pop_back();
     }
 
-    newState.moveMade = false; // Reset moveMade for the next time step
-    return newState;
+    state.moveMade = false; // Reset moveMade for the next time step
   }
 };
 
+void reduceInPlace(GameState &state, const Action &action) {
+  PROFILE_SCOPE("reduce");
+  std::visit([&state](auto &&arg) { ActionVisitor{}(arg, state); }, action);
+}
+
 GameState reduce(const GameState &state, const Action &action) {
-  return std::visit(
-      [&state](auto &&arg) -> GameState { return ActionVisitor{}(arg, state); },
-      action);
+  GameState newState = state;
+  reduceInPlace(newState, action);
+  return newState;
+}
+
+GameState reduce(GameState &&state, const Action &action) {
+  reduceInPlace(state, action);
+  return std::move(state);
 }
 
-GameState initializeGameState(int rows, int cols) {
-  GameState state = {rows, cols, {}, {0, 0}, Direction::Right, false};
+GameState initializeGameState(int rows, int cols, unsigned int seed) {
+  GameState state = {rows,  cols, {}, {0, 0}, Direction::Right,
+                     false, GameStatus::Running, {}, {},
+                     std::minstd_rand(seed)};
+
+  // Every cell starts out free; the snake segments below claim theirs
+  state.freeCells.resize(rows * cols);
+  state.freeSlot.resize(rows * cols);
+  for (int i = 0; i < rows * cols; ++i) {
+    state.freeCells[i] = i;
+    state.freeSlot[i] = i;
+  }
+
   const int centerRow = rows / 2;
   const int centerCol = cols / 2;
   state.snake.push_back({centerRow, centerCol});
   state.snake.push_back({centerRow, centerCol - 1});
   state.snake.push_back({centerRow, centerCol - 2});
+  for (std::size_t i = 0; i < state.snake.size(); ++i)
+    occupyCell(state, state.snake[i]);
   placeReward(state); // Initial reward placement
   return state;
 }
@@ -1,82 +1,318 @@
 #include <QApplication>
+#include <QDebug>
 #include <QKeyEvent>
 #include <QMessageBox>
 #include <QPainter>
+#include <QScreen>
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <utility>
 
+#include "Profiler.hpp"
+#include "ProfilerOverlay.hpp"
 #include "SnakeState.hpp"
 #include "SnakeWidget.hpp"
 
 SnakeWidget::SnakeWidget(const GameState &initialState, QWidget *parent)
     : QOpenGLWidget(parent), state_(initialState) {
   setFocusPolicy(Qt::StrongFocus); // Ensure the widget can catch input
-  startTimer(100); // Start a timer to move the snake every 100ms
+  // Keep the previous frame so paintGL only redraws the cells that changed
+  setUpdateBehavior(QOpenGLWidget::PartialUpdate);
+
+  // The simulation runs on its own fixed timestep, measured against a
+  // monotonic clock so timer jitter cannot change the game speed
+  previousHead_ = state_.snake.front();
+  previousTail_ = state_.snake.back();
+  clock_.start();
+  nextTickNs_ = tickIntervalNs_;
+  simulationTimer_.setTimerType(Qt::PreciseTimer);
+  simulationTimer_.setSingleShot(true);
+  connect(&simulationTimer_, &QTimer::timeout, this,
+          &SnakeWidget::advanceSimulation);
+  scheduleNextTick();
+
+  // Render at display rate, interpolating between ticks
+  connect(this, &QOpenGLWidget::frameSwapped, this, [this] {
+    if (interpolate_)
+      update();
+  });
+}
+
+SnakeWidget::~SnakeWidget() {
+  // Close a recording cut short by quitting so it still replays
+  if (recorder_ && !recorder_->finish(state_))
+    qWarning() << "Could not write the replay";
+
+  // GL resources can only be released with the widget's context current
+  makeCurrent();
+  glRenderer_.reset();
+  doneCurrent();
 }
 
-void SnakeWidget::initializeGL() {}
+void SnakeWidget::setAutopilot(std::unique_ptr<SnakeAutopilot> autopilot) {
+  autopilot_ = std::move(autopilot);
+}
+
+void SnakeWidget::setRecorder(std::unique_ptr<ReplayRecorder> recorder) {
+  recorder_ = std::move(recorder);
+}
+
+void SnakeWidget::dispatch(const Action &action) {
+  state_ = reduce(std::move(state_), action);
+  if (recorder_)
+    recorder_->record(action, state_);
+}
+
+void SnakeWidget::setIncrementalRendering(bool enabled) {
+  incrementalRendering_ = enabled;
+  needsFullRedraw_ = true;
+}
+
+void SnakeWidget::setFrameStatsEnabled(bool enabled) { frameStats_ = enabled; }
+
+void SnakeWidget::setGLRendering(bool enabled) { glRendering_ = enabled; }
+
+void SnakeWidget::setTickInterval(int milliseconds) {
+  // advanceSimulation divides by the interval
+  Q_ASSERT(milliseconds > 0);
+  tickIntervalNs_ = qint64(milliseconds) * 1'000'000;
+  nextTickNs_ = clock_.nsecsElapsed() + tickIntervalNs_;
+  scheduleNextTick();
+}
+
+void SnakeWidget::setInterpolation(bool enabled) {
+  interpolate_ = enabled;
+  update();
+}
+
+void SnakeWidget::initializeGL() {
+  if (!glRendering_)
+    return;
+  glRenderer_ = std::make_unique<SnakeGLRenderer>();
+  if (!glRenderer_->initialize())
+    glRenderer_.reset();
+}
+
+void SnakeWidget::resizeGL(int, int) {
+  // The framebuffer is recreated, so nothing drawn earlier survives
+  needsFullRedraw_ = true;
+}
+
+void SnakeWidget::benchInitialize(const QSize &size) {
+  initializeGL();
+  resizeGL(size.width(), size.height());
+}
+
+void SnakeWidget::benchFrame(QPaintDevice &device) {
+  // One tick per frame. Finished games restart from fixed seeds, so every
+  // run draws the same frames.
+  if (state_.status == GameStatus::GameOver)
+    restartGame(++benchGames_);
+  tick();
+  drawFrame(device, 1.0);
+}
 
 void SnakeWidget::paintGL() {
-  QPainter painter(this);
+  PROFILE_SCOPE("paintGL");
+  profilerFrames_.markFrame();
+  QElapsedTimer frameTimer;
+  frameTimer.start();
+
+  const qint64 now = clock_.nsecsElapsed();
+  const qreal refreshRate = screen() ? screen()->refreshRate() : 0.0;
+  if (interpolate_ && lastFrameNs_ >= 0 && refreshRate > 0.0 &&
+      now - lastFrameNs_ > 1.5e9 / refreshRate)
+    ++droppedFrames_;
+  lastFrameNs_ = now;
+
+  // Fraction of the current tick that has elapsed, for interpolation
+  const double alpha =
+      interpolate_ ? std::clamp(1.0 - double(nextTickNs_ - now) /
+                                          tickIntervalNs_,
+                                0.0, 1.0)
+                   : 1.0;
+  drawFrame(*this, alpha);
+
+  if (frameStats_) {
+    frameTimes_.record(frameTimer.nsecsElapsed());
+    if (frameTimes_.count() == 300)
+      reportFrameStats();
+  }
+}
+
+void SnakeWidget::drawFrame(QPaintDevice &device, double alpha) {
+  // After a single tick only the cells the head, tail and reward moved
+  // between can differ from what was drawn last frame. The profiler overlay
+  // covers cells that would otherwise never be repainted.
+  const bool fullRedraw = needsFullRedraw_ || !incrementalRendering_ ||
+                          ticksSincePaint_ > 1 || profiler::overlayEnabled();
+  const std::array<std::pair<int, int>, 5> frameCells = {
+      previousHead_, state_.snake.front(), previousTail_, state_.snake.back(),
+      state_.reward};
+  std::array<std::pair<int, int>, 10> dirtyCells;
+  std::copy(lastFrameCells_.begin(), lastFrameCells_.end(),
+            dirtyCells.begin());
+  std::copy(frameCells.begin(), frameCells.end(),
+            dirtyCells.begin() + lastFrameCells_.size());
+
+  if (glRenderer_) {
+    glRenderer_->render(state_, fullRedraw, dirtyCells,
+                        QSize(device.width(), device.height()),
+                        SQUARE_SIZE_PIXELS);
+  } else {
+    if (background_.isNull())
+      background_ = renderBackground();
+
+    QPainter painter(&device);
+    if (fullRedraw) {
+      painter.drawPixmap(0, 0, background_);
+      for (size_t i = 0; i < state_.snake.size(); ++i)
+        drawCell(painter, state_.snake[i]);
+      drawCell(painter, state_.reward);
+    } else {
+      for (const auto &cell : dirtyCells)
+        drawCell(painter, cell);
+    }
+    if (alpha < 1.0)
+      drawInterpolated(painter, alpha);
+  }
+  if (profiler::overlayEnabled()) {
+    QPainter painter(&device);
+    profiler::drawOverlay(painter, profilerFrames_);
+  }
+  needsFullRedraw_ = false;
+  lastFrameCells_ = frameCells;
+  ticksSincePaint_ = 0;
+}
+
+void SnakeWidget::reportFrameStats() {
+  qInfo().nospace() << "paintGL over " << frameTimes_.count() << " frames ("
+                    << state_.rows << "x" << state_.cols << ", "
+                    << (glRenderer_            ? "gl"
+                        : incrementalRendering_ ? "incremental"
+                                                : "full")
+                    << "): mean " << frameTimes_.mean() / 1e3 << " us, p99 "
+                    << frameTimes_.percentile(0.99) / 1e3 << " us";
+  qInfo().nospace() << "tick lateness over " << tickLateness_.count()
+                    << " ticks: p50 " << tickLateness_.percentile(0.5) / 1e3
+                    << " us, p99 " << tickLateness_.percentile(0.99) / 1e3
+                    << " us, max " << tickLateness_.max() / 1e3
+                    << " us; dropped ticks " << droppedTicks_
+                    << ", dropped frames " << droppedFrames_;
+  frameTimes_.reset();
+  tickLateness_.reset();
+  droppedTicks_ = 0;
+  droppedFrames_ = 0;
+}
+
+QPixmap SnakeWidget::renderBackground() const {
+  QPixmap pixmap(state_.cols * SQUARE_SIZE_PIXELS + 1,
+                 state_.rows * SQUARE_SIZE_PIXELS + 1);
+  pixmap.fill(Qt::transparent);
+  QPainter painter(&pixmap);
 
   // Draw the grid
+  painter.setBrush(QColor(200, 200, 255)); // Light blue background
   for (int i = 0; i < state_.rows; ++i) {
     for (int j = 0; j < state_.cols; ++j) {
       const QRect rect(j * SQUARE_SIZE_PIXELS, i * SQUARE_SIZE_PIXELS,
                        SQUARE_SIZE_PIXELS, SQUARE_SIZE_PIXELS);
-      painter.setBrush(QColor(200, 200, 255)); // Light blue background
       painter.drawRect(rect);
     }
   }
+  return pixmap;
+}
 
-  // Draw the snake
-  for (size_t i = 0; i < state_.snake.size(); ++i) {
-    const auto &segment = state_.snake[i];
-    const QRect rect(segment.second * SQUARE_SIZE_PIXELS,
-                     segment.first * SQUARE_SIZE_PIXELS, SQUARE_SIZE_PIXELS,
-                     SQUARE_SIZE_PIXELS);
-    if (i == 0) {
-      // Draw the head with a different color and direction indicator
-      painter.setBrush(QColor(255, 255, 0)); // Yellow color for the head
-      painter.drawRect(rect);
+// Redraws one cell from the current state: head, body, reward or background.
+void SnakeWidget::drawCell(QPainter &painter, const std::pair<int, int> &cell) {
+  const QRect rect(cell.second * SQUARE_SIZE_PIXELS,
+                   cell.first * SQUARE_SIZE_PIXELS, SQUARE_SIZE_PIXELS,
+                   SQUARE_SIZE_PIXELS);
 
-      // Draw half of the head in the direction of movement
-      QRect halfRect;
-      painter.setBrush(
-          QColor(0, 0, 0)); // Black color for the direction indicator
-      switch (state_.currentDirection) {
-      case Direction::Up:
-        halfRect =
-            QRect(rect.left(), rect.top(), rect.width(), rect.height() / 2);
-        break;
-      case Direction::Down:
-        halfRect = QRect(rect.left(), rect.center().y(), rect.width(),
-                         rect.height() / 2);
-        break;
-      case Direction::Left:
-        halfRect =
-            QRect(rect.left(), rect.top(), rect.width() / 2, rect.height());
-        break;
-      case Direction::Right:
-        halfRect = QRect(rect.center().x(), rect.top(), rect.width() / 2,
-                         rect.height());
-        break;
-      }
-      painter.drawRect(halfRect);
-    } else {
-      painter.setBrush(QColor(0, 255, 0)); // Green color for the snake body
-      painter.drawRect(rect);
-    }
+  if (cell == state_.snake.front()) {
+    drawHead(painter, rect);
+  } else if (isSnakeCell(state_, cell)) {
+    painter.setBrush(QColor(0, 255, 0)); // Green color for the snake body
+    painter.drawRect(rect);
+  } else if (cell == state_.reward) {
+    painter.setBrush(QColor(255, 0, 0)); // Red color for the reward
+    painter.drawRect(rect);
+  } else {
+    drawBackground(painter, cell);
+  }
+}
+
+void SnakeWidget::drawBackground(QPainter &painter,
+                                 const std::pair<int, int> &cell) {
+  // Include the outline pixel on the right and bottom edges
+  const QRect source(cell.second * SQUARE_SIZE_PIXELS,
+                     cell.first * SQUARE_SIZE_PIXELS, SQUARE_SIZE_PIXELS + 1,
+                     SQUARE_SIZE_PIXELS + 1);
+  painter.drawPixmap(source, background_, source);
+}
+
+void SnakeWidget::drawHead(QPainter &painter, const QRectF &rect) {
+  // Draw the head with a different color and direction indicator
+  painter.setBrush(QColor(255, 255, 0)); // Yellow color for the head
+  painter.drawRect(rect);
+
+  // Draw half of the head in the direction of movement
+  QRectF halfRect;
+  painter.setBrush(QColor(0, 0, 0)); // Black color for the direction indicator
+  switch (state_.currentDirection) {
+  case Direction::Up:
+    halfRect =
+        QRectF(rect.left(), rect.top(), rect.width(), rect.height() / 2);
+    break;
+  case Direction::Down:
+    halfRect = QRectF(rect.left(), rect.center().y(), rect.width(),
+                      rect.height() / 2);
+    break;
+  case Direction::Left:
+    halfRect =
+        QRectF(rect.left(), rect.top(), rect.width() / 2, rect.height());
+    break;
+  case Direction::Right:
+    halfRect = QRectF(rect.center().x(), rect.top(), rect.width() / 2,
+                      rect.height());
+    break;
   }
+  painter.drawRect(halfRect);
+}
+
+// Draws the head and tail part of the way from their previous cells, so the
+// snake glides between ticks instead of jumping a cell at a time.
+void SnakeWidget::drawInterpolated(QPainter &painter, double alpha) {
+  const auto head = state_.snake.front();
+  const auto tail = state_.snake.back();
+  if (head == previousHead_)
+    return;
+
+  // Positions across the board edge wrap, so they are not interpolated
+  const auto between = [alpha](const std::pair<int, int> &from,
+                               const std::pair<int, int> &to) {
+    const bool adjacent = std::abs(from.first - to.first) <= 1 &&
+                          std::abs(from.second - to.second) <= 1;
+    const double t = adjacent ? alpha : 1.0;
+    return QRectF((from.second + (to.second - from.second) * t) *
+                      SQUARE_SIZE_PIXELS,
+                  (from.first + (to.first - from.first) * t) *
+                      SQUARE_SIZE_PIXELS,
+                  SQUARE_SIZE_PIXELS, SQUARE_SIZE_PIXELS);
+  };
 
-  // Draw the reward
-  painter.setBrush(QColor(255, 0, 0)); // Red color for the reward
-  const QRect rewardRect(state_.reward.second * SQUARE_SIZE_PIXELS,
-                         state_.reward.first * SQUARE_SIZE_PIXELS,
-                         SQUARE_SIZE_PIXELS, SQUARE_SIZE_PIXELS);
-  painter.drawRect(rewardRect);
+  // The head has not fully entered its new cell yet
+  drawBackground(painter, head);
+  if (tail != previousTail_) {
+    painter.setBrush(QColor(0, 255, 0)); // Green color for the snake body
+    painter.drawRect(between(previousTail_, tail));
+  }
+  drawHead(painter, between(previousHead_, head));
 }
 
 void SnakeWidget::keyPressEvent(QKeyEvent *event) {
-  if (state_.moveMade)
+  if (autopilot_ || state_.moveMade)
     return; // Only allow one move per time step
   UserDirectionAction action;
   switch (event->key()) {
@@ -95,11 +331,78 @@ void SnakeWidget::keyPressEvent(QKeyEvent *event) {
   default:
     return;
   }
-  state_ = reduce(state_, action);
+  dispatch(action);
 }
 
-void SnakeWidget::timerEvent(QTimerEvent *event) {
-  RequestNextFrameAction request;
-  state_ = reduce(state_, request);
-  update();
+void SnakeWidget::advanceSimulation() {
+  PROFILE_SCOPE("advanceSimulation");
+  // Run every tick that has come due. After a long stall, skip the backlog
+  // rather than fast-forwarding the game.
+  const qint64 now = clock_.nsecsElapsed();
+  int ticks = 0;
+  while (now >= nextTickNs_ && state_.status == GameStatus::Running) {
+    if (ticks == kMaxCatchUpTicks) {
+      const qint64 missed = (now - nextTickNs_) / tickIntervalNs_ + 1;
+      droppedTicks_ += missed;
+      nextTickNs_ += missed * tickIntervalNs_;
+      break;
+    }
+    tickLateness_.record(now - nextTickNs_);
+    tick();
+    nextTickNs_ += tickIntervalNs_;
+    ++ticks;
+  }
+  if (ticks > 0)
+    update();
+
+  if (state_.status == GameStatus::GameOver && recorder_) {
+    if (!recorder_->finish(state_))
+      qWarning() << "Could not write the replay";
+    recorder_.reset();
+  }
+
+  if (state_.status == GameStatus::GameOver && autopilot_) {
+    reportAutopilotGame();
+    restartGame(std::random_device{}());
+  } else if (state_.status == GameStatus::GameOver) {
+    const int score = state_.snake.size();
+    QMessageBox::information(this, "Game Over",
+                             QString("Game Over! Your score: %1").arg(score));
+    QApplication::quit();
+    return;
+  }
+  scheduleNextTick();
+}
+
+void SnakeWidget::tick() {
+  if (autopilot_)
+    dispatch(autopilot_->decide(state_));
+
+  previousHead_ = state_.snake.front();
+  previousTail_ = state_.snake.back();
+  dispatch(RequestNextFrameAction{});
+  ++ticksSincePaint_;
+}
+
+void SnakeWidget::restartGame(unsigned int seed) {
+  state_ = initializeGameState(state_.rows, state_.cols, seed);
+  previousHead_ = state_.snake.front();
+  previousTail_ = state_.snake.back();
+  needsFullRedraw_ = true;
+}
+
+void SnakeWidget::scheduleNextTick() {
+  const qint64 remainingNs = nextTickNs_ - clock_.nsecsElapsed();
+  simulationTimer_.start(
+      std::max<qint64>(0, (remainingNs + 999'999) / 1'000'000));
+}
+
+void SnakeWidget::reportAutopilotGame() {
+  const LatencyHistogram &latencies = autopilot_->latencies();
+  qInfo().nospace() << "Autopilot game " << ++autopilotGames_
+                    << " over, score " << state_.snake.size()
+                    << "; decision latency us p50 "
+                    << latencies.percentile(0.5) / 1e3 << " p99 "
+                    << latencies.percentile(0.99) / 1e3 << " max "
+                    << latencies.max() / 1e3;
 }
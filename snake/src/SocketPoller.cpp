@@ -0,0 +1,130 @@
+#include "SocketPoller.hpp"
+
+#include <cstdint>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#ifdef __APPLE__
+#include <climits>
+#endif
+
+#ifdef __linux__
+
+namespace {
+
+std::uint32_t eventMask(bool writable) {
+  return EPOLLIN | EPOLLRDHUP | (writable ? std::uint32_t(EPOLLOUT) : 0u);
+}
+
+} // namespace
+
+SocketPoller::SocketPoller() : epollFd_(::epoll_create1(EPOLL_CLOEXEC)) {}
+
+SocketPoller::~SocketPoller() {
+  if (epollFd_ >= 0)
+    ::close(epollFd_);
+}
+
+void SocketPoller::add(int fd, bool writable) {
+  epoll_event event{};
+  event.events = eventMask(writable);
+  event.data.fd = fd;
+  ::epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &event);
+}
+
+void SocketPoller::setWritable(int fd, bool writable) {
+  epoll_event event{};
+  event.events = eventMask(writable);
+  event.data.fd = fd;
+  ::epoll_ctl(epollFd_, EPOLL_CTL_MOD, fd, &event);
+}
+
+void SocketPoller::remove(int fd) {
+  ::epoll_ctl(epollFd_, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+std::span<const SocketPoller::Event> SocketPoller::wait(int timeoutMs) {
+  ready_.resize(1024);
+  const int count = ::epoll_wait(epollFd_, ready_.data(),
+                                 static_cast<int>(ready_.size()), timeoutMs);
+  events_.clear();
+  for (int i = 0; i < count; ++i) {
+    const auto flags = ready_[i].events;
+    events_.push_back({ready_[i].data.fd, (flags & EPOLLIN) != 0,
+                       (flags & EPOLLOUT) != 0,
+                       (flags & (EPOLLHUP | EPOLLERR | EPOLLRDHUP)) != 0});
+  }
+  return events_;
+}
+
+#else
+
+SocketPoller::SocketPoller() = default;
+
+SocketPoller::~SocketPoller() = default;
+
+void SocketPoller::add(int fd, bool writable) {
+  if (fd >= static_cast<int>(slots_.size()))
+    slots_.resize(fd + 1, -1);
+  slots_[fd] = static_cast<int>(fds_.size());
+  fds_.push_back({fd, static_cast<short>(POLLIN | (writable ? POLLOUT : 0)),
+                  0});
+}
+
+void SocketPoller::setWritable(int fd, bool writable) {
+  fds_[slots_[fd]].events =
+      static_cast<short>(POLLIN | (writable ? POLLOUT : 0));
+}
+
+void SocketPoller::remove(int fd) {
+  // Swap the last entry into the removed slot
+  const int slot = slots_[fd];
+  fds_[slot] = fds_.back();
+  slots_[fds_[slot].fd] = slot;
+  fds_.pop_back();
+  slots_[fd] = -1;
+}
+
+std::span<const SocketPoller::Event> SocketPoller::wait(int timeoutMs) {
+  events_.clear();
+  if (::poll(fds_.data(), fds_.size(), timeoutMs) <= 0)
+    return events_;
+  for (const auto &entry : fds_) {
+    if (entry.revents == 0)
+      continue;
+    events_.push_back({entry.fd, (entry.revents & POLLIN) != 0,
+                       (entry.revents & POLLOUT) != 0,
+                       (entry.revents & (POLLHUP | POLLERR | POLLNVAL)) != 0});
+  }
+  return events_;
+}
+
+#endif
+
+bool makeNonBlocking(int fd) {
+  const int flags = ::fcntl(fd, F_GETFL, 0);
+  if (flags < 0 || ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    return false;
+  const int noDelay = 1;
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+  return true;
+}
+
+long raiseFileLimit() {
+  rlimit limit;
+  if (::getrlimit(RLIMIT_NOFILE, &limit) != 0)
+    return -1;
+  limit.rlim_cur = limit.rlim_max;
+#ifdef __APPLE__
+  // macOS rejects RLIM_INFINITY for open files
+  if (limit.rlim_cur > OPEN_MAX)
+    limit.rlim_cur = OPEN_MAX;
+#endif
+  ::setrlimit(RLIMIT_NOFILE, &limit);
+  ::getrlimit(RLIMIT_NOFILE, &limit);
+  return static_cast<long>(limit.rlim_cur);
+}
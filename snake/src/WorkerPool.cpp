@@ -0,0 +1,73 @@
+#include "WorkerPool.hpp"
+
+namespace {
+
+std::size_t chunkBegin(std::size_t count, unsigned int chunk,
+                       unsigned int chunks) {
+  return count * chunk / chunks;
+}
+
+} // namespace
+
+WorkerPool::WorkerPool(unsigned int threads)
+    : threadCount_(threads > 0 ? threads : 1) {
+  for (unsigned int i = 1; i < threadCount_; ++i)
+    workers_.emplace_back([this, i] { workerLoop(i); });
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (auto &worker : workers_)
+    worker.join();
+}
+
+void WorkerPool::parallelFor(
+    std::size_t count,
+    const std::function<void(std::size_t, std::size_t)> &body) {
+  const unsigned int chunks = size();
+  if (chunks == 1 || count < chunks) {
+    body(0, count);
+    return;
+  }
+
+  {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    job_ = &body;
+    count_ = count;
+    pending_ = chunks - 1;
+    ++generation_;
+  }
+  wake_.notify_all();
+
+  body(0, chunkBegin(count, 1, chunks));
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [this] { return pending_ == 0; });
+  job_ = nullptr;
+}
+
+void WorkerPool::workerLoop(unsigned int index) {
+  std::uint64_t seen = 0;
+  const unsigned int chunks = size();
+  while (true) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+    if (stopping_)
+      return;
+    seen = generation_;
+    const auto *job = job_;
+    const std::size_t count = count_;
+    lock.unlock();
+
+    (*job)(chunkBegin(count, index, chunks),
+           chunkBegin(count, index + 1, chunks));
+
+    lock.lock();
+    if (--pending_ == 0)
+      done_.notify_one();
+  }
+}
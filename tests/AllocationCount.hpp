@@ -0,0 +1,15 @@
+#ifndef ALLOCATIONCOUNT_HPP
+#define ALLOCATIONCOUNT_HPP
+
+#include <cstddef>
+
+// Number of calls to the global operator new so far, which
+// ReducerAllocationTest.cpp replaces with a counting version.
+std::size_t allocationCount();
+
+// Steady-state checks of each game's in-place reducer. Each returns the
+// number of allocations made after warming up, which should be zero.
+std::size_t snakeReducerAllocations();
+std::size_t ticTacToeReducerAllocations();
+
+#endif // ALLOCATIONCOUNT_HPP
@@ -0,0 +1,44 @@
+#include "AllocationCount.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+// Checks that ticks and key presses through reduceInPlace and the rvalue
+// reducers of snake and tic-tac-toe allocate nothing once warmed up, by
+// counting every call to the global operator new.
+
+namespace {
+
+std::atomic<std::size_t> allocations{0};
+
+void *countedAllocation(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *memory = std::malloc(size == 0 ? 1 : size))
+    return memory;
+  throw std::bad_alloc();
+}
+
+} // namespace
+
+void *operator new(std::size_t size) { return countedAllocation(size); }
+void *operator new[](std::size_t size) { return countedAllocation(size); }
+void operator delete(void *memory) noexcept { std::free(memory); }
+void operator delete[](void *memory) noexcept { std::free(memory); }
+void operator delete(void *memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void *memory, std::size_t) noexcept {
+  std::free(memory);
+}
+
+std::size_t allocationCount() {
+  return allocations.load(std::memory_order_relaxed);
+}
+
+int main() {
+  const std::size_t snake = snakeReducerAllocations();
+  const std::size_t ticTacToe = ticTacToeReducerAllocations();
+  std::printf("steady-state allocations: snake %zu, tic-tac-toe %zu\n", snake,
+              ticTacToe);
+  return snake == 0 && ticTacToe == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
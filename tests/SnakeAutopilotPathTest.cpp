@@ -0,0 +1,166 @@
+#include "SnakeAutopilot.hpp"
+#include "SnakeState.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include <utility>
+#include <vector>
+
+// Checks the autopilot's path search against a breadth-first search on
+// random snakes: whenever the reward is reachable the first move has to lie
+// on a shortest path to it. On boards with an odd side a step across the
+// antipode leaves the wrapped distance unchanged; on even boards a cell first
+// reached through the deferred bucket has to be reopened when a shorter path
+// to it turns up. Failures of either kind are rare, so the seeds of states
+// that once failed are checked on every run.
+
+namespace {
+
+constexpr std::array<Direction, 4> kDirections = {
+    Direction::Up, Direction::Down, Direction::Left, Direction::Right};
+constexpr int kTrials = 5000;
+
+// A random self-avoiding walk as the body, and a reward on a free cell
+GameState randomState(int rows, int cols, std::mt19937 &rng) {
+  GameState state = initializeGameState(rows, cols, rng());
+  for (std::size_t i = 0; i < state.snake.size(); ++i)
+    releaseCell(state, state.snake[i]);
+  state.snake.clear();
+
+  std::uniform_int_distribution<int> pickCell(0, rows * cols - 1);
+  std::uniform_int_distribution<int> pickLength(3, rows * cols / 3);
+  const int start = pickCell(rng);
+  std::vector<std::pair<int, int>> walk = {{start / cols, start % cols}};
+  std::vector<Direction> steps;
+  occupyCell(state, walk.back());
+  for (int length = pickLength(rng); int(walk.size()) < length;) {
+    std::vector<Direction> moves;
+    for (const Direction move : kDirections)
+      if (!isSnakeCell(state, neighborCell(state, walk.back(), move)))
+        moves.push_back(move);
+    if (moves.empty())
+      break;
+    const Direction move = moves[rng() % moves.size()];
+    walk.push_back(neighborCell(state, walk.back(), move));
+    steps.push_back(move);
+    occupyCell(state, walk.back());
+  }
+  // The walk ends at the head
+  for (auto cell = walk.rbegin(); cell != walk.rend(); ++cell)
+    state.snake.push_back(*cell);
+  state.currentDirection = steps.empty() ? Direction::Right : steps.back();
+  if (!state.freeCells.empty()) {
+    const int reward = state.freeCells[rng() % state.freeCells.size()];
+    state.reward = {reward / cols, reward % cols};
+  }
+  return state;
+}
+
+// Steps from each free cell to the reward over free cells; -1 if unreachable
+std::vector<int> distancesToReward(const GameState &state) {
+  std::vector<int> distance(state.rows * state.cols, -1);
+  std::deque<std::pair<int, int>> queue = {state.reward};
+  distance[state.reward.first * state.cols + state.reward.second] = 0;
+  while (!queue.empty()) {
+    const auto cell = queue.front();
+    queue.pop_front();
+    for (const Direction move : kDirections) {
+      const auto next = neighborCell(state, cell, move);
+      int &nextDistance = distance[next.first * state.cols + next.second];
+      if (nextDistance >= 0 || isSnakeCell(state, next))
+        continue;
+      nextDistance = distance[cell.first * state.cols + cell.second] + 1;
+      queue.push_back(next);
+    }
+  }
+  return distance;
+}
+
+// Returns false, after saying why, if the search disagrees with the BFS on
+// the random state built from `seed`
+bool checkState(SnakeAutopilot &autopilot, int rows, int cols,
+                unsigned int seed, int &paths) {
+  std::mt19937 rng(seed);
+  const GameState state = randomState(rows, cols, rng);
+  if (state.freeCells.empty())
+    return true;
+  const std::vector<int> distance = distancesToReward(state);
+
+  // The shortest path leaves the head through a free neighbour; the cell
+  // behind the head is body, so reversals never qualify
+  int shortest = -1;
+  for (const Direction move : kDirections) {
+    const auto next = neighborCell(state, state.snake.front(), move);
+    const int d = distance[next.first * cols + next.second];
+    if (d >= 0 && !isSnakeCell(state, next) && (shortest < 0 || d < shortest))
+      shortest = d;
+  }
+
+  const Direction move = autopilot.decide(state).direction;
+  const bool found =
+      autopilot.lastStrategy() == SnakeAutopilot::Strategy::Path;
+  if (found != (shortest >= 0)) {
+    std::fprintf(stderr, "%dx%d seed %u: search %s a reachable reward\n", rows,
+                 cols, seed, found ? "reached" : "missed");
+    return false;
+  }
+  if (!found)
+    return true;
+  ++paths;
+  const auto next = neighborCell(state, state.snake.front(), move);
+  const int d = distance[next.first * cols + next.second];
+  if (d != shortest) {
+    std::fprintf(stderr, "%dx%d seed %u: first move leads %d steps from the "
+                 "reward instead of %d\n", rows, cols, seed, d, shortest);
+    return false;
+  }
+  return true;
+}
+
+struct Board {
+  int rows;
+  int cols;
+  // States that once led the search astray, checked on top of the random ones
+  std::vector<unsigned int> seeds;
+};
+
+int checkBoard(const Board &board) {
+  SnakeAutopilot autopilot(board.rows, board.cols, std::chrono::seconds(1));
+  int failures = 0;
+  int paths = 0;
+  std::vector<unsigned int> seeds = board.seeds;
+  for (int trial = 0; trial < kTrials; ++trial)
+    seeds.push_back(static_cast<unsigned int>(trial));
+  for (const unsigned int seed : seeds) {
+    if (!checkState(autopilot, board.rows, board.cols, seed, paths))
+      ++failures;
+  }
+  std::printf("%dx%d: %d paths checked, %d failures\n", board.rows,
+              board.cols, paths, failures);
+  return failures;
+}
+
+} // namespace
+
+int main() {
+  const std::vector<Board> boards = {
+      {25, 25, {}},
+      {7, 9, {}},
+      {24, 25, {}},
+      {25, 24, {}},
+      {24, 24, {5191, 8058, 9719, 21562, 21686, 22802}},
+      {6, 6, {35617, 38113, 39790, 70145, 71476, 88344}},
+      {8, 8, {12682, 14141, 21890, 24915, 29783, 32807}},
+      {10, 10, {7948, 17820, 30750, 34681, 36669, 50557}},
+      {6, 8, {8952, 11361, 12431, 23492, 38425, 47337}},
+      {12, 12, {10183, 13030, 14013, 17798, 23489, 31855}},
+  };
+  int failures = 0;
+  for (const Board &board : boards)
+    failures += checkBoard(board);
+  return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
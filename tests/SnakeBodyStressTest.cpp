@@ -0,0 +1,100 @@
+#include "SnakeState.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+// Grows a snake to 100k segments on a 400x400 board, one reward per tick,
+// and checks that the ring-buffer body, the free-cell index and collision
+// detection stay consistent throughout.
+
+namespace {
+
+constexpr int kRows = 400;
+constexpr int kCols = 400;
+constexpr std::size_t kTargetLength = 100'000;
+
+int failures = 0;
+
+void check(bool condition, const char *what, std::size_t length) {
+  if (condition)
+    return;
+  std::fprintf(stderr, "FAILED at length %zu: %s\n", length, what);
+  ++failures;
+}
+
+// Every cell is either in the body or in the free list, exactly once
+void checkOccupancy(const GameState &state) {
+  const std::size_t length = state.snake.size();
+  check(state.freeCells.size() + length == std::size_t(kRows) * kCols,
+        "free cells and body cover the board", length);
+  for (std::size_t slot = 0; slot < state.freeCells.size(); ++slot)
+    check(state.freeSlot[state.freeCells[slot]] == int(slot),
+          "free list and slots agree", length);
+  std::size_t covered = 0;
+  for (const int slot : state.freeSlot)
+    covered += slot < 0;
+  check(covered == length, "one covered cell per segment", length);
+  for (std::size_t i = 0; i < length; ++i)
+    check(isSnakeCell(state, state.snake[i]), "body cells are covered",
+          length);
+}
+
+} // namespace
+
+int main() {
+  GameState state = initializeGameState(kRows, kCols, 1);
+
+  // Sweep the board row by row, turning down at either edge, with the reward
+  // always on the next cell so the snake grows every tick
+  while (state.snake.size() < kTargetLength && failures == 0) {
+    const auto head = state.snake.front();
+    Direction direction = state.currentDirection;
+    if (direction == Direction::Down)
+      direction = head.second == kCols - 1 ? Direction::Left
+                                           : Direction::Right;
+    else if ((direction == Direction::Right && head.second == kCols - 1) ||
+             (direction == Direction::Left && head.second == 0))
+      direction = Direction::Down;
+    state.reward = neighborCell(state, head, direction);
+
+    const std::size_t length = state.snake.size();
+    reduceInPlace(state, UserDirectionAction{direction});
+    reduceInPlace(state, RequestNextFrameAction{});
+    check(state.status == GameStatus::Running, "the snake is alive", length);
+    check(state.snake.size() == length + 1, "eating grows the snake", length);
+    check(state.snake.front() == neighborCell(state, head, direction),
+          "the head advanced", length);
+    if (state.snake.size() % 10'000 == 0)
+      checkOccupancy(state);
+  }
+  check(state.snake.size() == kTargetLength, "the snake reached its length",
+        state.snake.size());
+  checkOccupancy(state);
+
+  // Rewards now land only on the cells that are left
+  for (int i = 0; i < 1000; ++i) {
+    placeReward(state);
+    check(!isSnakeCell(state, state.reward), "rewards avoid the body",
+          state.snake.size());
+  }
+
+  // The row above the head is all body, so turning into it ends the game
+  // without moving the snake
+  const auto head = state.snake.front();
+  const auto tail = state.snake.back();
+  check(isSnakeCell(state, neighborCell(state, head, Direction::Up)),
+        "the row above the head is body", state.snake.size());
+  reduceInPlace(state, UserDirectionAction{Direction::Up});
+  reduceInPlace(state, RequestNextFrameAction{});
+  check(state.status == GameStatus::GameOver, "running into the body ends "
+        "the game", state.snake.size());
+  check(state.snake.size() == kTargetLength && state.snake.front() == head &&
+            state.snake.back() == tail,
+        "a collision leaves the body as it was", state.snake.size());
+
+  if (failures > 0)
+    return EXIT_FAILURE;
+  std::printf("grew a %zu-segment snake on %dx%d\n", state.snake.size(), kRows,
+              kCols);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,48 @@
+#include "AllocationCount.hpp"
+#include "SnakeState.hpp"
+
+#include <array>
+#include <utility>
+
+namespace {
+
+constexpr int kTicks = 100'000;
+constexpr int kSide = 5;
+
+// Steers a three-segment snake around a 5x5 square, pressing each turn
+// twice so that the second press is dropped as a repeated move
+void step(GameState &state, int tick, bool inPlace) {
+  static constexpr std::array<Direction, 4> kTurns = {
+      Direction::Down, Direction::Left, Direction::Up, Direction::Right};
+  if (tick % kSide == 0) {
+    const UserDirectionAction press{kTurns[(tick / kSide) % kTurns.size()]};
+    if (inPlace) {
+      reduceInPlace(state, press);
+      reduceInPlace(state, press);
+    } else {
+      state = reduce(std::move(state), press);
+      state = reduce(std::move(state), press);
+    }
+  }
+  if (inPlace)
+    reduceInPlace(state, RequestNextFrameAction{});
+  else
+    state = reduce(std::move(state), RequestNextFrameAction{});
+}
+
+} // namespace
+
+std::size_t snakeReducerAllocations() {
+  GameState state = initializeGameState(25, 25, 1);
+  // Off the square, so the snake never eats and never grows
+  state.reward = {0, 0};
+
+  for (int tick = 0; tick < 4 * kSide; ++tick)
+    step(state, tick, true);
+
+  const std::size_t before = allocationCount();
+  for (int tick = 0; tick < kTicks; ++tick)
+    step(state, tick, tick % 2 == 0);
+  const std::size_t allocations = allocationCount() - before;
+  return state.status == GameStatus::Running ? allocations : ~std::size_t(0);
+}
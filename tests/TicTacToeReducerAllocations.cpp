@@ -0,0 +1,35 @@
+#include "AllocationCount.hpp"
+#include "TicTacToeState.hpp"
+
+#include <utility>
+
+namespace {
+
+constexpr int kGames = 100'000;
+
+// Fills the board, with a repeated press on a taken cell, then starts over.
+// Moves alternate between reduceInPlace and reducer(State&&).
+void playGame(State &state) {
+    for (unsigned int index = 0; index < 9; ++index) {
+        if (index % 2 == 0) {
+            reduceInPlace(state, PlaceMarkerAction{index});
+            reduceInPlace(state, PlaceMarkerAction{index});
+        } else {
+            state = reducer(std::move(state), PlaceMarkerAction{index});
+            state = reducer(std::move(state), PlaceMarkerAction{index});
+        }
+    }
+    state = reducer(std::move(state), ResetGameAction{});
+}
+
+} // namespace
+
+std::size_t ticTacToeReducerAllocations() {
+    State state = {std::bitset<9>(), std::bitset<9>(), Player::X};
+    playGame(state);
+
+    const std::size_t before = allocationCount();
+    for (int game = 0; game < kGames; ++game)
+        playGame(state);
+    return allocationCount() - before;
+}
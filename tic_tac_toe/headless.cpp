@@ -0,0 +1,426 @@
+#include "BoardClassifier.hpp"
+#include "MnkBoard.hpp"
+#include "MnkSearch.hpp"
+#include "PerfectPlay.hpp"
+#include "Profiler.hpp"
+#include "TicTacToeState.hpp"
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <vector>
+
+// Benchmarks for the tic-tac-toe rules and AI, without a GUI.
+
+namespace {
+
+struct Options {
+    long long moves = 100'000'000;
+    bool winCheck = false;
+    bool search = false;
+    unsigned int threads = std::max(std::thread::hardware_concurrency(), 1u);
+    int depth = 8;
+    double seconds = 30;
+    bool classify = false;
+    long long boards = 1 << 22;
+};
+
+void printUsage(const char *program) {
+    std::printf("Usage: %s [--moves N] [--win-check] [--search [--threads N] [--depth N] [--seconds S]]\n"
+                "       [--classify [--boards N]]\n",
+                program);
+}
+
+bool parseOptions(int argc, char *argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(arg, "--moves") == 0 && hasValue) {
+            options.moves = std::atoll(argv[++i]);
+        } else if (std::strcmp(arg, "--win-check") == 0) {
+            options.winCheck = true;
+        } else if (std::strcmp(arg, "--classify") == 0) {
+            options.classify = true;
+        } else if (std::strcmp(arg, "--boards") == 0 && hasValue) {
+            options.boards = std::atoll(argv[++i]);
+        } else if (std::strcmp(arg, "--search") == 0) {
+            options.search = true;
+        } else if (std::strcmp(arg, "--threads") == 0 && hasValue) {
+            options.threads = static_cast<unsigned int>(std::atoi(argv[++i]));
+        } else if (std::strcmp(arg, "--depth") == 0 && hasValue) {
+            options.depth = std::atoi(argv[++i]);
+        } else if (std::strcmp(arg, "--seconds") == 0 && hasValue) {
+            options.seconds = std::atof(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+    return options.moves > 0 && options.threads > 0 && options.depth > 0 && options.seconds > 0 &&
+           options.boards > 0;
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool isGameOver(const State& state) {
+    return checkWin(state.xBoard) || checkWin(state.oBoard) || checkTie(state);
+}
+
+// Every position reachable from the empty board where a move is still due
+void collectPositions(const State& state, std::vector<State>& positions, std::vector<bool>& seen) {
+    const int index = positionIndex(state.xBoard.to_ulong(), state.oBoard.to_ulong());
+    if (seen[index] || isGameOver(state))
+        return;
+    seen[index] = true;
+    positions.push_back(state);
+    for (unsigned int cell = 0; cell < 9; ++cell)
+        if (!state.xBoard[cell] && !state.oBoard[cell])
+            collectPositions(reducer(state, PlaceMarkerAction{cell}), positions, seen);
+}
+
+// Plain negamax through the reducer, for comparison with the table
+int searchScore(const State& state) {
+    const int empty = 9 - static_cast<int>((state.xBoard | state.oBoard).count());
+    if (checkWin(state.xBoard) || checkWin(state.oBoard))
+        return -(1 + empty);
+    if (checkTie(state))
+        return 0;
+    int best = -100;
+    for (unsigned int cell = 0; cell < 9; ++cell)
+        if (!state.xBoard[cell] && !state.oBoard[cell])
+            best = std::max(best, -searchScore(reducer(state, PlaceMarkerAction{cell})));
+    return best;
+}
+
+// Times table lookups against a runtime search over every reachable position,
+// checking that both agree on the value of the chosen move.
+int runPerfectPlayBenchmark(const Options& options) {
+    std::vector<State> positions;
+    std::vector<bool> seen(kPerfectPlayPositions);
+    collectPositions({std::bitset<9>(), std::bitset<9>(), Player::X}, positions, seen);
+
+    for (const State& state : positions) {
+        const int move = perfectMove(state);
+        const State next = reducer(state, PlaceMarkerAction{static_cast<unsigned int>(move)});
+        if (-searchScore(next) != searchScore(state)) {
+            std::printf("table move %d is not optimal\n", move);
+            return 1;
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    long long scoreSum = 0;
+    for (const State& state : positions)
+        scoreSum += searchScore(state);
+    const double searchSeconds = secondsSince(start);
+    const auto searched = static_cast<double>(positions.size());
+
+    start = std::chrono::steady_clock::now();
+    unsigned long long checksum = 0;
+    std::size_t next = 0;
+    for (long long i = 0; i < options.moves; ++i) {
+        checksum += perfectMove(positions[next]);
+        if (++next == positions.size())
+            next = 0;
+    }
+    const double lookupSeconds = secondsSince(start);
+
+    std::printf("positions:    %zu reachable with a move due, all optimal\n", positions.size());
+    std::printf("search:       %.0f moves/s (%.1f us/move, checksum %lld)\n",
+                searched / searchSeconds, searchSeconds * 1e6 / searched, scoreSum);
+    std::printf("table lookup: %.0f moves/s (%.2f ns/move, checksum %llu)\n",
+                options.moves / lookupSeconds, lookupSeconds * 1e9 / options.moves, checksum);
+    return 0;
+}
+
+// K in a row by walking out from every cell, as a reference for the bitboards
+template <int Rows, int Cols, int K>
+bool scanForWin(const MnkBitboard<Rows, Cols>& board) {
+    constexpr int kSteps[4][2] = {{0, 1}, {1, 0}, {1, 1}, {1, -1}};
+    for (int row = 0; row < Rows; ++row) {
+        for (int col = 0; col < Cols; ++col) {
+            for (const auto& step : kSteps) {
+                int run = 0;
+                int r = row;
+                int c = col;
+                while (run < K && r >= 0 && r < Rows && c >= 0 && c < Cols && board.test(r * Cols + c)) {
+                    ++run;
+                    r += step[0];
+                    c += step[1];
+                }
+                if (run == K)
+                    return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Random games played to the end, as move lists
+template <int Rows, int Cols, int K>
+std::vector<std::vector<int>> randomGames(int count) {
+    std::mt19937 rng(42);
+    std::vector<std::vector<int>> games(count);
+    std::vector<int> order(Rows * Cols);
+    for (auto& game : games) {
+        std::iota(order.begin(), order.end(), 0);
+        std::shuffle(order.begin(), order.end(), rng);
+        MnkState<Rows, Cols, K> state;
+        for (const int cell : order) {
+            state = reducer(std::move(state), PlaceMarkerAction{static_cast<unsigned int>(cell)});
+            game.push_back(cell);
+            if (state.gameOver())
+                break;
+        }
+    }
+    return games;
+}
+
+// Seconds to replay every game `passes` times, calling `check` after each
+// stone and counting how often it returns true
+template <typename Board, typename Check>
+double replayGames(const std::vector<std::vector<int>>& games, long long passes, long long& hits, Check check) {
+    const auto start = std::chrono::steady_clock::now();
+    for (long long pass = 0; pass < passes; ++pass) {
+        for (const auto& game : games) {
+            Board boards[2];
+            for (std::size_t move = 0; move < game.size(); ++move) {
+                Board& board = boards[move & 1];
+                board.set(game[move]);
+                hits += check(board, game[move]);
+            }
+        }
+    }
+    return secondsSince(start);
+}
+
+// Times the incremental and full-board checks per move over random games.
+// Returns false if either ever disagrees with a cell-by-cell scan.
+template <int Rows, int Cols, int K>
+bool benchmarkWinCheck(long long minMoves) {
+    using Board = MnkBitboard<Rows, Cols>;
+    const auto games = randomGames<Rows, Cols, K>(256);
+    long long movesPerPass = 0;
+    for (const auto& game : games)
+        movesPerPass += static_cast<long long>(game.size());
+    const long long passes = std::max(1LL, minMoves / movesPerPass);
+
+    for (const auto& game : games) {
+        Board boards[2];
+        for (std::size_t move = 0; move < game.size(); ++move) {
+            Board& board = boards[move & 1];
+            board.set(game[move]);
+            const bool expected = scanForWin<Rows, Cols, K>(board);
+            if (board.template winsThrough<K>(game[move]) != expected || board.template hasWin<K>() != expected) {
+                std::printf("%dx%d k=%d: win check disagrees with scan\n", Rows, Cols, K);
+                return false;
+            }
+        }
+    }
+
+    // Placing stones alone, then with each check on top
+    long long wins[3] = {};
+    const double seconds[3] = {
+        replayGames<Board>(games, passes, wins[0], [](const Board& board, int cell) { return board.test(cell); }),
+        replayGames<Board>(games, passes, wins[1],
+                           [](const Board& board, int cell) { return board.template winsThrough<K>(cell); }),
+        replayGames<Board>(games, passes, wins[2],
+                           [](const Board& board, int) { return board.template hasWin<K>(); }),
+    };
+
+    const double moves = static_cast<double>(passes * movesPerPass);
+    const auto nsPerMove = [&](int mode) { return std::max(0.0, seconds[mode] - seconds[0]) * 1e9 / moves; };
+    std::printf("%2dx%-2d k=%d  %2d words  incremental %6.2f ns/move  full board %7.2f ns/move  (%.0f moves, %lld wins)\n",
+                Rows, Cols, K, Board::Geometry::kWords, nsPerMove(1), nsPerMove(2), moves, wins[1]);
+    return wins[1] == wins[2];
+}
+
+// The classic game's mask check on the same 3x3 games, for comparison
+void benchmarkClassicWinCheck(long long minMoves) {
+    const auto games = randomGames<3, 3, 3>(256);
+    long long movesPerPass = 0;
+    for (const auto& game : games)
+        movesPerPass += static_cast<long long>(game.size());
+    const long long passes = std::max(1LL, minMoves / movesPerPass);
+
+    using Board = std::bitset<9>;
+    long long wins = 0;
+    const double seconds[2] = {
+        replayGames<Board>(games, passes, wins, [](const Board& board, int cell) { return board[cell]; }),
+        replayGames<Board>(games, passes, wins, [](const Board& board, int) { return checkWin(board); }),
+    };
+    const double moves = static_cast<double>(passes * movesPerPass);
+    std::printf(" 3x3  classic bitset<9> masks  %6.2f ns/move\n",
+                std::max(0.0, seconds[1] - seconds[0]) * 1e9 / moves);
+}
+
+int runWinCheckBenchmark(const Options& options) {
+    const long long moves = std::min(options.moves, 20'000'000LL);
+    const bool agreed = benchmarkWinCheck<3, 3, 3>(moves) && benchmarkWinCheck<15, 15, 5>(moves) &&
+                        benchmarkWinCheck<19, 19, 5>(moves);
+    benchmarkClassicWinCheck(moves);
+    return agreed ? 0 : 1;
+}
+
+int outcome(int score) {
+    return (score > 0) - (score < 0);
+}
+
+// The search on the 3x3 engine must agree with the plain search on whether
+// every reachable position is won, drawn or lost, and pick a move that keeps
+// it so. It may find a slower win than the fastest one.
+bool checkSearchOnClassicBoard() {
+    std::vector<State> positions;
+    std::vector<bool> seen(kPerfectPlayPositions);
+    collectPositions({std::bitset<9>(), std::bitset<9>(), Player::X}, positions, seen);
+    TranspositionTable table(1);
+    for (const State& position : positions) {
+        const SearchResult result = searchBestMove(toMnkState(position), {}, table);
+        const int expected = outcome(searchScore(position));
+        const State next = reducer(position, PlaceMarkerAction{static_cast<unsigned int>(result.move)});
+        if (outcome(result.score) != expected || outcome(-searchScore(next)) != expected) {
+            std::printf("search disagrees on a 3x3 position\n");
+            return false;
+        }
+    }
+    std::printf("3x3:   search agrees with minimax on %zu positions\n", positions.size());
+    return true;
+}
+
+// Times the same gomoku position to a fixed depth on 1..N threads
+int runSearchBenchmark(const Options& options) {
+    if (!checkSearchOnClassicBoard())
+        return 1;
+
+    GomokuState root;
+    for (const unsigned int cell : {112u, 128u, 114u, 96u, 142u, 100u})
+        root = reducer(std::move(root), PlaceMarkerAction{cell});
+
+    SearchLimits limits;
+    limits.maxDepth = options.depth;
+    limits.timeLimit = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(options.seconds));
+    TranspositionTable table(64);
+    std::printf("15x15: %u threads max, depth %d, %zu table slots\n", options.threads, options.depth, table.slots());
+    for (unsigned int threads = 1; threads <= options.threads; ++threads) {
+        table.clear();
+        limits.threads = threads;
+        const SearchResult result = searchBestMove(root, limits, table);
+        std::printf("threads %2u  depth %2d  move %3d  score %6d  %10llu nodes  %9.0f nodes/s  to depth:", threads,
+                    result.depth, result.move, result.score, static_cast<unsigned long long>(result.nodes),
+                    result.nodes / result.seconds);
+        for (const double seconds : result.depthSeconds)
+            std::printf(" %.3f", seconds);
+        std::printf(" s\n");
+    }
+    return 0;
+}
+
+// Class from the per-board rules the widget uses
+BoardClass referenceClass(unsigned int xBoard, unsigned int oBoard) {
+    const State state{std::bitset<9>(xBoard), std::bitset<9>(oBoard), Player::X};
+    if (checkWin(state.xBoard))
+        return BoardClass::XWins;
+    if (checkWin(state.oBoard))
+        return BoardClass::OWins;
+    return checkTie(state) ? BoardClass::Tie : BoardClass::Ongoing;
+}
+
+// Checks every kernel on all 512 x 512 board pairs, then times each on
+// random positions
+int runClassifyBenchmark(const Options& options) {
+    const ClassifierKernel kernels[] = {ClassifierKernel::Scalar, ClassifierKernel::Sse2, ClassifierKernel::Avx2};
+    {
+        std::vector<std::uint16_t> xBoards;
+        std::vector<std::uint16_t> oBoards;
+        std::vector<BoardClass> expected;
+        for (unsigned int x = 0; x < 512; ++x) {
+            for (unsigned int o = 0; o < 512; ++o) {
+                xBoards.push_back(static_cast<std::uint16_t>(x));
+                oBoards.push_back(static_cast<std::uint16_t>(o));
+                expected.push_back(referenceClass(x, o));
+            }
+        }
+        std::vector<BoardClass> classes(expected.size());
+        for (const ClassifierKernel kernel : kernels) {
+            if (!classifierKernelSupported(kernel))
+                continue;
+            // Not a BoardClass, so a board the kernel skips cannot pass with the
+            // previous kernel's result, and one it writes past the end shows
+            std::fill(classes.begin(), classes.end(), static_cast<BoardClass>(0xff));
+            // Odd length to cover the scalar tail of the vector kernels
+            classifyBoards(std::span(xBoards).first(xBoards.size() - 7), oBoards, classes, kernel);
+            if (!std::equal(classes.begin(), classes.end() - 7, expected.begin()) ||
+                std::any_of(classes.end() - 7, classes.end(),
+                            [](BoardClass c) { return c != static_cast<BoardClass>(0xff); })) {
+                std::printf("%s classifier disagrees with checkWin/checkTie\n", classifierKernelName(kernel));
+                return 1;
+            }
+        }
+    }
+
+    const auto count = static_cast<std::size_t>(options.boards);
+    std::vector<std::uint16_t> xBoards(count);
+    std::vector<std::uint16_t> oBoards(count);
+    std::mt19937 rng(7);
+    std::uniform_int_distribution<int> digit(0, 2);
+    for (std::size_t i = 0; i < count; ++i) {
+        for (int cell = 0; cell < 9; ++cell) {
+            const int value = digit(rng);
+            xBoards[i] |= static_cast<std::uint16_t>((value == 1) << cell);
+            oBoards[i] |= static_cast<std::uint16_t>((value == 2) << cell);
+        }
+    }
+    std::vector<BoardClass> classes(count);
+    const int passes = static_cast<int>(std::max(1LL, 100'000'000LL / options.boards));
+    const double boards = static_cast<double>(count) * passes;
+
+    const auto checksum = [&] {
+        unsigned long long sum = 0;
+        for (const BoardClass boardClass : classes)
+            sum += static_cast<unsigned int>(boardClass);
+        return sum;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < passes; ++pass)
+        for (std::size_t i = 0; i < count; ++i)
+            classes[i] = referenceClass(xBoards[i], oBoards[i]);
+    double elapsed = secondsSince(start);
+    std::printf("%-22s %8.1f M boards/s (checksum %llu)\n", "checkWin/checkTie", boards / elapsed / 1e6, checksum());
+
+    for (const ClassifierKernel kernel : kernels) {
+        if (!classifierKernelSupported(kernel))
+            continue;
+        start = std::chrono::steady_clock::now();
+        for (int pass = 0; pass < passes; ++pass)
+            classifyBoards(xBoards, oBoards, classes, kernel);
+        elapsed = secondsSince(start);
+        std::printf("%-22s %8.1f M boards/s (checksum %llu)%s\n", classifierKernelName(kernel), boards / elapsed / 1e6,
+                    checksum(), kernel == bestClassifierKernel() ? "  <- dispatched" : "");
+    }
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    profiler::initFromEnvironment();
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (options.search)
+        return runSearchBenchmark(options);
+    if (options.classify)
+        return runClassifyBenchmark(options);
+    return options.winCheck ? runWinCheckBenchmark(options) : runPerfectPlayBenchmark(options);
+}
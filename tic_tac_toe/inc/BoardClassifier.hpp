@@ -0,0 +1,38 @@
+#ifndef BOARDCLASSIFIER_HPP
+#define BOARDCLASSIFIER_HPP
+
+#include <cstdint>
+#include <span>
+
+#include "TicTacToeState.hpp"
+
+// Classifies large batches of 3x3 positions at once. Boards are packed as in
+// std::bitset<9>::to_ulong(), X and O in two parallel arrays. Results match
+// checkWin on each board and then checkTie, with X checked first.
+
+enum class BoardClass : std::uint8_t { Ongoing, XWins, OWins, Tie };
+
+enum class ClassifierKernel { Scalar, Sse2, Avx2 };
+
+constexpr BoardClass classifyBoard(unsigned int xBoard, unsigned int oBoard) {
+    if (checkWinMask(xBoard))
+        return BoardClass::XWins;
+    if (checkWinMask(oBoard))
+        return BoardClass::OWins;
+    return checkTieMask(xBoard, oBoard) ? BoardClass::Tie : BoardClass::Ongoing;
+}
+
+// The fastest kernel this CPU supports, detected on first use. SSE2 and AVX2
+// are only built for x86; elsewhere this is the scalar kernel.
+ClassifierKernel bestClassifierKernel();
+bool classifierKernelSupported(ClassifierKernel kernel);
+const char* classifierKernelName(ClassifierKernel kernel);
+
+// Classifies min(xBoards.size(), oBoards.size(), classes.size()) boards with
+// the best kernel, or with `kernel` if it is supported.
+void classifyBoards(std::span<const std::uint16_t> xBoards, std::span<const std::uint16_t> oBoards,
+                    std::span<BoardClass> classes);
+void classifyBoards(std::span<const std::uint16_t> xBoards, std::span<const std::uint16_t> oBoards,
+                    std::span<BoardClass> classes, ClassifierKernel kernel);
+
+#endif // BOARDCLASSIFIER_HPP
@@ -0,0 +1,262 @@
+#ifndef MNKBOARD_HPP
+#define MNKBOARD_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+#include <variant>
+
+#include "TicTacToeState.hpp"
+
+// Generalized m,n,k games (k in a row on a Rows x Cols board, e.g. 15x15
+// gomoku with k = 5) on multi-word bitboards, driven by the same Action
+// variant and reducer interface as the classic game.
+//
+// Every board is stored four times, once per line direction, laid out so
+// that each row, column or diagonal is a contiguous run of bits followed by
+// an always-clear guard bit. A line through any cell is then a bit window
+// that can be tested with shift-and-mask, and the guards stop runs from
+// wrapping onto the next line. Clear padding before the first line and a
+// spare word after the last let any window be read without bounds checks.
+
+enum LineDirection { kHorizontal, kVertical, kDiagonal, kAntiDiagonal, kLineDirections };
+
+template <int Rows, int Cols>
+struct MnkGeometry {
+    static constexpr int kCells = Rows * Cols;
+    // Longest window is 63 bits, which reaches at most 31 bits before a cell
+    static constexpr int kPadding = 32;
+    static constexpr int kDiagonalBits = kCells + Rows + Cols - 1;
+    static constexpr int kBits = kPadding + std::max({Rows * (Cols + 1), Cols * (Rows + 1), kDiagonalBits});
+    static constexpr int kWords = (kBits + 63) / 64 + 1;
+
+    // Bit index of every cell in each of the four layouts
+    static constexpr auto kBitIndex = [] {
+        std::array<std::array<std::uint16_t, kLineDirections>, kCells> index{};
+        // Start of each diagonal, which vary in length
+        std::array<int, Rows + Cols - 1> diagonalStart{};
+        std::array<int, Rows + Cols - 1> antiDiagonalStart{};
+        int diagonalOffset = kPadding;
+        int antiDiagonalOffset = kPadding;
+        for (int d = 0; d < Rows + Cols - 1; ++d) {
+            diagonalStart[d] = diagonalOffset;
+            antiDiagonalStart[d] = antiDiagonalOffset;
+            // Both families have the same length for the same d
+            const int length = std::min({d + 1, Rows, Cols, Rows + Cols - 1 - d});
+            diagonalOffset += length + 1;
+            antiDiagonalOffset += length + 1;
+        }
+        for (int row = 0; row < Rows; ++row) {
+            for (int col = 0; col < Cols; ++col) {
+                auto& bits = index[row * Cols + col];
+                bits[kHorizontal] = static_cast<std::uint16_t>(kPadding + row * (Cols + 1) + col);
+                bits[kVertical] = static_cast<std::uint16_t>(kPadding + col * (Rows + 1) + row);
+                const int diagonal = row - col + Cols - 1;
+                bits[kDiagonal] = static_cast<std::uint16_t>(diagonalStart[diagonal] + std::min(row, col));
+                const int antiDiagonal = row + col;
+                bits[kAntiDiagonal] = static_cast<std::uint16_t>(
+                    antiDiagonalStart[antiDiagonal] + row - std::max(0, antiDiagonal - (Cols - 1)));
+            }
+        }
+        return index;
+    }();
+};
+
+template <int Rows, int Cols>
+class MnkBitboard {
+public:
+    using Geometry = MnkGeometry<Rows, Cols>;
+    using Words = std::array<std::uint64_t, Geometry::kWords>;
+
+    bool test(int cell) const {
+        const int bit = Geometry::kBitIndex[cell][kHorizontal];
+        return layouts_[kHorizontal][bit >> 6] >> (bit & 63) & 1;
+    }
+
+    void set(int cell) {
+        for (int direction = 0; direction < kLineDirections; ++direction) {
+            const int bit = Geometry::kBitIndex[cell][direction];
+            layouts_[direction][bit >> 6] |= std::uint64_t(1) << (bit & 63);
+        }
+    }
+
+    void reset() { layouts_ = {}; }
+
+    int count() const {
+        int stones = 0;
+        for (const std::uint64_t word : layouts_[kHorizontal])
+            stones += std::popcount(word);
+        return stones;
+    }
+
+    // K in a row on one of the four lines through `cell`. Only a window of
+    // 2K - 1 bits around the cell is examined in each direction.
+    template <int K>
+    bool winsThrough(int cell) const {
+        static_assert(K >= 1 && 2 * K - 1 < 64, "line window must fit in a word");
+        // No early exit: the four lines are cheaper than a mispredicted branch
+        std::uint64_t runs = 0;
+        for (int direction = 0; direction < kLineDirections; ++direction) {
+            const int bit = Geometry::kBitIndex[cell][direction];
+            runs |= runOf<K>(extract(layouts_[direction], bit - (K - 1), 2 * K - 1));
+        }
+        return runs != 0;
+    }
+
+    // K in a row anywhere, by shift-and-mask across the whole board.
+    template <int K>
+    bool hasWin() const {
+        for (const Words& words : layouts_) {
+            Words run = words;
+            for (int shift = 1; shift < K; ++shift) {
+                const Words shifted = shiftRight(words, shift);
+                for (int i = 0; i < Geometry::kWords; ++i)
+                    run[i] &= shifted[i];
+            }
+            if (std::any_of(run.begin(), run.end(), [](std::uint64_t word) { return word != 0; }))
+                return true;
+        }
+        return false;
+    }
+
+    // Places where a run of each length from 1 to MaxLength starts, over all
+    // four directions, e.g. for evaluating positions
+    template <int MaxLength>
+    std::array<int, MaxLength> runCounts() const {
+        std::array<int, MaxLength> counts{};
+        for (const Words& words : layouts_) {
+            Words run = words;
+            for (int length = 1; length <= MaxLength; ++length) {
+                for (const std::uint64_t word : run)
+                    counts[length - 1] += std::popcount(word);
+                if (length < MaxLength) {
+                    const Words shifted = shiftRight(words, length);
+                    for (int i = 0; i < Geometry::kWords; ++i)
+                        run[i] &= shifted[i];
+                }
+            }
+        }
+        return counts;
+    }
+
+    const Words& layout(LineDirection direction) const { return layouts_[direction]; }
+
+    friend bool operator==(const MnkBitboard&, const MnkBitboard&) = default;
+
+private:
+    // Bits that start K set bits in a row
+    template <int K>
+    static std::uint64_t runOf(std::uint64_t window) {
+        std::uint64_t run = window;
+        for (int shift = 1; shift < K; ++shift)
+            run &= window >> shift;
+        return run;
+    }
+
+    // `width` bits starting at `start`, which the padding keeps in bounds
+    static std::uint64_t extract(const Words& words, int start, int width) {
+        const int word = start >> 6;
+        const int offset = start & 63;
+        // Split shift so that offset 0 does not shift by 64
+        const std::uint64_t bits = words[word] >> offset | (words[word + 1] << 1) << (63 - offset);
+        return bits & ((std::uint64_t(1) << width) - 1);
+    }
+
+    static Words shiftRight(const Words& words, int shift) {
+        Words shifted{};
+        for (int i = 0; i + 1 < Geometry::kWords; ++i)
+            shifted[i] = words[i] >> shift | words[i + 1] << (64 - shift);
+        return shifted;
+    }
+
+    std::array<Words, kLineDirections> layouts_{};
+};
+
+template <int Rows, int Cols, int K>
+struct MnkState {
+    static constexpr int kRows = Rows;
+    static constexpr int kCols = Cols;
+    static constexpr int kInARow = K;
+    static constexpr int kCells = Rows * Cols;
+
+    MnkBitboard<Rows, Cols> xBoard;
+    MnkBitboard<Rows, Cols> oBoard;
+    Player currentPlayer = Player::X;
+    // Set by the move that completes a line; later moves are ignored
+    Player winner = Player::None;
+    int moves = 0;
+
+    bool occupied(int cell) const { return xBoard.test(cell) || oBoard.test(cell); }
+    bool gameOver() const { return winner != Player::None || moves == kCells; }
+};
+
+using GomokuState = MnkState<15, 15, 5>;
+
+// The classic game's position on the 3x3 engine
+inline MnkState<3, 3, 3> toMnkState(const State& classic) {
+    MnkState<3, 3, 3> state;
+    for (int cell = 0; cell < 9; ++cell) {
+        if (classic.xBoard[cell])
+            state.xBoard.set(cell);
+        else if (classic.oBoard[cell])
+            state.oBoard.set(cell);
+        else
+            continue;
+        ++state.moves;
+    }
+    state.currentPlayer = classic.currentPlayer;
+    if (checkWin(classic.xBoard))
+        state.winner = Player::X;
+    else if (checkWin(classic.oBoard))
+        state.winner = Player::O;
+    return state;
+}
+
+template <int Rows, int Cols, int K>
+bool checkWin(const MnkState<Rows, Cols, K>& state) {
+    return state.winner != Player::None;
+}
+
+template <int Rows, int Cols, int K>
+bool checkTie(const MnkState<Rows, Cols, K>& state) {
+    return state.winner == Player::None && state.moves == state.kCells;
+}
+
+// Applies an action in place. A placed stone only has the lines through it
+// checked for a win.
+template <int Rows, int Cols, int K>
+void reduceInPlace(MnkState<Rows, Cols, K>& state, const Action& action) {
+    std::visit([&state](auto&& act) {
+        using T = std::decay_t<decltype(act)>;
+        if constexpr (std::is_same_v<T, PlaceMarkerAction>) {
+            const int cell = static_cast<int>(act.index);
+            if (cell >= state.kCells || state.occupied(cell) || state.winner != Player::None)
+                return;
+            auto& board = state.currentPlayer == Player::X ? state.xBoard : state.oBoard;
+            board.set(cell);
+            ++state.moves;
+            if (board.template winsThrough<K>(cell))
+                state.winner = state.currentPlayer;
+            state.currentPlayer = state.currentPlayer == Player::X ? Player::O : Player::X;
+        } else if constexpr (std::is_same_v<T, ResetGameAction>) {
+            state = MnkState<Rows, Cols, K>{};
+        }
+    }, action);
+}
+
+template <int Rows, int Cols, int K>
+MnkState<Rows, Cols, K> reducer(const MnkState<Rows, Cols, K>& state, const Action& action) {
+    MnkState<Rows, Cols, K> newState = state;
+    reduceInPlace(newState, action);
+    return newState;
+}
+
+template <int Rows, int Cols, int K>
+MnkState<Rows, Cols, K> reducer(MnkState<Rows, Cols, K>&& state, const Action& action) {
+    reduceInPlace(state, action);
+    return state;
+}
+
+#endif // MNKBOARD_HPP
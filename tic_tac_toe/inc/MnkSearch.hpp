@@ -0,0 +1,339 @@
+#ifndef MNKSEARCH_HPP
+#define MNKSEARCH_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "MnkBoard.hpp"
+#include "TranspositionTable.hpp"
+
+// Alpha-beta search for m,n,k games, for boards too large for a lookup table.
+// Iterative deepening on every thread, sharing one transposition table
+// (Lazy SMP): helper threads start at staggered depths and fill the table
+// with results the main thread then finds. Children are produced through the
+// reducer, and positions are keyed by incrementally updated Zobrist hashes.
+
+struct SearchLimits {
+    int maxDepth = 64;
+    // Searching stops once this has passed, keeping the last completed depth
+    std::chrono::steady_clock::duration timeLimit = std::chrono::seconds(5);
+    unsigned int threads = 1;
+};
+
+struct SearchResult {
+    // Best cell for the player to move, or -1 if the game is over
+    int move = -1;
+    // From the mover's point of view; wins score kSearchWinScore - plies
+    int score = 0;
+    int depth = 0;
+    std::uint64_t nodes = 0;
+    double seconds = 0;
+    // Seconds from the start until each depth completed on the main thread
+    std::vector<double> depthSeconds;
+};
+
+constexpr int kSearchWinScore = 30000;
+constexpr int kSearchMaxPly = 512;
+
+// Random keys for each cell and player, plus one for the side to move
+template <int Cells>
+constexpr auto kZobristKeys = [] {
+    std::array<std::array<std::uint64_t, Cells>, 2> keys{};
+    std::uint64_t seed = 0x9e3779b97f4a7c15ull;
+    for (auto& player : keys) {
+        for (auto& key : player) {
+            // splitmix64
+            std::uint64_t z = (seed += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            key = z ^ (z >> 31);
+        }
+    }
+    return keys;
+}();
+
+constexpr std::uint64_t kZobristSideKey = 0xd1b54a32d192ed03ull;
+
+template <int Rows, int Cols, int K>
+std::uint64_t zobristHash(const MnkState<Rows, Cols, K>& state) {
+    const auto& keys = kZobristKeys<Rows * Cols>;
+    std::uint64_t hash = state.currentPlayer == Player::O ? kZobristSideKey : 0;
+    for (int cell = 0; cell < Rows * Cols; ++cell) {
+        if (state.xBoard.test(cell))
+            hash ^= keys[0][cell];
+        else if (state.oBoard.test(cell))
+            hash ^= keys[1][cell];
+    }
+    return hash;
+}
+
+namespace search_detail {
+
+// Shared between the threads of one search
+struct SearchControl {
+    TranspositionTable& table;
+    std::chrono::steady_clock::time_point deadline;
+    std::atomic<bool> stop{false};
+};
+
+template <int Rows, int Cols, int K>
+class SearchWorker {
+public:
+    using State = MnkState<Rows, Cols, K>;
+    using Board = MnkBitboard<Rows, Cols>;
+    using Words = typename Board::Words;
+    using Geometry = typename Board::Geometry;
+
+    SearchWorker(SearchControl& control, unsigned int id) : control_(control), id_(id) {}
+
+    // Iterative deepening until maxDepth, a proven result or a stop. Only the
+    // main thread (id 0) stops the others and reports.
+    void run(const State& root, int maxDepth, SearchResult* result,
+             std::chrono::steady_clock::time_point start) {
+        const std::uint64_t hash = zobristHash(root);
+        for (int depth = 1 + static_cast<int>(id_ & 1); depth <= maxDepth; ++depth) {
+            rootMove_ = -1;
+            const int score = negamax(root, hash, depth, 0, -kSearchWinScore - 1, kSearchWinScore + 1);
+            if (control_.stop.load(std::memory_order_relaxed))
+                break;
+            if (result) {
+                result->move = rootMove_;
+                result->score = score;
+                result->depth = depth;
+                result->depthSeconds.push_back(
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+            }
+            if (std::abs(score) >= kSearchWinScore - kSearchMaxPly || depth >= State::kCells - root.moves)
+                break;
+        }
+        if (result)
+            control_.stop.store(true, std::memory_order_relaxed);
+    }
+
+    std::uint64_t nodes() const { return nodes_; }
+
+private:
+    // Small boards try every empty cell; larger ones only cells next to a
+    // stone, the usual restriction for gomoku
+    static constexpr bool kAllCells = Rows * Cols <= 36;
+
+    int negamax(const State& state, std::uint64_t hash, int depth, int ply, int alpha, int beta) {
+        if ((++nodes_ & 1023) == 0 && std::chrono::steady_clock::now() >= control_.deadline)
+            control_.stop.store(true, std::memory_order_relaxed);
+        if (control_.stop.load(std::memory_order_relaxed))
+            return 0;
+        // The previous move decided the game
+        if (state.winner != Player::None)
+            return -(kSearchWinScore - ply);
+        if (state.moves == State::kCells)
+            return 0;
+        if (depth == 0 || ply >= kSearchMaxPly)
+            return evaluate(state);
+
+        int ttMove = -1;
+        TranspositionEntry entry;
+        if (control_.table.probe(hash, entry)) {
+            ttMove = entry.move;
+            if (entry.depth >= depth && ply > 0) {
+                const int score = fromTable(entry.score, ply);
+                if (entry.bound == Bound::Exact || (entry.bound == Bound::Lower && score >= beta) ||
+                    (entry.bound == Bound::Upper && score <= alpha))
+                    return score;
+            }
+        }
+
+        std::array<int, State::kCells> moves;
+        const int count = generateMoves(state, ttMove, moves);
+        const int originalAlpha = alpha;
+        const auto& keys = kZobristKeys<Rows * Cols>;
+        const int player = state.currentPlayer == Player::X ? 0 : 1;
+        int best = -kSearchWinScore - 1;
+        int bestMove = -1;
+        for (int i = 0; i < count; ++i) {
+            const int cell = moves[i];
+            const State child = reducer(state, PlaceMarkerAction{static_cast<unsigned int>(cell)});
+            const int score =
+                -negamax(child, hash ^ keys[player][cell] ^ kZobristSideKey, depth - 1, ply + 1, -beta, -alpha);
+            if (control_.stop.load(std::memory_order_relaxed))
+                return 0;
+            if (score > best) {
+                best = score;
+                bestMove = cell;
+            }
+            if (score > alpha) {
+                alpha = score;
+                if (alpha >= beta) {
+                    history_[cell] += depth * depth;
+                    break;
+                }
+            }
+        }
+        if (ply == 0)
+            rootMove_ = bestMove;
+
+        entry.move = bestMove;
+        entry.score = toTable(best, ply);
+        entry.depth = depth;
+        entry.bound = best <= originalAlpha ? Bound::Upper : best >= beta ? Bound::Lower : Bound::Exact;
+        control_.table.store(hash, entry);
+        return best;
+    }
+
+    // Candidate cells, table move first and the rest by history score. Each
+    // thread breaks ties differently so Lazy SMP threads diverge.
+    int generateMoves(const State& state, int ttMove, std::array<int, State::kCells>& moves) const {
+        int count = 0;
+        if constexpr (kAllCells) {
+            for (int cell = 0; cell < State::kCells; ++cell)
+                if (!state.occupied(cell))
+                    moves[count++] = cell;
+        } else {
+            const Words candidates = candidateBits(state);
+            for (int i = 0; i < Geometry::kWords; ++i) {
+                for (std::uint64_t word = candidates[i]; word != 0; word &= word - 1) {
+                    const int bit = i * 64 + std::countr_zero(word) - Geometry::kPadding;
+                    moves[count++] = bit / (Cols + 1) * Cols + bit % (Cols + 1);
+                }
+            }
+            // Opening move in the centre
+            if (count == 0 && state.moves == 0)
+                moves[count++] = Rows / 2 * Cols + Cols / 2;
+        }
+        const int rotate = static_cast<int>(id_) % std::max(count, 1);
+        std::rotate(moves.begin(), moves.begin() + rotate, moves.begin() + count);
+        std::stable_sort(moves.begin(), moves.begin() + count, [&](int a, int b) {
+            if ((a == ttMove) != (b == ttMove))
+                return a == ttMove;
+            return history_[a] > history_[b];
+        });
+        return count;
+    }
+
+    // Empty cells next to a stone, by dilating the row-major layout. Guard
+    // bits keep the shifts from wrapping between rows.
+    static Words candidateBits(const State& state) {
+        Words occupied;
+        const Words& x = state.xBoard.layout(kHorizontal);
+        const Words& o = state.oBoard.layout(kHorizontal);
+        for (int i = 0; i < Geometry::kWords; ++i)
+            occupied[i] = x[i] | o[i];
+        Words rows = occupied;
+        orShifted(rows, occupied, 1);
+        orShifted(rows, occupied, -1);
+        Words near = rows;
+        orShifted(near, rows, Cols + 1);
+        orShifted(near, rows, -(Cols + 1));
+        for (int i = 0; i < Geometry::kWords; ++i)
+            near[i] &= ~occupied[i] & kCellMask[i];
+        return near;
+    }
+
+    // target |= words shifted towards higher bits by `shift` (lower if negative)
+    static void orShifted(Words& target, const Words& words, int shift) {
+        const int wordShift = std::abs(shift) / 64;
+        const int bitShift = std::abs(shift) % 64;
+        for (int i = 0; i < Geometry::kWords; ++i) {
+            const int from = shift > 0 ? i - wordShift : i + wordShift;
+            const int carry = shift > 0 ? from - 1 : from + 1;
+            const auto at = [&](int index) { return index >= 0 && index < Geometry::kWords ? words[index] : 0; };
+            if (bitShift == 0)
+                target[i] |= at(from);
+            else if (shift > 0)
+                target[i] |= at(from) << bitShift | at(carry) >> (64 - bitShift);
+            else
+                target[i] |= at(from) >> bitShift | at(carry) << (64 - bitShift);
+        }
+    }
+
+    static constexpr Words kCellMask = [] {
+        Words mask{};
+        for (const auto& bits : Geometry::kBitIndex)
+            mask[bits[kHorizontal] / 64] |= std::uint64_t(1) << (bits[kHorizontal] % 64);
+        return mask;
+    }();
+
+    // Runs of two or more stones, longer runs weighted higher, from the
+    // mover's point of view
+    static int evaluate(const State& state) {
+        const auto x = state.xBoard.template runCounts<K>();
+        const auto o = state.oBoard.template runCounts<K>();
+        int score = 0;
+        int weight = 1;
+        for (int length = 2; length < K; ++length, weight *= 8)
+            score += weight * (x[length - 1] - o[length - 1]);
+        score = std::clamp(score, -kSearchWinScore / 2, kSearchWinScore / 2);
+        return state.currentPlayer == Player::X ? score : -score;
+    }
+
+    // Win scores count plies from the root; the table holds them relative to
+    // the stored position
+    static int toTable(int score, int ply) {
+        if (score >= kSearchWinScore - kSearchMaxPly)
+            return score + ply;
+        if (score <= -kSearchWinScore + kSearchMaxPly)
+            return score - ply;
+        return score;
+    }
+
+    static int fromTable(int score, int ply) {
+        if (score >= kSearchWinScore - kSearchMaxPly)
+            return score - ply;
+        if (score <= -kSearchWinScore + kSearchMaxPly)
+            return score + ply;
+        return score;
+    }
+
+    SearchControl& control_;
+    const unsigned int id_;
+    std::uint64_t nodes_ = 0;
+    int rootMove_ = -1;
+    std::array<int, Rows * Cols> history_{};
+};
+
+} // namespace search_detail
+
+// Searches `state` on limits.threads threads until limits.maxDepth, the time
+// limit or a proven result. The table is shared by the threads and may be
+// kept between searches.
+template <int Rows, int Cols, int K>
+SearchResult searchBestMove(const MnkState<Rows, Cols, K>& state, const SearchLimits& limits,
+                            TranspositionTable& table) {
+    using Worker = search_detail::SearchWorker<Rows, Cols, K>;
+    SearchResult result;
+    if (state.gameOver())
+        return result;
+
+    const auto start = std::chrono::steady_clock::now();
+    table.newSearch();
+    search_detail::SearchControl control{table, start + limits.timeLimit};
+    const unsigned int threads = std::max(limits.threads, 1u);
+    std::vector<Worker> workers;
+    workers.reserve(threads);
+    for (unsigned int id = 0; id < threads; ++id)
+        workers.emplace_back(control, id);
+
+    std::vector<std::thread> helpers;
+    for (unsigned int id = 1; id < threads; ++id)
+        helpers.emplace_back([&, id] { workers[id].run(state, limits.maxDepth, nullptr, start); });
+    workers[0].run(state, limits.maxDepth, &result, start);
+    for (auto& helper : helpers)
+        helper.join();
+
+    for (const Worker& worker : workers)
+        result.nodes += worker.nodes();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // Out of time before depth 1 completed: any legal move
+    for (int cell = 0; result.move < 0 && cell < state.kCells; ++cell)
+        if (!state.occupied(cell))
+            result.move = cell;
+    return result;
+}
+
+#endif // MNKSEARCH_HPP
@@ -0,0 +1,51 @@
+#ifndef PERFECTPLAY_HPP
+#define PERFECTPLAY_HPP
+
+#include <array>
+#include <cstdint>
+
+#include "TicTacToeState.hpp"
+
+// Optimal moves for every position reachable from the empty board, solved by
+// minimax at compile time. Positions are indexed by their base-3 encoding
+// (0 empty, 1 X, 2 O), so a lookup is two table reads and an add.
+
+constexpr int kPerfectPlayPositions = 19683; // 3^9
+
+struct PerfectPlayEntry {
+    // Best cell for the player to move, or -1 once the game is over or for
+    // positions that cannot be reached
+    std::int8_t move = -1;
+    // From the mover's point of view: 0 for a draw, otherwise +/-(1 + empty
+    // cells left when the game ends), so faster wins score higher
+    std::int8_t score = 0;
+};
+
+// Base-3 value of a 9-bit board with every set cell counted as digit 1
+constexpr std::array<std::uint16_t, 512> kTernaryWeights = [] {
+    std::array<std::uint16_t, 512> weights{};
+    for (unsigned int board = 0; board < 512; ++board) {
+        unsigned int value = 0;
+        unsigned int power = 1;
+        for (int cell = 0; cell < 9; ++cell, power *= 3)
+            if (board >> cell & 1)
+                value += power;
+        weights[board] = static_cast<std::uint16_t>(value);
+    }
+    return weights;
+}();
+
+constexpr int positionIndex(unsigned int xBoard, unsigned int oBoard) {
+    return kTernaryWeights[xBoard & 0x1ff] + 2 * kTernaryWeights[oBoard & 0x1ff];
+}
+
+extern const std::array<PerfectPlayEntry, kPerfectPlayPositions> kPerfectPlayTable;
+
+// Optimal cell for state.currentPlayer, or -1 if the game is over.
+inline int perfectMove(const State& state) {
+    return kPerfectPlayTable[positionIndex(static_cast<unsigned int>(state.xBoard.to_ulong()),
+                                           static_cast<unsigned int>(state.oBoard.to_ulong()))]
+        .move;
+}
+
+#endif // PERFECTPLAY_HPP
@@ -0,0 +1,51 @@
+#ifndef TICTACTOESTATE_HPP
+#define TICTACTOESTATE_HPP
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <utility>
+#include <variant>
+
+enum class Player : char { None = ' ', X = 'X', O = 'O' };
+
+struct PlaceMarkerAction {
+    const unsigned int index;
+};
+
+struct ResetGameAction {};
+
+using Action = std::variant<PlaceMarkerAction, ResetGameAction>;
+
+struct State {
+    std::bitset<9> xBoard;
+    std::bitset<9> oBoard;
+    Player currentPlayer;
+};
+
+constexpr std::array<unsigned int, 8> kWinPatterns = {
+    0b111000000, 0b000111000, 0b000000111, // Rows
+    0b100100100, 0b010010010, 0b001001001, // Columns
+    0b100010001, 0b001010100              // Diagonals
+};
+
+// The win and tie rules on raw 9-bit boards, usable in constant expressions
+constexpr bool checkWinMask(unsigned int board) {
+    return std::any_of(kWinPatterns.begin(), kWinPatterns.end(), [board](const unsigned int pattern) {
+        return (board & pattern) == pattern;
+    });
+}
+
+constexpr bool checkTieMask(unsigned int xBoard, unsigned int oBoard) {
+    return ((xBoard | oBoard) & 0x1ff) == 0x1ff;
+}
+
+bool checkWin(const std::bitset<9>& board);
+bool checkTie(const State& state);
+
+// Applies an action to the state in place
+void reduceInPlace(State& state, const Action& action);
+State reducer(const State& state, const Action& action);
+State reducer(State&& state, const Action& action);
+
+#endif // TICTACTOESTATE_HPP
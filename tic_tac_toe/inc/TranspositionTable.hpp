@@ -0,0 +1,54 @@
+#ifndef TRANSPOSITIONTABLE_HPP
+#define TRANSPOSITIONTABLE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Hash table of search results shared by every search thread without locks.
+// Each slot is two 64-bit words: the packed entry, and the position key XORed
+// with it. A slot torn by two threads writing at once fails the key check on
+// the next probe and reads as a miss.
+
+enum class Bound : std::uint8_t { None, Exact, Lower, Upper };
+
+struct TranspositionEntry {
+    int move = -1;
+    int score = 0;
+    int depth = 0;
+    Bound bound = Bound::None;
+};
+
+class TranspositionTable {
+public:
+    // Rounded down to a power-of-two number of slots
+    explicit TranspositionTable(std::size_t megabytes = 16);
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    // Not safe while a search is running
+    void clear();
+    // Marks the entries of earlier searches as replaceable
+    void newSearch() { generation_ = (generation_ + 1) & kGenerationMask; }
+
+    bool probe(std::uint64_t key, TranspositionEntry& entry) const;
+    void store(std::uint64_t key, const TranspositionEntry& entry);
+
+    std::size_t slots() const { return mask_ + 1; }
+
+private:
+    static constexpr unsigned int kGenerationMask = 0x3f;
+
+    struct Slot {
+        std::atomic<std::uint64_t> check{0};
+        std::atomic<std::uint64_t> data{0};
+    };
+
+    std::unique_ptr<Slot[]> slots_;
+    std::size_t mask_;
+    unsigned int generation_ = 0;
+};
+
+#endif // TRANSPOSITIONTABLE_HPP
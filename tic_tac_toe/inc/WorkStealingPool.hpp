@@ -0,0 +1,56 @@
+#ifndef WORKSTEALINGPOOL_HPP
+#define WORKSTEALINGPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Worker threads for loops whose iterations vary in cost. Each thread starts
+// with an equal slice of the indices and takes them from the front; a thread
+// that runs dry steals the back half of another thread's slice. Slices are
+// single atomic words, so taking and stealing work needs no locks. The
+// calling thread takes part as worker 0.
+class WorkStealingPool {
+public:
+    explicit WorkStealingPool(unsigned int threads = std::thread::hardware_concurrency());
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    unsigned int size() const { return threadCount_; }
+
+    // Calls body(index, worker) once for every index in [0, count), where
+    // worker < size() identifies the calling thread, e.g. for per-thread
+    // results. Blocks until every index has been processed.
+    void parallelFor(std::uint32_t count, const std::function<void(std::uint32_t, unsigned int)>& body);
+
+private:
+    // Begin in the low half, end in the high half
+    struct alignas(64) Slice {
+        std::atomic<std::uint64_t> bounds{0};
+    };
+
+    void workerLoop(unsigned int index);
+    void runSlices(unsigned int worker);
+    bool steal(unsigned int worker);
+
+    const unsigned int threadCount_;
+    std::unique_ptr<Slice[]> slices_;
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    const std::function<void(std::uint32_t, unsigned int)>* job_ = nullptr;
+    std::uint64_t generation_ = 0;
+    unsigned int pending_ = 0;
+    bool stopping_ = false;
+};
+
+#endif // WORKSTEALINGPOOL_HPP
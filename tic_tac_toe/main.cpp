@@ -4,64 +4,14 @@
 #include <QMainWindow>
 #include <QMouseEvent>
 #include <QMessageBox>
-#include <bitset>
-#include <variant>
+#include <cstring>
+#include <utility>
 
-enum class Player : char { None = ' ', X = 'X', O = 'O' };
-
-struct PlaceMarkerAction {
-    const unsigned int index;
-};
-
-struct ResetGameAction {};
-
-using Action = std::variant<PlaceMarkerAction, ResetGameAction>;
-
-struct State {
-    std::bitset<9> xBoard;
-    std::bitset<9> oBoard;
-    Player currentPlayer;
-};
-
-bool checkWin(const std::bitset<9>& board) {
-    const std::array<int, 8> winPatterns = {
-        0b111000000, 0b000111000, 0b000000111, // Rows
-        0b100100100, 0b010010010, 0b001001001, // Columns
-        0b100010001, 0b001010100              // Diagonals
-    };
-    return std::any_of(winPatterns.begin(), winPatterns.end(), [&board](const int pattern) {
-        return (board.to_ulong() & pattern) == pattern;
-    });
-}
-
-bool checkTie(const State& state) {
-    return (state.xBoard | state.oBoard).count() == 9;
-}
-
-State reducer(const State& state, const Action& action) {
-    State newState = state;
-
-    std::visit([&newState](auto&& act) {
-        using T = std::decay_t<decltype(act)>;
-        if constexpr (std::is_same_v<T, PlaceMarkerAction>) {
-            if (!newState.xBoard[act.index] && !newState.oBoard[act.index]) {
-                if (newState.currentPlayer == Player::X) {
-                    newState.xBoard.set(act.index);
-                    newState.currentPlayer = Player::O;
-                } else {
-                    newState.oBoard.set(act.index);
-                    newState.currentPlayer = Player::X;
-                }
-            }
-        } else if constexpr (std::is_same_v<T, ResetGameAction>) {
-            newState.xBoard.reset();
-            newState.oBoard.reset();
-            newState.currentPlayer = Player::X;
-        }
-    }, action);
-
-    return newState;
-}
+#include "OffscreenBench.hpp"
+#include "PerfectPlay.hpp"
+#include "Profiler.hpp"
+#include "ProfilerOverlay.hpp"
+#include "TicTacToeState.hpp"
 
 void showGameOverMessage(const QString& message) {
     QMessageBox::warning(nullptr, "Game Over", message);
@@ -70,28 +20,52 @@ void showGameOverMessage(const QString& message) {
 void checkGameOver(State& state) {
     if (checkWin(state.xBoard)) {
         showGameOverMessage("X Wins!");
-        state = reducer(state, ResetGameAction{});
+        state = reducer(std::move(state), ResetGameAction{});
     } else if (checkWin(state.oBoard)) {
         showGameOverMessage("O Wins!");
-        state = reducer(state, ResetGameAction{});
+        state = reducer(std::move(state), ResetGameAction{});
     } else if (checkTie(state)) {
         showGameOverMessage("It's a Tie!");
-        state = reducer(state, ResetGameAction{});
+        state = reducer(std::move(state), ResetGameAction{});
     }
 }
 
-class TicTacToeWidget : public QOpenGLWidget {
+class TicTacToeWidget : public QOpenGLWidget, public render::BenchScene {
 public:
     TicTacToeWidget(QWidget *parent = nullptr) : QOpenGLWidget(parent) {
         state = {std::bitset<9>(), std::bitset<9>(), Player::X};
     }
 
+    // Lets the perfect-play table take one side; Player::None for two humans
+    void setComputerPlayer(Player player) {
+        computer = player;
+        playComputerTurn();
+        updateWindowTitle();
+    }
+
+    void benchInitialize(const QSize &) override {}
+
+    // The perfect-play table plays both sides, one move per frame, and a
+    // finished game starts over without the message box
+    void benchFrame(QPaintDevice &device) override {
+        const int move = perfectMove(state);
+        if (move < 0 || checkWin(state.xBoard) || checkWin(state.oBoard))
+            state = reducer(std::move(state), ResetGameAction{});
+        else
+            state = reducer(std::move(state), PlaceMarkerAction{static_cast<unsigned int>(move)});
+        paintFrame(device);
+    }
+
 protected:
     void initializeGL() override {}
 
-    void paintGL() override {
-        QPainter painter(this);
-        const int squareSize = width() / 3;
+    void paintGL() override { paintFrame(*this); }
+
+    void paintFrame(QPaintDevice &device) {
+        PROFILE_SCOPE("paintGL");
+        frameStats.markFrame();
+        QPainter painter(&device);
+        const int squareSize = device.width() / 3;
         const QFont font("Arial", squareSize * 0.5, QFont::Bold);
         painter.setFont(font);
 
@@ -115,27 +89,46 @@ protected:
         // Draw black lines between grid cells
         painter.setPen(QColor(0, 0, 0)); // Black color for lines
         for (int i = 1; i < 3; ++i) {
-            painter.drawLine(i * squareSize, 0, i * squareSize, height()); // Vertical lines
-            painter.drawLine(0, i * squareSize, width(), i * squareSize); // Horizontal lines
+            painter.drawLine(i * squareSize, 0, i * squareSize, device.height()); // Vertical lines
+            painter.drawLine(0, i * squareSize, device.width(), i * squareSize); // Horizontal lines
         }
+
+        if (profiler::overlayEnabled())
+            profiler::drawOverlay(painter, frameStats);
     }
 
     void mousePressEvent(QMouseEvent *event) override {
+        PROFILE_SCOPE("mousePressEvent");
         const int squareSize = width() / 3;
         const int row = event->position().y() / squareSize;
         const int col = event->position().x() / squareSize;
 
-        if (row < 3 && col < 3) {
+        if (row < 3 && col < 3 && state.currentPlayer != computer) {
             const unsigned int index = row * 3 + col;
-            state = reducer(state, PlaceMarkerAction{index});
+            state = reducer(std::move(state), PlaceMarkerAction{index});
             update();
             checkGameOver(state);
+            playComputerTurn();
             updateWindowTitle();
         }
     }
 
 private:
     State state;
+    Player computer = Player::None;
+    profiler::FrameStats frameStats;
+
+    // Also opens the next game when the computer plays X
+    void playComputerTurn() {
+        while (state.currentPlayer == computer) {
+            const int move = perfectMove(state);
+            if (move < 0)
+                break;
+            state = reducer(std::move(state), PlaceMarkerAction{static_cast<unsigned int>(move)});
+            update();
+            checkGameOver(state);
+        }
+    }
 
     void updateWindowTitle() {
         const QString title = QString("Tic Tac Toe - %1's Turn").arg(state.currentPlayer == Player::X ? 'X' : 'O');
@@ -144,8 +137,16 @@ private:
 };
 
 int main(int argc, char *argv[]) {
+    profiler::initFromEnvironment();
     QApplication app(argc, argv);
 
+    // --bench N renders N frames offscreen as fast as possible
+    if (const int frames = render::benchFrames(argc, argv)) {
+        render::OffscreenBench bench(QSize(300, 300));
+        TicTacToeWidget scene;
+        return bench.run(scene, frames);
+    }
+
     TicTacToeWidget *widget = new TicTacToeWidget;
     widget->resize(300, 300);
 
@@ -155,5 +156,13 @@ int main(int argc, char *argv[]) {
     mainWindow.setWindowTitle("Tic Tac Toe - X's Turn");
     mainWindow.show();
 
+    // --computer plays O against a human X, --computer-first plays X
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--computer") == 0)
+            widget->setComputerPlayer(Player::O);
+        else if (std::strcmp(argv[i], "--computer-first") == 0)
+            widget->setComputerPlayer(Player::X);
+    }
+
     return app.exec();
 }
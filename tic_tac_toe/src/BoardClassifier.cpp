@@ -0,0 +1,163 @@
+#include "BoardClassifier.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define BOARD_CLASSIFIER_X86 1
+#endif
+
+namespace {
+
+using Kernel = void (*)(const std::uint16_t*, const std::uint16_t*, BoardClass*, std::size_t);
+
+// Win check of every 9-bit board. A table of classes for every X/O pair
+// would take 256 KB.
+constexpr std::array<bool, 512> kWinningBoards = [] {
+    std::array<bool, 512> winning{};
+    for (unsigned int board = 0; board < 512; ++board)
+        winning[board] = checkWinMask(board);
+    return winning;
+}();
+
+void classifyScalar(const std::uint16_t* xBoards, const std::uint16_t* oBoards, BoardClass* classes,
+                    std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+        const unsigned int x = xBoards[i] & 0x1ff;
+        const unsigned int o = oBoards[i] & 0x1ff;
+        classes[i] = kWinningBoards[x]   ? BoardClass::XWins
+                     : kWinningBoards[o] ? BoardClass::OWins
+                     : (x | o) == 0x1ff  ? BoardClass::Tie
+                                         : BoardClass::Ongoing;
+    }
+}
+
+#ifdef BOARD_CLASSIFIER_X86
+
+// Both kernels hold one board per 16-bit lane. A lane is all ones where any
+// win pattern is fully set; the class is then picked with masks in the same
+// order as classifyBoard.
+
+void classifySse2(const std::uint16_t* xBoards, const std::uint16_t* oBoards, BoardClass* classes,
+                  std::size_t count) {
+    const __m128i full = _mm_set1_epi16(0x1ff);
+    const __m128i xClass = _mm_set1_epi16(static_cast<short>(BoardClass::XWins));
+    const __m128i oClass = _mm_set1_epi16(static_cast<short>(BoardClass::OWins));
+    const __m128i tieClass = _mm_set1_epi16(static_cast<short>(BoardClass::Tie));
+    std::size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(xBoards + i));
+        const __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i*>(oBoards + i));
+        __m128i xWins = _mm_setzero_si128();
+        __m128i oWins = _mm_setzero_si128();
+        for (const unsigned int pattern : kWinPatterns) {
+            const __m128i p = _mm_set1_epi16(static_cast<short>(pattern));
+            xWins = _mm_or_si128(xWins, _mm_cmpeq_epi16(_mm_and_si128(x, p), p));
+            oWins = _mm_or_si128(oWins, _mm_cmpeq_epi16(_mm_and_si128(o, p), p));
+        }
+        const __m128i tie = _mm_cmpeq_epi16(_mm_and_si128(_mm_or_si128(x, o), full), full);
+        __m128i result = _mm_and_si128(xWins, xClass);
+        result = _mm_or_si128(result, _mm_andnot_si128(xWins, _mm_and_si128(oWins, oClass)));
+        result = _mm_or_si128(result, _mm_andnot_si128(_mm_or_si128(xWins, oWins), _mm_and_si128(tie, tieClass)));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(classes + i), _mm_packus_epi16(result, result));
+    }
+    classifyScalar(xBoards + i, oBoards + i, classes + i, count - i);
+}
+
+__attribute__((target("avx2"))) void classifyAvx2(const std::uint16_t* xBoards, const std::uint16_t* oBoards,
+                                                  BoardClass* classes, std::size_t count) {
+    const __m256i full = _mm256_set1_epi16(0x1ff);
+    const __m256i xClass = _mm256_set1_epi16(static_cast<short>(BoardClass::XWins));
+    const __m256i oClass = _mm256_set1_epi16(static_cast<short>(BoardClass::OWins));
+    const __m256i tieClass = _mm256_set1_epi16(static_cast<short>(BoardClass::Tie));
+    std::size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(xBoards + i));
+        const __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(oBoards + i));
+        __m256i xWins = _mm256_setzero_si256();
+        __m256i oWins = _mm256_setzero_si256();
+        for (const unsigned int pattern : kWinPatterns) {
+            const __m256i p = _mm256_set1_epi16(static_cast<short>(pattern));
+            xWins = _mm256_or_si256(xWins, _mm256_cmpeq_epi16(_mm256_and_si256(x, p), p));
+            oWins = _mm256_or_si256(oWins, _mm256_cmpeq_epi16(_mm256_and_si256(o, p), p));
+        }
+        const __m256i tie = _mm256_cmpeq_epi16(_mm256_and_si256(_mm256_or_si256(x, o), full), full);
+        __m256i result = _mm256_and_si256(xWins, xClass);
+        result = _mm256_or_si256(result, _mm256_andnot_si256(xWins, _mm256_and_si256(oWins, oClass)));
+        result = _mm256_or_si256(result,
+                                 _mm256_andnot_si256(_mm256_or_si256(xWins, oWins), _mm256_and_si256(tie, tieClass)));
+        // Packing works within each 128-bit half, so gather the two low
+        // quarters holding the 16 bytes
+        const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(result, result), 0b1000);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(classes + i), _mm256_castsi256_si128(packed));
+    }
+    classifyScalar(xBoards + i, oBoards + i, classes + i, count - i);
+}
+
+#endif
+
+Kernel kernelFor(ClassifierKernel kernel) {
+    switch (kernel) {
+#ifdef BOARD_CLASSIFIER_X86
+    case ClassifierKernel::Avx2:
+        return classifyAvx2;
+    case ClassifierKernel::Sse2:
+        return classifySse2;
+#endif
+    default:
+        return classifyScalar;
+    }
+}
+
+} // namespace
+
+bool classifierKernelSupported(ClassifierKernel kernel) {
+    switch (kernel) {
+#ifdef BOARD_CLASSIFIER_X86
+    case ClassifierKernel::Avx2:
+        return __builtin_cpu_supports("avx2");
+    case ClassifierKernel::Sse2:
+        return __builtin_cpu_supports("sse2");
+#endif
+    case ClassifierKernel::Scalar:
+        return true;
+    default:
+        return false;
+    }
+}
+
+ClassifierKernel bestClassifierKernel() {
+    static const ClassifierKernel best = [] {
+        for (const ClassifierKernel kernel : {ClassifierKernel::Avx2, ClassifierKernel::Sse2})
+            if (classifierKernelSupported(kernel))
+                return kernel;
+        return ClassifierKernel::Scalar;
+    }();
+    return best;
+}
+
+const char* classifierKernelName(ClassifierKernel kernel) {
+    switch (kernel) {
+    case ClassifierKernel::Avx2:
+        return "avx2";
+    case ClassifierKernel::Sse2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
+
+void classifyBoards(std::span<const std::uint16_t> xBoards, std::span<const std::uint16_t> oBoards,
+                    std::span<BoardClass> classes) {
+    classifyBoards(xBoards, oBoards, classes, bestClassifierKernel());
+}
+
+void classifyBoards(std::span<const std::uint16_t> xBoards, std::span<const std::uint16_t> oBoards,
+                    std::span<BoardClass> classes, ClassifierKernel kernel) {
+    if (!classifierKernelSupported(kernel))
+        kernel = bestClassifierKernel();
+    const std::size_t count = std::min({xBoards.size(), oBoards.size(), classes.size()});
+    kernelFor(kernel)(xBoards.data(), oBoards.data(), classes.data(), count);
+}
@@ -0,0 +1,153 @@
+#include "PerfectPlay.hpp"
+
+#include <bit>
+
+namespace {
+
+// Memoized negamax over every position reachable with X moving first
+class TableBuilder {
+public:
+    constexpr std::array<PerfectPlayEntry, kPerfectPlayPositions> build() {
+        solve(0, 0);
+        return table_;
+    }
+
+private:
+    constexpr int solve(unsigned int xBoard, unsigned int oBoard) {
+        const int index = positionIndex(xBoard, oBoard);
+        if (solved_[index])
+            return table_[index].score;
+        solved_[index] = true;
+
+        PerfectPlayEntry& entry = table_[index];
+        const int empty = 9 - std::popcount(xBoard | oBoard);
+        if (checkWinMask(xBoard) || checkWinMask(oBoard)) {
+            // The previous move won, so the player to move has lost
+            entry.score = static_cast<std::int8_t>(-(1 + empty));
+            return entry.score;
+        }
+        if (checkTieMask(xBoard, oBoard))
+            return entry.score = 0;
+
+        const bool xToMove = std::popcount(xBoard) == std::popcount(oBoard);
+        int best = -100;
+        for (int cell = 0; cell < 9; ++cell) {
+            const unsigned int bit = 1u << cell;
+            if ((xBoard | oBoard) & bit)
+                continue;
+            const int score = xToMove ? -solve(xBoard | bit, oBoard)
+                                      : -solve(xBoard, oBoard | bit);
+            if (score > best) {
+                best = score;
+                entry.move = static_cast<std::int8_t>(cell);
+            }
+        }
+        entry.score = static_cast<std::int8_t>(best);
+        return best;
+    }
+
+    std::array<PerfectPlayEntry, kPerfectPlayPositions> table_{};
+    std::array<bool, kPerfectPlayPositions> solved_{};
+};
+
+constexpr auto kTable = TableBuilder{}.build();
+
+constexpr const PerfectPlayEntry& entryFor(unsigned int xBoard, unsigned int oBoard) {
+    return kTable[positionIndex(xBoard, oBoard)];
+}
+
+// Every reachable position agrees with checkWinMask/checkTieMask: finished
+// games have no move, the rest name an empty cell, and an immediate win is
+// never passed up.
+class RuleChecker {
+public:
+    constexpr bool check(unsigned int xBoard, unsigned int oBoard) {
+        const int index = positionIndex(xBoard, oBoard);
+        if (visited_[index])
+            return true;
+        visited_[index] = true;
+
+        const PerfectPlayEntry& entry = kTable[index];
+        if (checkWinMask(xBoard) || checkWinMask(oBoard) || checkTieMask(xBoard, oBoard))
+            return entry.move == -1;
+        if (entry.move < 0 || ((xBoard | oBoard) >> entry.move & 1))
+            return false;
+
+        const bool xToMove = std::popcount(xBoard) == std::popcount(oBoard);
+        const unsigned int mover = xToMove ? xBoard : oBoard;
+        bool canWinNow = false;
+        for (int cell = 0; cell < 9; ++cell)
+            if (!((xBoard | oBoard) >> cell & 1) && checkWinMask(mover | 1u << cell))
+                canWinNow = true;
+        if (canWinNow && !checkWinMask(mover | 1u << entry.move))
+            return false;
+
+        for (int cell = 0; cell < 9; ++cell) {
+            const unsigned int bit = 1u << cell;
+            if ((xBoard | oBoard) & bit)
+                continue;
+            if (!(xToMove ? check(xBoard | bit, oBoard) : check(xBoard, oBoard | bit)))
+                return false;
+        }
+        return true;
+    }
+
+private:
+    std::array<bool, kPerfectPlayPositions> visited_{};
+};
+
+constexpr bool checkTableRules() {
+    RuleChecker checker;
+    return checker.check(0, 0);
+}
+
+// Plays the table as `computerIsX` against every possible sequence of
+// opponent moves and checks the opponent never wins.
+constexpr bool neverLoses(unsigned int xBoard, unsigned int oBoard, bool computerIsX) {
+    if (checkWinMask(computerIsX ? oBoard : xBoard))
+        return false;
+    if (checkWinMask(xBoard) || checkWinMask(oBoard) || checkTieMask(xBoard, oBoard))
+        return true;
+
+    const bool xToMove = std::popcount(xBoard) == std::popcount(oBoard);
+    if (xToMove == computerIsX) {
+        const unsigned int bit = 1u << entryFor(xBoard, oBoard).move;
+        return xToMove ? neverLoses(xBoard | bit, oBoard, computerIsX)
+                       : neverLoses(xBoard, oBoard | bit, computerIsX);
+    }
+    for (int cell = 0; cell < 9; ++cell) {
+        const unsigned int bit = 1u << cell;
+        if ((xBoard | oBoard) & bit)
+            continue;
+        if (!(xToMove ? neverLoses(xBoard | bit, oBoard, computerIsX)
+                      : neverLoses(xBoard, oBoard | bit, computerIsX)))
+            return false;
+    }
+    return true;
+}
+
+// Both sides following the table from the empty board ends in a tie
+constexpr bool selfPlayDraws() {
+    unsigned int boards[2] = {0, 0};
+    for (int turn = 0;; ++turn) {
+        const int move = entryFor(boards[0], boards[1]).move;
+        if (move < 0)
+            return !checkWinMask(boards[0]) && !checkWinMask(boards[1]) &&
+                   checkTieMask(boards[0], boards[1]);
+        boards[turn % 2] |= 1u << move;
+    }
+}
+
+static_assert(entryFor(0, 0).score == 0, "tic-tac-toe is a draw with perfect play");
+static_assert(entryFor(0b000010000, 0b000000001).score == 0,
+              "a corner reply to the centre opening holds the draw");
+static_assert(entryFor(0b000010000, 0b000000010).score > 0,
+              "an edge reply to the centre opening loses");
+static_assert(checkTableRules());
+static_assert(neverLoses(0, 0, true));
+static_assert(neverLoses(0, 0, false));
+static_assert(selfPlayDraws());
+
+} // namespace
+
+const std::array<PerfectPlayEntry, kPerfectPlayPositions> kPerfectPlayTable = kTable;
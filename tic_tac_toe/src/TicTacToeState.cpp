@@ -0,0 +1,47 @@
+#include "TicTacToeState.hpp"
+
+#include <type_traits>
+
+#include "Profiler.hpp"
+
+bool checkWin(const std::bitset<9>& board) {
+    return checkWinMask(static_cast<unsigned int>(board.to_ulong()));
+}
+
+bool checkTie(const State& state) {
+    return checkTieMask(static_cast<unsigned int>(state.xBoard.to_ulong()),
+                        static_cast<unsigned int>(state.oBoard.to_ulong()));
+}
+
+void reduceInPlace(State& state, const Action& action) {
+    PROFILE_SCOPE("reducer");
+    std::visit([&state](auto&& act) {
+        using T = std::decay_t<decltype(act)>;
+        if constexpr (std::is_same_v<T, PlaceMarkerAction>) {
+            if (!state.xBoard[act.index] && !state.oBoard[act.index]) {
+                if (state.currentPlayer == Player::X) {
+                    state.xBoard.set(act.index);
+                    state.currentPlayer = Player::O;
+                } else {
+                    state.oBoard.set(act.index);
+                    state.currentPlayer = Player::X;
+                }
+            }
+        } else if constexpr (std::is_same_v<T, ResetGameAction>) {
+            state.xBoard.reset();
+            state.oBoard.reset();
+            state.currentPlayer = Player::X;
+        }
+    }, action);
+}
+
+State reducer(const State& state, const Action& action) {
+    State newState = state;
+    reduceInPlace(newState, action);
+    return newState;
+}
+
+State reducer(State&& state, const Action& action) {
+    reduceInPlace(state, action);
+    return std::move(state);
+}
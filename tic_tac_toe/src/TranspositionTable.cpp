@@ -0,0 +1,69 @@
+#include "TranspositionTable.hpp"
+
+#include <algorithm>
+#include <bit>
+
+namespace {
+
+// Packed entry: move + 1 (16 bits), score (16), depth (8), bound (2) and the
+// generation it was written in (6)
+std::uint64_t pack(const TranspositionEntry& entry, unsigned int generation) {
+    return static_cast<std::uint64_t>(static_cast<std::uint16_t>(entry.move + 1)) |
+           static_cast<std::uint64_t>(static_cast<std::uint16_t>(entry.score)) << 16 |
+           static_cast<std::uint64_t>(static_cast<std::uint8_t>(entry.depth)) << 32 |
+           static_cast<std::uint64_t>(entry.bound) << 40 | static_cast<std::uint64_t>(generation) << 42;
+}
+
+TranspositionEntry unpack(std::uint64_t data) {
+    TranspositionEntry entry;
+    entry.move = static_cast<int>(data & 0xffff) - 1;
+    entry.score = static_cast<std::int16_t>(data >> 16 & 0xffff);
+    entry.depth = static_cast<int>(data >> 32 & 0xff);
+    entry.bound = static_cast<Bound>(data >> 40 & 3);
+    return entry;
+}
+
+unsigned int generationOf(std::uint64_t data) {
+    return static_cast<unsigned int>(data >> 42);
+}
+
+} // namespace
+
+TranspositionTable::TranspositionTable(std::size_t megabytes) {
+    const std::size_t wanted = std::max<std::size_t>(megabytes * 1024 * 1024 / sizeof(Slot), 1);
+    const std::size_t count = std::bit_floor(wanted);
+    slots_ = std::make_unique<Slot[]>(count);
+    mask_ = count - 1;
+}
+
+void TranspositionTable::clear() {
+    for (std::size_t i = 0; i <= mask_; ++i) {
+        slots_[i].check.store(0, std::memory_order_relaxed);
+        slots_[i].data.store(0, std::memory_order_relaxed);
+    }
+    generation_ = 0;
+}
+
+bool TranspositionTable::probe(std::uint64_t key, TranspositionEntry& entry) const {
+    const Slot& slot = slots_[key & mask_];
+    const std::uint64_t data = slot.data.load(std::memory_order_relaxed);
+    if ((slot.check.load(std::memory_order_relaxed) ^ data) != key || data == 0)
+        return false;
+    entry = unpack(data);
+    return true;
+}
+
+void TranspositionTable::store(std::uint64_t key, const TranspositionEntry& entry) {
+    Slot& slot = slots_[key & mask_];
+    const std::uint64_t old = slot.data.load(std::memory_order_relaxed);
+    const bool sameKey = (slot.check.load(std::memory_order_relaxed) ^ old) == key;
+    // Keep deeper results for other positions from the current search
+    if (!sameKey && old != 0 && generationOf(old) == generation_ && unpack(old).depth > entry.depth)
+        return;
+    TranspositionEntry updated = entry;
+    if (updated.move < 0 && sameKey)
+        updated.move = unpack(old).move;
+    const std::uint64_t data = pack(updated, generation_);
+    slot.data.store(data, std::memory_order_relaxed);
+    slot.check.store(key ^ data, std::memory_order_relaxed);
+}
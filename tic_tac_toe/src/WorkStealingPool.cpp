@@ -0,0 +1,113 @@
+#include "WorkStealingPool.hpp"
+
+namespace {
+
+std::uint64_t packBounds(std::uint32_t begin, std::uint32_t end) {
+    return static_cast<std::uint64_t>(end) << 32 | begin;
+}
+
+std::uint32_t beginOf(std::uint64_t bounds) {
+    return static_cast<std::uint32_t>(bounds);
+}
+
+std::uint32_t endOf(std::uint64_t bounds) {
+    return static_cast<std::uint32_t>(bounds >> 32);
+}
+
+} // namespace
+
+WorkStealingPool::WorkStealingPool(unsigned int threads)
+    : threadCount_(threads > 0 ? threads : 1), slices_(std::make_unique<Slice[]>(threadCount_)) {
+    for (unsigned int i = 1; i < threadCount_; ++i)
+        workers_.emplace_back([this, i] { workerLoop(i); });
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_)
+        worker.join();
+}
+
+void WorkStealingPool::parallelFor(std::uint32_t count, const std::function<void(std::uint32_t, unsigned int)>& body) {
+    if (threadCount_ == 1) {
+        for (std::uint32_t i = 0; i < count; ++i)
+            body(i, 0);
+        return;
+    }
+
+    for (unsigned int i = 0; i < threadCount_; ++i) {
+        const auto begin = static_cast<std::uint32_t>(std::uint64_t(count) * i / threadCount_);
+        const auto end = static_cast<std::uint32_t>(std::uint64_t(count) * (i + 1) / threadCount_);
+        slices_[i].bounds.store(packBounds(begin, end), std::memory_order_relaxed);
+    }
+    {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        job_ = &body;
+        pending_ = threadCount_ - 1;
+        ++generation_;
+    }
+    wake_.notify_all();
+
+    runSlices(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return pending_ == 0; });
+    job_ = nullptr;
+}
+
+void WorkStealingPool::workerLoop(unsigned int index) {
+    std::uint64_t seen = 0;
+    while (true) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [&] { return stopping_ || generation_ != seen; });
+        if (stopping_)
+            return;
+        seen = generation_;
+        lock.unlock();
+
+        runSlices(index);
+
+        lock.lock();
+        if (--pending_ == 0)
+            done_.notify_one();
+    }
+}
+
+// Works through this worker's slice, refilling it by stealing until no
+// other slice has anything left. Indices in flight between two slices during
+// a steal are always run by the thief, so finishing early is safe.
+void WorkStealingPool::runSlices(unsigned int worker) {
+    std::atomic<std::uint64_t>& bounds = slices_[worker].bounds;
+    do {
+        std::uint64_t current = bounds.load(std::memory_order_relaxed);
+        while (beginOf(current) < endOf(current)) {
+            if (!bounds.compare_exchange_weak(current, packBounds(beginOf(current) + 1, endOf(current)),
+                                              std::memory_order_relaxed))
+                continue;
+            (*job_)(beginOf(current), worker);
+            current = bounds.load(std::memory_order_relaxed);
+        }
+    } while (steal(worker));
+}
+
+bool WorkStealingPool::steal(unsigned int worker) {
+    for (unsigned int offset = 1; offset < threadCount_; ++offset) {
+        std::atomic<std::uint64_t>& victim = slices_[(worker + offset) % threadCount_].bounds;
+        std::uint64_t current = victim.load(std::memory_order_relaxed);
+        while (beginOf(current) < endOf(current)) {
+            const std::uint32_t begin = beginOf(current);
+            const std::uint32_t end = endOf(current);
+            const std::uint32_t split = end - (end - begin + 1) / 2;
+            if (victim.compare_exchange_weak(current, packBounds(begin, split), std::memory_order_relaxed)) {
+                // Only this thread refills its own slice, and it is empty
+                slices_[worker].bounds.store(packBounds(split, end), std::memory_order_relaxed);
+                return true;
+            }
+        }
+    }
+    return false;
+}
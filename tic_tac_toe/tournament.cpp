@@ -0,0 +1,272 @@
+#include "MnkSearch.hpp"
+#include "PerfectPlay.hpp"
+#include "Profiler.hpp"
+#include "TicTacToeState.hpp"
+#include "WorkStealingPool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bitset>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Plays many games between two computer players through the reducer, on a
+// work-stealing pool, and reports results and games per second for each
+// thread count up to --threads.
+
+namespace {
+
+// Cheap to seed, since every game gets its own
+using Rng = std::minstd_rand;
+
+// Chooses moves for either side. Every pool thread gets its own instance, so
+// players may keep state without locking.
+class GamePlayer {
+public:
+    virtual ~GamePlayer() = default;
+    // Cell for state.currentPlayer; called only while the game is running
+    virtual unsigned int chooseMove(const State& state, Rng& rng) = 0;
+};
+
+struct Cells {
+    std::array<unsigned int, 9> cells;
+    unsigned int count = 0;
+
+    void add(unsigned int cell) { cells[count++] = cell; }
+    bool contains(unsigned int cell) const {
+        return std::find(cells.begin(), cells.begin() + count, cell) != cells.begin() + count;
+    }
+    unsigned int random(Rng& rng) const {
+        return cells[std::uniform_int_distribution<unsigned int>(0, count - 1)(rng)];
+    }
+};
+
+Cells emptyCells(const State& state) {
+    Cells empty;
+    for (unsigned int cell = 0; cell < 9; ++cell)
+        if (!state.xBoard[cell] && !state.oBoard[cell])
+            empty.add(cell);
+    return empty;
+}
+
+class RandomPlayer : public GamePlayer {
+public:
+    unsigned int chooseMove(const State& state, Rng& rng) override {
+        return emptyCells(state).random(rng);
+    }
+};
+
+// Wins if it can, blocks if it must, otherwise prefers the centre, then
+// corners, then edges
+class RulePlayer : public GamePlayer {
+public:
+    unsigned int chooseMove(const State& state, Rng& rng) override {
+        const Cells empty = emptyCells(state);
+        const bool xToMove = state.currentPlayer == Player::X;
+        const std::bitset<9>& own = xToMove ? state.xBoard : state.oBoard;
+        const std::bitset<9>& other = xToMove ? state.oBoard : state.xBoard;
+        for (const std::bitset<9>* board : {&own, &other}) {
+            for (unsigned int i = 0; i < empty.count; ++i) {
+                std::bitset<9> next = *board;
+                if (checkWin(next.set(empty.cells[i])))
+                    return empty.cells[i];
+            }
+        }
+        if (empty.contains(4))
+            return 4;
+        Cells corners;
+        for (const unsigned int cell : {0u, 2u, 6u, 8u})
+            if (empty.contains(cell))
+                corners.add(cell);
+        return corners.count > 0 ? corners.random(rng) : empty.random(rng);
+    }
+};
+
+class PerfectPlayer : public GamePlayer {
+public:
+    unsigned int chooseMove(const State& state, Rng&) override {
+        return static_cast<unsigned int>(perfectMove(state));
+    }
+};
+
+// Depth-limited alpha-beta on the m,n,k engine, with its own table
+class SearchPlayer : public GamePlayer {
+public:
+    explicit SearchPlayer(int depth) : table_(1) { limits_.maxDepth = depth; }
+
+    unsigned int chooseMove(const State& state, Rng&) override {
+        return static_cast<unsigned int>(searchBestMove(toMnkState(state), limits_, table_).move);
+    }
+
+private:
+    SearchLimits limits_;
+    TranspositionTable table_;
+};
+
+// "random", "rules", "perfect" or "search[:depth]"; null if unknown
+std::unique_ptr<GamePlayer> makePlayer(const std::string& name) {
+    if (name == "random")
+        return std::make_unique<RandomPlayer>();
+    if (name == "rules")
+        return std::make_unique<RulePlayer>();
+    if (name == "perfect")
+        return std::make_unique<PerfectPlayer>();
+    if (name == "search")
+        return std::make_unique<SearchPlayer>(9);
+    if (name.starts_with("search:")) {
+        const int depth = std::atoi(name.c_str() + 7);
+        return depth > 0 ? std::make_unique<SearchPlayer>(depth) : nullptr;
+    }
+    return nullptr;
+}
+
+struct Options {
+    std::string xPlayer = "rules";
+    std::string oPlayer = "perfect";
+    long long games = 1'000'000;
+    unsigned int threads = std::max(std::thread::hardware_concurrency(), 1u);
+    unsigned int seed = 1;
+};
+
+void printUsage(const char *program) {
+    std::printf("Usage: %s [--x PLAYER] [--o PLAYER] [--games N] [--threads N] [--seed N]\n"
+                "Players: random, rules, perfect, search[:depth]\n",
+                program);
+}
+
+bool parseOptions(int argc, char *argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (std::strcmp(arg, "--x") == 0 && hasValue) {
+            options.xPlayer = argv[++i];
+        } else if (std::strcmp(arg, "--o") == 0 && hasValue) {
+            options.oPlayer = argv[++i];
+        } else if (std::strcmp(arg, "--games") == 0 && hasValue) {
+            options.games = std::atoll(argv[++i]);
+        } else if (std::strcmp(arg, "--threads") == 0 && hasValue) {
+            options.threads = static_cast<unsigned int>(std::atoi(argv[++i]));
+        } else if (std::strcmp(arg, "--seed") == 0 && hasValue) {
+            options.seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            return false;
+        }
+    }
+    return options.games > 0 && options.threads > 0 && makePlayer(options.xPlayer) && makePlayer(options.oPlayer);
+}
+
+// Per-thread totals, padded so threads never share a cache line
+struct alignas(64) Tally {
+    long long xWins = 0;
+    long long oWins = 0;
+    long long draws = 0;
+    long long moves = 0;
+};
+
+Player playGame(GamePlayer& x, GamePlayer& o, Rng& rng, long long& moves) {
+    State state{std::bitset<9>(), std::bitset<9>(), Player::X};
+    for (;;) {
+        if (checkWin(state.xBoard))
+            return Player::X;
+        if (checkWin(state.oBoard))
+            return Player::O;
+        if (checkTie(state))
+            return Player::None;
+        GamePlayer& mover = state.currentPlayer == Player::X ? x : o;
+        const unsigned int cell = mover.chooseMove(state, rng);
+        state = reducer(std::move(state), PlaceMarkerAction{cell});
+        ++moves;
+    }
+}
+
+// Games are handed out in batches so stealing stays cheap next to the games
+constexpr long long kGamesPerTask = 256;
+
+struct RunResult {
+    Tally total;
+    double seconds = 0;
+};
+
+RunResult runTournament(const Options& options, unsigned int threads) {
+    WorkStealingPool pool(threads);
+    std::vector<std::unique_ptr<GamePlayer>> xPlayers;
+    std::vector<std::unique_ptr<GamePlayer>> oPlayers;
+    for (unsigned int i = 0; i < pool.size(); ++i) {
+        xPlayers.push_back(makePlayer(options.xPlayer));
+        oPlayers.push_back(makePlayer(options.oPlayer));
+    }
+    std::vector<Tally> tallies(pool.size());
+
+    const auto tasks = static_cast<std::uint32_t>((options.games + kGamesPerTask - 1) / kGamesPerTask);
+    const auto start = std::chrono::steady_clock::now();
+    pool.parallelFor(tasks, [&](std::uint32_t task, unsigned int worker) {
+        PROFILE_SCOPE("tournament batch");
+        Tally& tally = tallies[worker];
+        const long long first = task * kGamesPerTask;
+        const long long last = std::min(first + kGamesPerTask, options.games);
+        for (long long game = first; game < last; ++game) {
+            // Seeded per game, so results do not depend on the schedule
+            Rng rng(static_cast<Rng::result_type>((options.seed * 0x9e3779b9ull + game) % (Rng::modulus - 1) + 1));
+            switch (playGame(*xPlayers[worker], *oPlayers[worker], rng, tally.moves)) {
+            case Player::X:
+                ++tally.xWins;
+                break;
+            case Player::O:
+                ++tally.oWins;
+                break;
+            default:
+                ++tally.draws;
+            }
+        }
+    });
+
+    RunResult result;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const Tally& tally : tallies) {
+        result.total.xWins += tally.xWins;
+        result.total.oWins += tally.oWins;
+        result.total.draws += tally.draws;
+        result.total.moves += tally.moves;
+    }
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    profiler::initFromEnvironment();
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::printf("%s (X) vs %s (O), %lld games\n", options.xPlayer.c_str(), options.oPlayer.c_str(), options.games);
+    double baseline = 0;
+    RunResult first;
+    for (unsigned int threads = 1; threads <= options.threads; ++threads) {
+        const RunResult result = runTournament(options, threads);
+        const double gamesPerSecond = options.games / result.seconds;
+        if (threads == 1) {
+            baseline = gamesPerSecond;
+            first = result;
+            const double games = static_cast<double>(options.games);
+            std::printf("X wins %.2f%%  O wins %.2f%%  draws %.2f%%  %.2f moves/game\n",
+                        100.0 * result.total.xWins / games, 100.0 * result.total.oWins / games,
+                        100.0 * result.total.draws / games, result.total.moves / games);
+        } else if (result.total.xWins != first.total.xWins || result.total.oWins != first.total.oWins) {
+            // Games are seeded individually, so only players that carry state
+            // between games, such as a search table, can cause this
+            std::printf("note: results differ from 1 thread\n");
+        }
+        std::printf("threads %2u  %10.0f games/s  %5.1f%% efficiency\n", threads, gamesPerSecond,
+                    100.0 * gamesPerSecond / (baseline * threads));
+    }
+    return 0;
+}